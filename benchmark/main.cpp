@@ -0,0 +1,791 @@
+#include <loopback_port.h>
+#include <mavlink_crc.h>
+#include <message_entries.h>
+#include <port_bridge.h>
+#include <serial_port.h>
+#include <udp_port.h>
+#include <tcp_server.h>
+#include <common/mavlink.h>
+#include "cxxopts.hpp"
+#include "iostream"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <vector>
+
+const int BATCH_MESSAGES = 64;  // read_messages() array size
+const long WINDOW_FRAMES = 256; // frames in flight between feeder and port
+
+// Feeder side of the link: writes encoded frames as fast as the port consumes them
+struct Feeder
+{
+    std::atomic<long> consumed{0};
+    std::atomic<bool> done{false};
+};
+
+// Builds a stream of alternating HEARTBEAT / ATTITUDE frames
+std::vector<std::vector<uint8_t>> make_frames(int count)
+{
+    std::vector<std::vector<uint8_t>> frames;
+    for (int i = 0; i < count; i++)
+    {
+        mavlink_message_t message;
+        if (i % 2 == 0)
+        {
+            mavlink_msg_heartbeat_pack(1, 1, &message, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_INVALID, 0, 0, MAV_STATE_ACTIVE);
+        }
+        else
+        {
+            mavlink_msg_attitude_pack(1, 1, &message, i, 0.1f, 0.2f, 0.3f, 0.01f, 0.02f, 0.03f);
+        }
+        std::vector<uint8_t> frame(MAVLINK_MAX_PACKET_LEN);
+        frame.resize(mavlink_msg_to_send_buffer(frame.data(), &message));
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+// Writes total frames to fd, at most frames_per_write per syscall, keeping WINDOW_FRAMES in flight
+void feed_stream(int fd, long total, int frames_per_write, Feeder &feeder, bool datagrams)
+{
+    std::vector<std::vector<uint8_t>> frames = make_frames(16);
+    std::vector<uint8_t> chunk;
+    long sent = 0;
+
+    while (sent < total && !feeder.done)
+    {
+        if (sent - feeder.consumed.load() >= WINDOW_FRAMES)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        chunk.clear();
+        int n = 0;
+        while (n < frames_per_write && sent + n < total)
+        {
+            const std::vector<uint8_t> &frame = frames[(sent + n) % frames.size()];
+            chunk.insert(chunk.end(), frame.begin(), frame.end());
+            n++;
+        }
+
+        ssize_t result = datagrams ? send(fd, chunk.data(), chunk.size(), 0) : write(fd, chunk.data(), chunk.size());
+        if (result < 0)
+        {
+            perror("feeder write failed");
+            return;
+        }
+        sent += n;
+    }
+}
+
+// Reads total frames from the port either one byte per call or in bulk
+double consume(Generic_Port *port, long total, bool bulk, Feeder &feeder)
+{
+    auto begin = std::chrono::steady_clock::now();
+    long received = 0;
+
+    if (bulk)
+    {
+        mavlink_message_t messages[BATCH_MESSAGES];
+        while (received < total)
+        {
+            int n = port->read_messages(messages, BATCH_MESSAGES);
+            if (n > 0)
+            {
+                received += n;
+                feeder.consumed.store(received);
+            }
+        }
+    }
+    else
+    {
+        mavlink_message_t message;
+        while (received < total)
+        {
+            if (port->read_message(message))
+            {
+                received++;
+                feeder.consumed.store(received);
+            }
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    feeder.done = true;
+    return elapsed.count();
+}
+
+void report(const std::string &port_name, const std::string &mode, long frames, double seconds)
+{
+    std::cout << std::left << std::setw(10) << port_name << std::setw(14) << mode
+              << std::right << std::setw(10) << frames
+              << std::setw(12) << std::fixed << std::setprecision(3) << seconds
+              << std::setw(14) << std::setprecision(0) << frames / seconds << std::endl;
+}
+
+std::string mode_name(bool bulk, Generic_Port::Io_Engine engine)
+{
+    std::string mode = bulk ? "bulk" : "single";
+    return engine == Generic_Port::IO_ENGINE_URING ? mode + "/uring" : mode;
+}
+
+void bench_serial(long total, bool bulk, Serial_Port::Rx_Mode rx_mode, Generic_Port::Io_Engine engine)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+    {
+        perror("could not create pseudo terminal");
+        return;
+    }
+
+    Serial_Port port(ptsname(master), 921600);
+    port.set_rx_mode(rx_mode);
+    port.set_io_engine(engine);
+    port.start();
+
+    Feeder feeder;
+    std::thread writer(feed_stream, master, total, 16, std::ref(feeder), false);
+    double seconds = consume(&port, total, bulk, feeder);
+    writer.join();
+
+    port.stop();
+    close(master);
+    report("serial", mode_name(bulk, engine), total, seconds);
+}
+
+void bench_udp(long total, bool bulk, int udp_port, int rx_batch, Generic_Port::Io_Engine engine)
+{
+    UDP_Port port("127.0.0.1", udp_port);
+    port.set_rx_batch(rx_batch);
+    port.set_io_engine(engine);
+    port.start();
+
+    int sock = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    addr.sin_port = htons(udp_port);
+    connect(sock, (struct sockaddr *)&addr, sizeof(addr));
+
+    Feeder feeder;
+    std::thread writer(feed_stream, sock, total, 1, std::ref(feeder), true);
+    double seconds = consume(&port, total, bulk, feeder);
+    writer.join();
+
+    port.stop();
+    close(sock);
+    report("udp", mode_name(bulk, engine), total, seconds);
+}
+
+void bench_tcp(long total, bool bulk, int tcp_port, Generic_Port::Io_Engine engine)
+{
+    Feeder feeder;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+
+    // TCP_Server::start() waits for the client, so connect from the feeder thread
+    std::thread writer([&]() {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+        addr.sin_port = htons(tcp_port);
+        while (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        feed_stream(sock, total, 16, feeder, false);
+    });
+
+    TCP_Server port(tcp_port);
+    port.set_io_engine(engine);
+    port.start();
+    double seconds = consume(&port, total, bulk, feeder);
+    writer.join();
+
+    port.stop();
+    close(sock);
+    report("tcp", mode_name(bulk, engine), total, seconds);
+}
+
+// The same stream as bench_serial() without the kernel: what is left is the cost of the library itself.
+// Both sides run in this thread, so the scheduler does not take part either.
+void bench_loopback(long total, bool bulk)
+{
+    Loopback_Port port;
+    Loopback_Port feeder_port;
+    port.connect(&feeder_port);
+    port.start();
+    feeder_port.start();
+
+    std::vector<std::vector<uint8_t>> frames = make_frames(16);
+    std::vector<uint8_t> chunk;
+    mavlink_message_t messages[BATCH_MESSAGES];
+    long sent = 0;
+    long received = 0;
+
+    auto begin = std::chrono::steady_clock::now();
+    while (received < total)
+    {
+        // keep WINDOW_FRAMES in flight, 16 frames per write like the serial feeder
+        while (sent < total && sent - received < WINDOW_FRAMES)
+        {
+            chunk.clear();
+            int n = 0;
+            while (n < 16 && sent + n < total)
+            {
+                const std::vector<uint8_t> &frame = frames[(sent + n) % frames.size()];
+                chunk.insert(chunk.end(), frame.begin(), frame.end());
+                n++;
+            }
+            if (feeder_port.write_raw(chunk.data(), chunk.size()) <= 0)
+            {
+                break;
+            }
+            sent += n;
+        }
+
+        if (bulk)
+        {
+            received += port.read_messages(messages, BATCH_MESSAGES);
+        }
+        else
+        {
+            received += port.read_message(messages[0]);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    port.stop();
+    feeder_port.stop();
+    report("loopback", bulk ? "bulk" : "single", total, elapsed.count());
+}
+
+// Forwards frames from one pty serial port to another, raw frames through Port_Bridge
+// or decoded messages re-encoded by write_message()
+void bench_bridge(long total, bool zero_copy, Generic_Port::Io_Engine engine)
+{
+    // ptsname() reuses its buffer, so the slave names are copied
+    int masters[2];
+    std::string names[2];
+    for (int i = 0; i < 2; i++)
+    {
+        masters[i] = posix_openpt(O_RDWR | O_NOCTTY);
+        if (masters[i] < 0 || grantpt(masters[i]) < 0 || unlockpt(masters[i]) < 0)
+        {
+            perror("could not create pseudo terminal");
+            return;
+        }
+        names[i] = ptsname(masters[i]);
+    }
+
+    Serial_Port input(names[0].c_str(), 921600);
+    Serial_Port output(names[1].c_str(), 921600);
+    input.set_io_engine(engine);
+    output.set_io_engine(engine);
+    input.start();
+    output.start();
+
+    Port_Bridge bridge;
+    Port_Reactor reactor;
+    if (zero_copy)
+    {
+        bridge.add_port(&input);
+        bridge.add_port(&output);
+    }
+    else
+    {
+        reactor.add_port(&input, [&](Generic_Port *, const mavlink_message_t &message) {
+            output.write_message(message);
+        });
+    }
+
+    // The sink parses what reaches the far end of the output port
+    Feeder feeder;
+    std::thread sink([&]() {
+        mavlink_message_t message;
+        mavlink_status_t status;
+        memset(&status, 0, sizeof(status));
+        uint8_t buf[4096];
+        long received = 0;
+        while (received < total && !feeder.done)
+        {
+            ssize_t n = read(masters[1], buf, sizeof(buf));
+            for (ssize_t i = 0; i < n; i++)
+            {
+                if (mavlink_frame_char_buffer(&message, &status, buf[i], &message, &status) == MAVLINK_FRAMING_OK)
+                {
+                    received++;
+                }
+            }
+            feeder.consumed.store(received);
+        }
+    });
+
+    auto begin = std::chrono::steady_clock::now();
+    std::thread writer(feed_stream, masters[0], total, 16, std::ref(feeder), false);
+    while (feeder.consumed.load() < total)
+    {
+        if (zero_copy)
+        {
+            bridge.run_once(100);
+        }
+        else
+        {
+            reactor.run_once(100);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+    feeder.done = true;
+    writer.join();
+    sink.join();
+
+    input.stop();
+    output.stop();
+    close(masters[0]);
+    close(masters[1]);
+    std::string mode = zero_copy ? "raw" : "copy";
+    report("bridge", engine == Generic_Port::IO_ENGINE_URING ? mode + "/uring" : mode, total, elapsed.count());
+}
+
+// Replays an in-memory capture through the bulk parser of Generic_Port, written frames are only counted
+class Capture_Port : public Generic_Port
+{
+public:
+    Capture_Port(const std::vector<uint8_t> &capture) : capture(capture), offset(0), bytes_read(0), bytes_written(0)
+    {
+    }
+
+    unsigned long get_bytes_read()
+    {
+        return bytes_read;
+    }
+
+    unsigned long get_bytes_written()
+    {
+        return bytes_written;
+    }
+
+    int read_message(mavlink_message_t &message) override
+    {
+        return read_messages(&message, 1);
+    }
+
+    int read_messages(mavlink_message_t *messages, int max_messages) override
+    {
+        // the capture is read in chunks like a serial port would deliver it, then wraps around
+        int len = (int)std::min<size_t>(capture.size() - offset, 4096);
+        int pos = 0;
+        int count = _parse_buffer(capture.data() + offset, len, pos, messages, NULL, max_messages);
+        offset += pos;
+        bytes_read += pos;
+        if (offset == capture.size())
+        {
+            offset = 0;
+        }
+        return count;
+    }
+
+    int write_message(const mavlink_message_t &message) override
+    {
+        uint8_t buf[300];
+        unsigned len = mavlink_msg_to_send_buffer(buf, &message);
+        return write_raw(buf, len);
+    }
+
+    int write_raw(const uint8_t *, unsigned len) override
+    {
+        bytes_written += len;
+        return len;
+    }
+
+    bool is_running() override
+    {
+        return true;
+    }
+
+    void start() override
+    {
+    }
+
+    void stop() override
+    {
+    }
+
+private:
+    const std::vector<uint8_t> &capture;
+    size_t offset;
+    unsigned long bytes_read;
+    unsigned long bytes_written;
+};
+
+// Builds a capture of frames separated by noise, a share of the noise mimics start bytes
+std::vector<uint8_t> make_noisy_capture(int frame_count, int noise)
+{
+    std::vector<std::vector<uint8_t>> frames = make_frames(16);
+    std::mt19937 random(1);
+    std::vector<uint8_t> capture;
+    for (int i = 0; i < frame_count; i++)
+    {
+        for (int j = 0; j < noise; j++)
+        {
+            uint8_t byte = random() & 0xff;
+            capture.push_back(j % 64 == 0 ? MAVLINK_STX : byte);
+        }
+        const std::vector<uint8_t> &frame = frames[i % frames.size()];
+        capture.insert(capture.end(), frame.begin(), frame.end());
+    }
+    return capture;
+}
+
+void bench_resync(long total, bool scan, int noise)
+{
+    std::vector<uint8_t> capture = make_noisy_capture(1024, noise);
+    Capture_Port port(capture);
+    port.set_resync_scan(scan);
+
+    auto begin = std::chrono::steady_clock::now();
+    mavlink_message_t messages[BATCH_MESSAGES];
+    long received = 0;
+    while (received < total)
+    {
+        received += port.read_messages(messages, BATCH_MESSAGES);
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    report("resync", scan ? "scan" : "bytewise", received, elapsed.count());
+    std::cout << "  " << std::fixed << std::setprecision(1)
+              << port.get_bytes_read() / elapsed.count() / (1 << 20) << " MB/s of capture" << std::endl;
+}
+
+// Sends total SET_POSITION_TARGET_LOCAL_NED frames packed into mavlink_message_t or serialized directly
+void bench_tx(long total, bool direct)
+{
+    std::vector<uint8_t> capture;
+    Capture_Port port(capture);
+
+    mavlink_set_position_target_local_ned_t target;
+    memset(&target, 0, sizeof(target));
+    target.coordinate_frame = MAV_FRAME_BODY_OFFSET_NED;
+    target.type_mask = 2503;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < total; i++)
+    {
+        target.time_boot_ms = i;
+        target.yaw = i * 0.001f;
+        if (direct)
+        {
+            port.write_struct(255, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED, target);
+        }
+        else
+        {
+            mavlink_message_t message;
+            mavlink_msg_set_position_target_local_ned_encode(255, MAV_COMP_ID_ONBOARD_COMPUTER, &message, &target);
+            port.write_message(message);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    report("tx", direct ? "direct" : "message", total, elapsed.count());
+    std::cout << "  " << std::fixed << std::setprecision(1) << elapsed.count() * 1e9 / total << " ns/message, "
+              << port.get_bytes_written() / total << " bytes/frame" << std::endl;
+}
+
+// Keeps WINDOW_FRAMES received frames buffered, as heap mavlink_message_t copies or as arena frames
+void bench_arena(long total, bool pooled)
+{
+    std::vector<std::vector<uint8_t>> frames = make_frames(16);
+    std::vector<mavlink_message_t *> copies(WINDOW_FRAMES, NULL);
+    std::vector<Pooled_Frame *> buffered(WINDOW_FRAMES, NULL);
+    Message_Arena arena;
+
+    auto begin = std::chrono::steady_clock::now();
+    for (long i = 0; i < total; i++)
+    {
+        const std::vector<uint8_t> &frame = frames[i % frames.size()];
+        long slot = i % WINDOW_FRAMES;
+        if (pooled)
+        {
+            arena.release(buffered[slot]);
+            buffered[slot] = arena.copy(frame.data(), frame.size());
+        }
+        else
+        {
+            // what a consumer queueing read_messages() results does today
+            delete copies[slot];
+            copies[slot] = new mavlink_message_t;
+            Frame_View view = {frame.data(), (unsigned)frame.size()};
+            view.to_message(*copies[slot]);
+        }
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    unsigned long bytes = sizeof(mavlink_message_t) * WINDOW_FRAMES;
+    if (pooled)
+    {
+        bytes = arena.get_stats().bytes;
+    }
+    for (long slot = 0; slot < WINDOW_FRAMES; slot++)
+    {
+        arena.release(buffered[slot]);
+        delete copies[slot];
+    }
+
+    report("arena", pooled ? "pooled" : "heap", total, elapsed.count());
+    std::cout << "  " << bytes / WINDOW_FRAMES << " bytes per buffered frame" << std::endl;
+}
+
+// Compares Mavlink_Crc with crc_accumulate() for every length up to a whole packet, at every
+// alignment and split into two chained calls, returns the number of mismatches
+int check_crc()
+{
+    std::mt19937 random(2);
+    std::vector<uint8_t> bytes(MAVLINK_MAX_PACKET_LEN + 8);
+    for (uint8_t &byte : bytes)
+    {
+        byte = random() & 0xff;
+    }
+
+    int mismatches = 0;
+    for (unsigned len = 0; len <= MAVLINK_MAX_PACKET_LEN; len++)
+    {
+        for (unsigned offset = 0; offset < 8; offset++)
+        {
+            const uint8_t *buf = bytes.data() + offset;
+
+            uint16_t reference = X25_INIT_CRC;
+            crc_accumulate_buffer(&reference, (const char *)buf, len);
+            if (Mavlink_Crc::accumulate(buf, len) != reference)
+            {
+                std::cout << "checksum mismatch for " << len << " bytes at offset " << offset << std::endl;
+                mismatches++;
+            }
+        }
+
+        // a later call continues from the checksum of the earlier one
+        const uint8_t *buf = bytes.data();
+        uint16_t reference = X25_INIT_CRC;
+        crc_accumulate_buffer(&reference, (const char *)buf, len);
+        for (unsigned split = 0; split <= len; split++)
+        {
+            uint16_t crc = Mavlink_Crc::accumulate(buf, split);
+            if (Mavlink_Crc::accumulate(buf + split, len - split, crc) != reference)
+            {
+                std::cout << "checksum mismatch for " << len << " bytes split at " << split << std::endl;
+                mismatches++;
+            }
+        }
+    }
+
+    return mismatches;
+}
+
+// Checksums total frames of each payload size with crc_accumulate() or Mavlink_Crc,
+// returns the number of checksum mismatches found beforehand
+int bench_crc(long total, bool sliced)
+{
+    int mismatches = check_crc();
+
+    std::mt19937 random(1);
+    for (unsigned payload_len : {8, 32, 64, 128, 255})
+    {
+        // the checksum covers the header after the start byte, the payload and CRC_EXTRA
+        std::vector<uint8_t> frame(MAVLINK_CORE_HEADER_LEN + payload_len + 1);
+        for (uint8_t &byte : frame)
+        {
+            byte = random() & 0xff;
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        volatile uint16_t sink = 0;
+        for (long i = 0; i < total; i++)
+        {
+            // the first byte changes so the loop is not hoisted
+            frame[0] = i;
+            if (sliced)
+            {
+                sink = Mavlink_Crc::accumulate(frame.data(), frame.size());
+            }
+            else
+            {
+                uint16_t crc = X25_INIT_CRC;
+                crc_accumulate_buffer(&crc, (const char *)frame.data(), frame.size());
+                sink = crc;
+            }
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+        report("crc", (sliced ? "slice8/" : "bytewise/") + std::to_string(payload_len), total, elapsed.count());
+    }
+
+    return mismatches;
+}
+
+// Compares Message_Entries with mavlink_get_msg_entry() for every 24-bit msgid,
+// returns the number of mismatches
+int check_lookup()
+{
+    int mismatches = 0;
+    for (uint32_t msgid = 0; msgid < (1 << 24); msgid++)
+    {
+        const mavlink_msg_entry_t *reference = mavlink_get_msg_entry(msgid);
+        const mavlink_msg_entry_t *entry = Message_Entries::find(msgid);
+        if ((reference == NULL) != (entry == NULL) || (entry && memcmp(entry, reference, sizeof(*entry)) != 0))
+        {
+            std::cout << "entry mismatch for msgid " << msgid << std::endl;
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+// Looks up the entries of a telemetry-like msgid mix with mavlink_get_msg_entry() or Message_Entries,
+// returns the number of entry mismatches found beforehand
+int bench_lookup(long total, bool indexed)
+{
+    int mismatches = check_lookup();
+
+    // heartbeat, sys_status, gps_raw_int, attitude, local/global position, vfr_hud, command_long/ack,
+    // set_position_target, highres_imu, battery_status, extended_sys_state, message_interval, statustext
+    // and one id unknown to most dialects
+    const uint32_t msgids[] = {0, 1, 24, 30, 32, 33, 74, 76, 77, 84, 105, 147, 245, 244, 253, 12915, 60000};
+    const int count = sizeof(msgids) / sizeof(msgids[0]);
+
+    auto begin = std::chrono::steady_clock::now();
+    volatile unsigned sink = 0;
+    for (long i = 0; i < total; i++)
+    {
+        uint32_t msgid = msgids[i % count];
+        const mavlink_msg_entry_t *entry = indexed ? Message_Entries::find(msgid) : mavlink_get_msg_entry(msgid);
+        sink = entry ? entry->crc_extra : 0;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+
+    report("lookup", indexed ? "indexed" : "search", total, elapsed.count());
+
+    return mismatches;
+}
+
+int main(int argc, char **argv)
+{
+    cxxopts::Options options("communication_module_benchmark", "frames/sec of the port read paths");
+    options.add_options()("n,frames", "frames per run", cxxopts::value<long>()->default_value("200000"))(
+        "port", "serial, udp, tcp, loopback, bridge, resync, crc, lookup, tx, arena or all", cxxopts::value<std::string>()->default_value("all"))(
+        "serial-mode", "serial rx mode: latency or throughput", cxxopts::value<std::string>()->default_value("latency"))(
+        "udp-batch", "datagrams per recvmmsg() call, 1 disables batching", cxxopts::value<int>()->default_value("1"))(
+        "noise", "noise bytes between frames of the resync capture", cxxopts::value<int>()->default_value("256"))(
+        "engine", "io engine: syscall, uring or both", cxxopts::value<std::string>()->default_value("syscall"))(
+        "u,udp", "first local udp port", cxxopts::value<int>()->default_value("14650"))(
+        "t,tcp", "first local tcp port", cxxopts::value<int>()->default_value("8900"))(
+        "h,help", "Print usage");
+    auto result = options.parse(argc, argv);
+
+    if (result.count("help"))
+    {
+        std::cout << options.help() << std::endl;
+        exit(0);
+    }
+
+    long frames = result["frames"].as<long>();
+    std::string port = result["port"].as<std::string>();
+    int udp_port = result["udp"].as<int>();
+    int tcp_port = result["tcp"].as<int>();
+    int udp_batch = result["udp-batch"].as<int>();
+    int noise = result["noise"].as<int>();
+    Serial_Port::Rx_Mode serial_mode = result["serial-mode"].as<std::string>() == "throughput"
+                                           ? Serial_Port::RX_MODE_THROUGHPUT
+                                           : Serial_Port::RX_MODE_LATENCY;
+    std::string engine_name = result["engine"].as<std::string>();
+
+    std::vector<Generic_Port::Io_Engine> engines;
+    if (engine_name != "uring")
+    {
+        engines.push_back(Generic_Port::IO_ENGINE_SYSCALL);
+    }
+    if (engine_name == "uring" || engine_name == "both")
+    {
+        engines.push_back(Generic_Port::IO_ENGINE_URING);
+    }
+    Generic_Port::Io_Engine engine = Generic_Port::IO_ENGINE_SYSCALL;
+
+    // runs that also check results against the MAVLink library count their mismatches here
+    int failures = 0;
+
+    // every run binds its own port number, sockets of the previous run may linger in TIME_WAIT
+    std::vector<std::pair<std::string, std::function<void(bool, int)>>> runs = {
+        {"serial", [&](bool bulk, int) { bench_serial(frames, bulk, serial_mode, engine); }},
+        {"udp", [&](bool bulk, int i) { bench_udp(frames, bulk, udp_port + i, udp_batch, engine); }},
+        {"tcp", [&](bool bulk, int i) { bench_tcp(frames, bulk, tcp_port + i, engine); }},
+        {"loopback", [&](bool bulk, int) {
+             // no kernel involved, the io engine does not matter
+             if (engine == Generic_Port::IO_ENGINE_SYSCALL)
+             {
+                 bench_loopback(frames, bulk);
+             }
+         }},
+        {"bridge", [&](bool bulk, int) { bench_bridge(frames, bulk, engine); }},
+        {"resync", [&](bool bulk, int) {
+             // parsing only, the io engine does not matter
+             if (engine == Generic_Port::IO_ENGINE_SYSCALL)
+             {
+                 bench_resync(frames, bulk, noise);
+             }
+         }},
+        {"crc", [&](bool bulk, int) {
+             if (engine == Generic_Port::IO_ENGINE_SYSCALL)
+             {
+                 failures += bench_crc(frames * 10, bulk);
+             }
+         }},
+        {"lookup", [&](bool bulk, int) {
+             if (engine == Generic_Port::IO_ENGINE_SYSCALL)
+             {
+                 failures += bench_lookup(frames * 100, bulk);
+             }
+         }},
+        {"tx", [&](bool bulk, int) {
+             if (engine == Generic_Port::IO_ENGINE_SYSCALL)
+             {
+                 bench_tx(frames * 10, bulk);
+             }
+         }},
+        {"arena", [&](bool bulk, int) {
+             if (engine == Generic_Port::IO_ENGINE_SYSCALL)
+             {
+                 bench_arena(frames * 10, bulk);
+             }
+         }},
+    };
+
+    std::cout << std::left << std::setw(10) << "port" << std::setw(14) << "mode"
+              << std::right << std::setw(10) << "frames" << std::setw(12) << "seconds"
+              << std::setw(14) << "frames/s" << std::endl;
+
+    int run_index = 0;
+    for (Generic_Port::Io_Engine selected : engines)
+    {
+        engine = selected;
+        for (auto &run : runs)
+        {
+            if (port != "all" && port != run.first)
+            {
+                continue;
+            }
+            run.second(false, run_index++);
+            run.second(true, run_index++);
+        }
+    }
+
+    if (failures > 0)
+    {
+        std::cout << failures << " mismatches against the MAVLink library" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}
@@ -1,3 +1,6 @@
+#include <message_dispatcher.h>
+#include <message_subscriptions.h>
+#include <replay_port.h>
 #include <serial_port.h>
 #include <udp_port.h>
 #include <tcp_server.h>
@@ -13,6 +16,7 @@ const float TURN_RIGHT_DEGREES = 1.5708;    // 90d
 const float GO_FORWARD_METERS = 100;  
 const float PRECISION = 0.1;  
 const float PRECISION_XYZ = 5;
+const float STREAM_RATE_HZ = 10;     // ATTITUDE and LOCAL_POSITION_NED rate
 
 
 // Constrains an angle (in radians) to [-π, π]
@@ -23,24 +27,14 @@ inline double wrapToPi(double angle) {
     return angle - M_PI;                     // Shift back to [-π, π]
 }
 
-void turn_right(mavlink_message_t message, Generic_Port *port){
-    // turn right
-    mavlink_msg_set_position_target_local_ned_pack(
-        255,                                // Sender system ID
-        MAV_COMP_ID_ONBOARD_COMPUTER,        // Sender component ID
-        &message,                                // MAVLink message to pack into
-        0,                                   // Timestamp (not used)
-        0,                                   // Target system ID
-        0,                                   // Target component ID
-        MAV_FRAME_BODY_OFFSET_NED,                 // Coordinate frame
-        2503,                                   // Type mask (velocity control)
-        0, 0, 0,                             // x, y, z position (not used)
-        0, 0, 0,                             // vx, vy, vz velocity (1 m/s North)
-        0, 0, 0,                             // afx, afy, afz acceleration (not used)
-        TURN_RIGHT_DEGREES,                                   // Yaw angle 90d
-        0                                    // Yaw rate (not used)
-    );
-    int len = port->write_message(message);
+void turn_right(Generic_Port *port){
+    // turn right, serialized straight into the port's transmit path
+    mavlink_set_position_target_local_ned_t target;
+    memset(&target, 0, sizeof(target));
+    target.coordinate_frame = MAV_FRAME_BODY_OFFSET_NED;    // Coordinate frame
+    target.type_mask = 2503;                                // Type mask (velocity control)
+    target.yaw = TURN_RIGHT_DEGREES;                        // Yaw angle 90d
+    int len = port->write_struct(255, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED, target);
     if (len <= 0) {
         std::cerr << "WARNING (R): could not send mavlink_msg_set_position_target_local_ned_pack" << std::endl;
     } else {
@@ -48,24 +42,14 @@ void turn_right(mavlink_message_t message, Generic_Port *port){
     }
 }
 
-void go_forward_100_m(mavlink_message_t message, Generic_Port *port){
+void go_forward_100_m(Generic_Port *port){
     // go forward
-    mavlink_msg_set_position_target_local_ned_pack(
-        255,                                // Sender system ID
-        MAV_COMP_ID_ONBOARD_COMPUTER,        // Sender component ID
-        &message,                                // MAVLink message to pack into
-        0,                                   // Timestamp (not used)
-        0,                                   // Target system ID
-        0,                                   // Target component ID
-        MAV_FRAME_BODY_OFFSET_NED,                 // Coordinate frame
-        3576,                                   // Type mask (velocity control)
-        GO_FORWARD_METERS, 0, 0,                             // x, y, z position (not used)
-        0, 0, 0,                             // vx, vy, vz velocity (1 m/s North)
-        0, 0, 0,                             // afx, afy, afz acceleration (not used)
-        0,                                   // Yaw angle (not used)
-        0                                    // Yaw rate (not used)
-    );
-    int len = port->write_message(message);
+    mavlink_set_position_target_local_ned_t target;
+    memset(&target, 0, sizeof(target));
+    target.coordinate_frame = MAV_FRAME_BODY_OFFSET_NED;    // Coordinate frame
+    target.type_mask = 3576;                                // Type mask (position control)
+    target.x = GO_FORWARD_METERS;                           // x position
+    int len = port->write_struct(255, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_MSG_ID_SET_POSITION_TARGET_LOCAL_NED, target);
     if (len <= 0) {
         std::cerr << "WARNING (F): could not send mavlink_msg_set_position_target_local_ned_pack" << std::endl;
     } else {
@@ -73,44 +57,6 @@ void go_forward_100_m(mavlink_message_t message, Generic_Port *port){
     }
 }
 
-void request_local_position_ned(Generic_Port *port){
-    mavlink_command_long_t cmd = {};
-    cmd.target_system = 1; // Target system ID
-    cmd.target_component = 1; // Target component ID
-    cmd.command = MAV_CMD_REQUEST_MESSAGE;
-    cmd.param1 = MAVLINK_MSG_ID_LOCAL_POSITION_NED; // Request current position message
-    cmd.param2 = 0; // Unused
-    cmd.param3 = 0; // Unused
-    cmd.param4 = 0; // Unused
-    cmd.param5 = 0; // Unused
-    cmd.param6 = 0; // Unused
-    cmd.param7 = 0; // Unused
-
-    mavlink_message_t msg;
-    mavlink_msg_command_long_encode(255, MAV_COMP_ID_ONBOARD_COMPUTER, &msg, &cmd);
-
-    int len = port->write_message(msg);
-    if (len <= 0) {
-        std::cerr << "WARNING: could not send MAV_CMD_REQUEST_MESSAGE" << std::endl;
-    } else {
-        std::cout << "Requested MISSION_CURRENT message" << std::endl;
-    }
-}
-
-void request_attitude(Generic_Port *port){
-    mavlink_command_long_t cmd = {};
-    cmd.target_system = 1;                   // Target system ID
-    cmd.target_component = 1;                // Target component ID
-    cmd.command = MAV_CMD_REQUEST_MESSAGE;   // Command to request a message
-    cmd.param1 = MAVLINK_MSG_ID_ATTITUDE;    // Request ATTITUDE message
-    // Set unused params to 0
-    cmd.param2 = cmd.param3 = cmd.param4 = cmd.param5 = cmd.param6 = cmd.param7 = 0;
-
-    mavlink_message_t msg;
-    mavlink_msg_command_long_encode(255, MAV_COMP_ID_ONBOARD_COMPUTER, &msg, &cmd);
-    port->write_message(msg);  // Send the request
-}
-
 bool is_turned_right(mavlink_attitude_t expected_rpy, mavlink_attitude_t actual_rpy){
     if (abs(expected_rpy.yaw-actual_rpy.yaw)<PRECISION){
         return true;
@@ -142,6 +88,10 @@ int main(int argc, char **argv)
         "a, address", "udp address", cxxopts::value<std::string>()->default_value("none"))(
         "p,port", "udp port", cxxopts::value<int>()->default_value("14550"))("t,tcp", "tcp_port", cxxopts::value<int>()->default_value("8800"))(
         "hz", "timesync hz", cxxopts::value<int>()->default_value("10"))(
+        "rx-thread", "receive in a background thread")(
+        "record", "record received frames to <prefix>_<n>.tlog", cxxopts::value<std::string>()->default_value(""))(
+        "replay", "replay a tlog or raw capture instead of a port", cxxopts::value<std::string>()->default_value(""))(
+        "speed", "replay speed factor, 0 - as fast as possible", cxxopts::value<double>()->default_value("1"))(
         "h,help", "Print usage");
     auto result = options.parse(argc, argv);
 
@@ -157,10 +107,20 @@ int main(int argc, char **argv)
     int udp_port = result["port"].as<int>();
     int timesync_hz = result["hz"].as<int>();
     int tcp_port = result["tcp"].as<int>();
+    bool rx_thread = result.count("rx-thread") > 0;
+    std::string record_prefix = result["record"].as<std::string>();
+    std::string replay_path = result["replay"].as<std::string>();
+    double replay_speed = result["speed"].as<double>();
 
     Generic_Port *port;
 
-    if (serial_device == "none" && udp_address == "none" && tcp_port == -1 || serial_device != "none" && udp_address != "none" && tcp_port != -1)
+    if (!replay_path.empty())
+    {
+        Replay_Port *replay = new Replay_Port(replay_path.c_str());
+        replay->set_speed(replay_speed);
+        port = replay;
+    }
+    else if (serial_device == "none" && udp_address == "none" && tcp_port == -1 || serial_device != "none" && udp_address != "none" && tcp_port != -1)
     {
         std::cout << options.help() << std::endl;
         exit(0);
@@ -178,7 +138,22 @@ int main(int argc, char **argv)
         port = new TCP_Server(tcp_port);
     }
 
+    // the recorder writes from its own thread, the port only queues frames
+    Tlog_Recorder recorder;
+    if (!record_prefix.empty())
+    {
+        recorder.set_rotation(64 << 20, 0);
+        if (recorder.start(record_prefix.c_str()))
+        {
+            port->set_recorder(&recorder);
+        }
+    }
+
     port->start();
+    if (rx_thread && !port->start_rx_thread())
+    {
+        exit(EXIT_FAILURE);
+    }
     bool success;   // response result
 
     mavlink_local_position_ned_t expected_xyz;
@@ -194,18 +169,59 @@ int main(int argc, char **argv)
 
     // messages
     mavlink_mission_current_t mission_current;
-    // time
-    std::chrono::time_point<std::chrono::system_clock> last_req_mess_sent, time_now;
-    int freq = 1;
-    std::chrono::duration<double> elapsed_seconds;
 
     
-    last_req_mess_sent = std::chrono::system_clock::now(); // not sent yet, wait 1 second
+    Message_Dispatcher dispatcher;
+
+    dispatcher.set_handler(MAVLINK_MSG_ID_LOCAL_POSITION_NED, mavlink_msg_local_position_ned_decode,
+        [&](const mavlink_message_t &, const mavlink_local_position_ned_t &position) {
+            actual_xyz = position;
+
+            if (allow_forward) {
+                go_forward_100_m(port);
+                allow_forward = false;
+                is_going_forward = true;
+                expected_xyz = modify_xyz(actual_xyz, actual_rpy);
+            }
+
+            else if (is_going_forward && is_went_forward(expected_xyz, actual_xyz)) {
+                std::cout<<"COMPLETE FORWARD"<<std::endl;
+
+                allow_right = true;
+                is_going_forward = false;
+            }
+        });
+
+    dispatcher.set_handler(MAVLINK_MSG_ID_ATTITUDE, mavlink_msg_attitude_decode,
+        [&](const mavlink_message_t &, const mavlink_attitude_t &attitude) {
+            actual_rpy = attitude;
+            if (allow_right){
+                turn_right(port);
+                allow_right = false;
+                is_turning_right = true;
+                expected_rpy = actual_rpy;
+                expected_rpy.yaw += TURN_RIGHT_DEGREES; 
+                expected_rpy.yaw = wrapToPi(expected_rpy.yaw);  // CONSTRAIN to [-pi, pi]
+            }
+            else if (is_turning_right && is_turned_right(expected_rpy, actual_rpy)) {
+                std::cout<<"COMPLETE RIGHT"<<std::endl;
+
+                allow_forward = true;
+                is_turning_right = false;
+            }
+        });
+
+    // the vehicle streams both messages, polling is left to the subscriptions as a fallback
+    Message_Subscriptions subscriptions(port);
+    subscriptions.subscribe(MAVLINK_MSG_ID_ATTITUDE, STREAM_RATE_HZ);
+    subscriptions.subscribe(MAVLINK_MSG_ID_LOCAL_POSITION_NED, STREAM_RATE_HZ);
+
     while (true)
     {
         mavlink_message_t message;
-        success = port->read_message(message);
-        time_now = std::chrono::system_clock::now();
+        // with the RX thread a slow iteration no longer holds back reading the port
+        success = rx_thread ? port->pop_message(message, 100) : port->read_message(message);
+        subscriptions.update();
         
         
         if (success)
@@ -213,56 +229,8 @@ int main(int argc, char **argv)
             
             //TODO: add mode guided setup, arming the throttle
 
-
-            elapsed_seconds = time_now - last_req_mess_sent;
-            if (elapsed_seconds.count() >= freq){ // check the mission state every <freq> seconds
-                if (allow_right || is_turning_right) {
-                    request_attitude(port); // ask roll pitch yaw
-                }
-                else if (allow_forward || is_going_forward){
-                    request_local_position_ned(port); // ask x y z
-                }
-                last_req_mess_sent = std::chrono::system_clock::now();
-            }
-            
-
-            if (message.msgid == MAVLINK_MSG_ID_LOCAL_POSITION_NED){
-                mavlink_msg_local_position_ned_decode(&message, &actual_xyz);
-                
-
-                mavlink_message_t message_set_pos;
-                if (allow_forward) {
-                    go_forward_100_m(message_set_pos, port);
-                    allow_forward = false;
-                    is_going_forward = true;
-                    expected_xyz = modify_xyz(actual_xyz, actual_rpy);
-                }
-
-                else if (is_going_forward && is_went_forward(expected_xyz, actual_xyz)) {
-                    std::cout<<"COMPLETE FORWARD"<<std::endl;
-
-                    allow_right = true;
-                    is_going_forward = false;
-                }
-
-            } else if (message.msgid == MAVLINK_MSG_ID_ATTITUDE){
-                mavlink_msg_attitude_decode(&message, &actual_rpy);
-                mavlink_message_t message_set_pos;
-                if (allow_right){
-                    turn_right(message_set_pos, port);
-                    allow_right = false;
-                    is_turning_right = true;
-                    expected_rpy = actual_rpy;
-                    expected_rpy.yaw += TURN_RIGHT_DEGREES; 
-                    expected_rpy.yaw = wrapToPi(expected_rpy.yaw);  // CONSTRAIN to [-pi, pi]
-                }
-                else if (is_turning_right && is_turned_right(expected_rpy, actual_rpy)) {
-                    std::cout<<"COMPLETE RIGHT"<<std::endl;
-
-                    allow_forward = true;
-                    is_turning_right = false;
-                }
-            }        
+            subscriptions.handle_message(message);
+            dispatcher.dispatch(message);
         }   
     }
 
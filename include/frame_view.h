@@ -0,0 +1,192 @@
+#ifndef FRAME_VIEW_H_
+#define FRAME_VIEW_H_
+
+#include <string.h>
+
+#include <common/mavlink.h>
+
+#include "message_entries.h"
+
+/**
+ * @brief Представление принятого кадра MAVLink без копирования.
+ *
+ * Указывает на байты кадра в том виде, в каком он пришел по каналу, и читает поля
+ * заголовка прямо из них. Действительно до следующего чтения порта, выдавшего кадр.
+ */
+struct Frame_View
+{
+    const uint8_t *data; ///< Байты кадра: заголовок, полезная нагрузка, контрольная сумма и подпись.
+    unsigned len; ///< Длина кадра.
+
+    /**
+     * @brief Проверяет, является ли кадр кадром MAVLink 2.
+     *
+     * @return true для MAVLink 2, false для MAVLink 1.
+     */
+    bool is_v2() const
+    {
+        return data[0] == MAVLINK_STX;
+    }
+
+    /**
+     * @brief Возвращает длину полезной нагрузки.
+     *
+     * @return uint8_t Длина, для MAVLink 2 без отброшенных нулей в конце.
+     */
+    uint8_t payload_len() const
+    {
+        return data[1];
+    }
+
+    /**
+     * @brief Возвращает флаги несовместимости (0 для MAVLink 1).
+     *
+     * @return uint8_t Флаги.
+     */
+    uint8_t incompat_flags() const
+    {
+        return is_v2() ? data[2] : 0;
+    }
+
+    /**
+     * @brief Возвращает флаги совместимости (0 для MAVLink 1).
+     *
+     * @return uint8_t Флаги.
+     */
+    uint8_t compat_flags() const
+    {
+        return is_v2() ? data[3] : 0;
+    }
+
+    /**
+     * @brief Возвращает номер кадра в последовательности отправителя.
+     *
+     * @return uint8_t Номер.
+     */
+    uint8_t seq() const
+    {
+        return data[is_v2() ? 4 : 2];
+    }
+
+    /**
+     * @brief Возвращает идентификатор системы отправителя.
+     *
+     * @return uint8_t Идентификатор.
+     */
+    uint8_t sysid() const
+    {
+        return data[is_v2() ? 5 : 3];
+    }
+
+    /**
+     * @brief Возвращает идентификатор компонента отправителя.
+     *
+     * @return uint8_t Идентификатор.
+     */
+    uint8_t compid() const
+    {
+        return data[is_v2() ? 6 : 4];
+    }
+
+    /**
+     * @brief Возвращает идентификатор сообщения.
+     *
+     * @return uint32_t Идентификатор.
+     */
+    uint32_t msgid() const
+    {
+        if (!is_v2())
+        {
+            return data[5];
+        }
+        return data[7] | ((uint32_t)data[8] << 8) | ((uint32_t)data[9] << 16);
+    }
+
+    /**
+     * @brief Возвращает указатель на полезную нагрузку.
+     *
+     * @return const uint8_t* Первые payload_len() байт полезной нагрузки.
+     */
+    const uint8_t *payload() const
+    {
+        return data + (is_v2() ? MAVLINK_NUM_HEADER_BYTES : MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1);
+    }
+
+    /**
+     * @brief Возвращает контрольную сумму кадра.
+     *
+     * @return uint16_t Контрольная сумма.
+     */
+    uint16_t checksum() const
+    {
+        const uint8_t *ck = payload() + payload_len();
+        return ck[0] | (ck[1] << 8);
+    }
+
+    /**
+     * @brief Проверяет, подписан ли кадр.
+     *
+     * @return true если кадр содержит блок подписи.
+     */
+    bool is_signed() const
+    {
+        return (incompat_flags() & MAVLINK_IFLAG_SIGNED) != 0;
+    }
+
+    /**
+     * @brief Копирует полезную нагрузку в структуру сообщения.
+     *
+     * Структуры сообщений MAVLink повторяют порядок полей на линии, поэтому на хостах с
+     * порядком байт little-endian это равносильно mavlink_msg_*_decode(). Отброшенные
+     * нули MAVLink 2 восстанавливаются.
+     *
+     * @param value Структура сообщения, например mavlink_attitude_t.
+     */
+    template <typename T>
+    void decode(T &value) const
+    {
+        unsigned len = payload_len() < sizeof(T) ? payload_len() : sizeof(T);
+        memset(&value, 0, sizeof(T));
+        memcpy(&value, payload(), len);
+    }
+
+    /**
+     * @brief Восстанавливает mavlink_message_t для функций библиотеки MAVLink.
+     *
+     * Отброшенные нули MAVLink 2 восстанавливаются до полной длины сообщения, поэтому в
+     * повторно используемой структуре не остается полей предыдущего сообщения.
+     *
+     * @param message Сообщение.
+     */
+    void to_message(mavlink_message_t &message) const
+    {
+        message.magic = data[0];
+        message.len = payload_len();
+        message.incompat_flags = incompat_flags();
+        message.compat_flags = compat_flags();
+        message.seq = seq();
+        message.sysid = sysid();
+        message.compid = compid();
+        message.msgid = msgid();
+        message.checksum = checksum();
+        memcpy(message.payload64, payload(), payload_len());
+
+        // decoders read the whole message, including the zeros cut off on the wire
+        const mavlink_msg_entry_t *entry = Message_Entries::find(msgid());
+        unsigned full_len = entry ? entry->max_msg_len : MAVLINK_MAX_PAYLOAD_LEN;
+        if (full_len > payload_len())
+        {
+            memset((uint8_t *)message.payload64 + payload_len(), 0, full_len - payload_len());
+        }
+
+        const uint8_t *ck = payload() + payload_len();
+        message.ck[0] = ck[0];
+        message.ck[1] = ck[1];
+        if (is_signed())
+        {
+            memcpy(message.signature, ck + MAVLINK_NUM_CHECKSUM_BYTES, MAVLINK_SIGNATURE_BLOCK_LEN);
+        }
+    }
+};
+
+#endif // FRAME_VIEW_H_
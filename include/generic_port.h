@@ -1,8 +1,24 @@
 #ifndef GENERIC_PORT_H_
 #define GENERIC_PORT_H_
 
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <atomic>
+
 #include <common/mavlink.h>
 
+#include "frame_view.h"
+#include "mavlink_crc.h"
+#include "message_arena.h"
+#include "message_entries.h"
+#include "telemetry_cache.h"
+#include "tlog_recorder.h"
+
 /**
  * @brief Абстрактный класс для представления общего интерфейса порта.
  * 
@@ -13,14 +29,32 @@ class Generic_Port
 {
 public:
     /**
-     * @brief Конструктор по умолчанию.
+     * @brief Механизм ввода-вывода порта.
+     */
+    enum Io_Engine
+    {
+        IO_ENGINE_SYSCALL, ///< Системные вызовы read/write/recv/send и epoll.
+        IO_ENGINE_URING    ///< Очередь io_uring: многократный прием и пакетная передача.
+    };
+
+    /**
+     * @brief Принятый кадр в том виде, в каком он пришел по каналу.
      */
-    Generic_Port() {};
+    struct Raw_Frame
+    {
+        const uint8_t *data; ///< Байты кадра в буфере приема порта или NULL, если кадр пришел несколькими порциями.
+        unsigned len; ///< Длина кадра.
+    };
 
     /**
-     * @brief Виртуальный деструктор.
+     * @brief Конструктор по умолчанию. Сбрасывает состояние разбора порта.
      */
-    virtual ~Generic_Port() {};
+    Generic_Port();
+
+    /**
+     * @brief Виртуальный деструктор. Поток приема должен быть остановлен до него.
+     */
+    virtual ~Generic_Port();
 
     /**
      * @brief Читает сообщение.
@@ -30,6 +64,18 @@ public:
      */
     virtual int read_message(mavlink_message_t &message) = 0;
 
+    /**
+     * @brief Читает все сообщения из очередной порции принятых данных.
+     * 
+     * Порция данных разбирается целиком под одной блокировкой порта. Если сообщений
+     * в порции больше, чем max_messages, оставшиеся байты будут разобраны при следующем вызове.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param max_messages Размер массива messages.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    virtual int read_messages(mavlink_message_t *messages, int max_messages) = 0;
+
     /**
      * @brief Записывает сообщение.
      * 
@@ -38,6 +84,276 @@ public:
      */
     virtual int write_message(const mavlink_message_t &message) = 0;
 
+    /**
+     * @brief Читает сообщения вместе с их исходными байтами.
+     * 
+     * Работает как read_messages(), дополнительно для каждого сообщения возвращает кадр
+     * в буфере приема порта. Кадры действительны до следующего чтения порта. Не используется
+     * вместе с фоновым потоком приема.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param frames Массив кадров того же размера.
+     * @param max_messages Размер массивов.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    int read_frames(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+    /**
+     * @brief Читает кадры в виде представлений без копирования в mavlink_message_t.
+     * 
+     * Представления указывают в буфер приема порта, кадры, пришедшие несколькими порциями,
+     * собираются в буфере порта. Представления действительны до следующего чтения порта.
+     * Вызывается из одного потока и не используется вместе с фоновым потоком приема.
+     * 
+     * @param views Массив представлений.
+     * @param max_views Размер массива views.
+     * @return int Количество прочитанных кадров или -1 при ошибке чтения.
+     */
+    int read_views(Frame_View *views, int max_views);
+
+    /**
+     * @brief Читает кадры и копирует их в пул кадров.
+     * 
+     * Кадры занимают блоки по своей длине, а не полный mavlink_message_t, и остаются
+     * действительными до освобождения через arena.release(). Ограничения как у read_views().
+     * 
+     * @param arena Пул кадров.
+     * @param frames Массив для кадров.
+     * @param max_frames Размер массива frames.
+     * @return int Количество прочитанных кадров или -1 при ошибке чтения.
+     */
+    int read_pooled(Message_Arena &arena, Pooled_Frame **frames, int max_frames);
+
+    /**
+     * @brief Записывает кадр пула без сериализации.
+     * 
+     * Кадр не освобождается, владелец может передать его другим портам.
+     * 
+     * @param frame Кадр.
+     * @return int Результат как у write_raw().
+     */
+    int write_pooled(const Pooled_Frame *frame)
+    {
+        return write_raw(frame->data(), frame->len);
+    }
+
+    /**
+     * @brief Записывает готовый кадр без сериализации.
+     * 
+     * @param buf Байты одного или нескольких кадров.
+     * @param len Длина данных.
+     * @return int Результат как у write_message() или -1, если порт не поддерживает запись кадров.
+     */
+    virtual int write_raw(const uint8_t *buf, unsigned len)
+    {
+        return -1;
+    }
+
+    /**
+     * @brief Сериализует структуру сообщения прямо в кадр передачи.
+     * 
+     * Пример: write_struct(255, MAV_COMP_ID_ONBOARD_COMPUTER, MAVLINK_MSG_ID_ATTITUDE, attitude).
+     * 
+     * @param system_id Идентификатор системы отправителя.
+     * @param component_id Идентификатор компонента отправителя.
+     * @param msgid Идентификатор сообщения.
+     * @param value Структура сообщения, например mavlink_attitude_t.
+     * @return int Результат как у write_message() или -1, если сообщения нет в диалекте или
+     * размер структуры не совпадает с его длиной.
+     */
+    template <typename T>
+    int write_struct(uint8_t system_id, uint8_t component_id, uint32_t msgid, const T &value)
+    {
+        return write_payload(system_id, component_id, msgid, &value, sizeof(T));
+    }
+
+    /**
+     * @brief Сериализует полезную нагрузку прямо в кадр передачи.
+     * 
+     * Кадр MAVLink 2 без подписи собирается сразу в очереди передачи порта (или во временном
+     * буфере, из которого он один раз копируется в сокет), без промежуточного
+     * mavlink_message_t. Контрольная сумма вычисляется по собранному кадру. Номера кадров
+     * ведутся портом отдельно от номеров, которые mavlink_msg_*_pack() присваивает
+     * сообщениям, передаваемым через write_message().
+     * 
+     * @param system_id Идентификатор системы отправителя.
+     * @param component_id Идентификатор компонента отправителя.
+     * @param msgid Идентификатор сообщения.
+     * @param payload Полезная нагрузка в порядке полей на линии (структура сообщения на хосте little-endian).
+     * @param len Длина полезной нагрузки, равная полной длине сообщения (max_msg_len).
+     * @return int Результат как у write_message() или -1, если сообщения нет в диалекте или
+     * длина не совпадает.
+     */
+    int write_payload(uint8_t system_id, uint8_t component_id, uint32_t msgid, const void *payload, unsigned len);
+
+    /**
+     * @brief Дожидается фактической отправки всех ранее записанных сообщений.
+     * 
+     * Порты без собственной очереди передачи отправляют данные сразу в write_message(),
+     * поэтому по умолчанию ничего не делает.
+     * 
+     * @return int 0 при успехе, -1 при ошибке.
+     */
+    virtual int flush()
+    {
+        return 0;
+    }
+
+    /**
+     * @brief Выбирает механизм ввода-вывода. Вызывается до запуска порта.
+     * 
+     * Если io_uring недоступен при запуске, порт работает через системные вызовы.
+     * 
+     * @param engine Механизм ввода-вывода.
+     * @return true если порт поддерживает механизм.
+     * @return false если механизм не поддерживается или порт уже запущен.
+     */
+    virtual bool set_io_engine(Io_Engine engine)
+    {
+        return engine == IO_ENGINE_SYSCALL;
+    }
+
+    /**
+     * @brief Возвращает дескриптор, готовность которого к чтению означает,
+     * что read_messages() не заблокируется.
+     * 
+     * Используется Port_Reactor для регистрации порта в epoll.
+     * 
+     * @return int Дескриптор или -1, если порт не поддерживает ожидание готовности.
+     */
+    virtual int get_fd()
+    {
+        return -1;
+    }
+
+    /**
+     * @brief Возвращает количество принятых, но еще не разобранных байт.
+     * 
+     * Если значение больше нуля, read_messages() вернет сообщения без обращения к системе.
+     * 
+     * @return int Количество байт.
+     */
+    virtual int rx_pending()
+    {
+        return 0;
+    }
+
+    /**
+     * @brief Запускает фоновый поток приема запущенного порта.
+     * 
+     * Поток читает порт через read_messages() и складывает сообщения в кольцевую очередь
+     * с одним производителем и одним потребителем. Сообщения забираются pop_messages()
+     * без блокировки порта. Если очередь заполнена, новые сообщения отбрасываются и
+     * учитываются в get_rx_overflows(). Пока поток работает, read_message()/read_messages()
+     * не вызываются из других потоков. Поток останавливается в stop() порта или при ошибке
+     * дескриптора, которую возвращает get_rx_error().
+     * 
+     * @param capacity Емкость очереди в сообщениях (округляется до степени двойки).
+     * @return true если поток запущен.
+     */
+    bool start_rx_thread(int capacity = 1024);
+
+    /**
+     * @brief Останавливает фоновый поток приема.
+     * 
+     * Сообщения, оставшиеся в очереди, можно забрать pop_messages().
+     */
+    void stop_rx_thread();
+
+    /**
+     * @brief Проверяет, работает ли фоновый поток приема.
+     * 
+     * @return true если поток работает.
+     */
+    bool is_rx_thread_running()
+    {
+        return rx_thread_running;
+    }
+
+    /**
+     * @brief Забирает сообщения, принятые фоновым потоком.
+     * 
+     * Вызывается из одного потока-потребителя.
+     * 
+     * @param messages Массив для сообщений.
+     * @param max_messages Размер массива messages.
+     * @param timeout_ms Время ожидания пустой очереди, мс, -1 - без ограничения, 0 - не ждать.
+     * @return int Количество сообщений, 0 если их нет или поток приема остановлен.
+     */
+    int pop_messages(mavlink_message_t *messages, int max_messages, int timeout_ms = 0);
+
+    /**
+     * @brief Забирает одно сообщение, принятое фоновым потоком.
+     * 
+     * @param message Сообщение.
+     * @param timeout_ms Время ожидания пустой очереди, мс, -1 - без ограничения, 0 - не ждать.
+     * @return true если сообщение получено.
+     */
+    bool pop_message(mavlink_message_t &message, int timeout_ms = 0)
+    {
+        return pop_messages(&message, 1, timeout_ms) > 0;
+    }
+
+    /**
+     * @brief Возвращает количество сообщений, отброшенных из-за переполнения очереди приема.
+     * 
+     * @return unsigned long Количество сообщений.
+     */
+    unsigned long get_rx_overflows()
+    {
+        return rx_overflows.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Возвращает ошибку, остановившую фоновый поток приема.
+     * 
+     * Пустые датаграммы и прерванные сигналом ожидания ошибками не считаются.
+     * 
+     * @return int Значение errno или 0, если поток не останавливался из-за ошибки.
+     */
+    int get_rx_error()
+    {
+        return rx_error.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Подключает кеш, в который порт сохраняет каждое принятое сообщение.
+     * 
+     * Вызывается до запуска порта. Один кеш может обслуживать несколько портов.
+     * 
+     * @param cache Кеш или NULL.
+     */
+    void set_telemetry_cache(Telemetry_Cache *cache)
+    {
+        telemetry = cache;
+    }
+
+    /**
+     * @brief Подключает запись принятых кадров в tlog.
+     * 
+     * Вызывается до запуска порта. Один Tlog_Recorder может записывать несколько портов.
+     * 
+     * @param recorder Запись или NULL.
+     */
+    void set_recorder(Tlog_Recorder *recorder)
+    {
+        this->recorder = recorder;
+    }
+
+    /**
+     * @brief Включает поиск начала кадра при пакетном разборе.
+     * 
+     * Пока разборщик ожидает начало кадра, байты помех пропускаются векторным поиском
+     * MAVLINK_STX/MAVLINK_STX_MAVLINK1, а найденный кандидат проверяется по заголовку до
+     * передачи разборщику. Включен по умолчанию.
+     * 
+     * @param enable true для поиска, false для побайтового разбора.
+     */
+    void set_resync_scan(bool enable)
+    {
+        resync_scan = enable;
+    }
+
     /**
      * @brief Проверяет, запущен ли порт.
      * 
@@ -55,6 +371,219 @@ public:
      * @brief Останавливает порт.
      */
     virtual void stop() = 0;
+
+protected:
+    /**
+     * @brief Читает сообщения вместе с их исходными байтами под блокировкой порта.
+     * 
+     * Реализации порта разбирают данные через _parse_buffer() с тем же массивом frames,
+     * read_messages() без кадров вызывает эту функцию с frames == NULL. Реализация по
+     * умолчанию возвращает все кадры с data == NULL.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массивов.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    virtual int read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+    /**
+     * @brief Кадр, ожидающий сериализации в write_payload().
+     */
+    struct Tx_Frame
+    {
+        uint8_t system_id; ///< Идентификатор системы отправителя.
+        uint8_t component_id; ///< Идентификатор компонента отправителя.
+        uint32_t msgid; ///< Идентификатор сообщения.
+        uint8_t crc_extra; ///< CRC_EXTRA сообщения.
+        const uint8_t *payload; ///< Полезная нагрузка.
+        unsigned payload_len; ///< Длина полезной нагрузки без нулей в конце.
+
+        /**
+         * @brief Возвращает длину кадра на линии.
+         * 
+         * @return unsigned Длина.
+         */
+        unsigned length() const
+        {
+            return MAVLINK_NUM_NON_PAYLOAD_BYTES + payload_len;
+        }
+    };
+
+    bool debug; ///< Флаг для включения режима отладки.
+    mavlink_status_t lastStatus; ///< Статус последнего сообщения Mavlink.
+    mavlink_message_t parse_buffer; ///< Буфер собираемого сообщения порта.
+    mavlink_status_t parse_status; ///< Состояние разбора порта, не связанное с каналами Mavlink.
+    Telemetry_Cache *telemetry; ///< Кеш последних значений сообщений или NULL.
+    Tlog_Recorder *recorder; ///< Запись принятых кадров или NULL.
+    mavlink_message_t *view_messages; ///< Сообщения, разбираемые во время read_views().
+    Raw_Frame *view_frames; ///< Кадры, найденные во время read_views().
+    uint8_t *view_bytes; ///< Кадры read_views(), пришедшие несколькими порциями.
+    int view_capacity; ///< Размер массивов read_views().
+    bool resync_scan; ///< Флаг поиска начала кадра в _parse_buffer().
+    std::atomic<uint8_t> tx_seq; ///< Номер следующего кадра write_payload().
+
+    /**
+     * @brief Сбрасывает состояние разбора порта.
+     */
+    void _reset_parser()
+    {
+        memset(&parse_buffer, 0, sizeof(parse_buffer));
+        memset(&parse_status, 0, sizeof(parse_status));
+    }
+
+    /**
+     * @brief Передает принятое сообщение в кеш телеметрии и запись tlog, если они подключены.
+     * 
+     * @param message Принятое сообщение.
+     * @param frame Байты кадра в буфере приема или NULL, если кадр пришел несколькими порциями.
+     * @param len Длина кадра.
+     */
+    void _publish(const mavlink_message_t &message, const uint8_t *frame = NULL, unsigned len = 0)
+    {
+        if (telemetry)
+        {
+            telemetry->update(message);
+        }
+        if (recorder)
+        {
+            // the wire bytes are recorded as they are, only a split frame is serialized again
+            if (frame)
+            {
+                recorder->record(frame, len);
+            }
+            else
+            {
+                recorder->record(message);
+            }
+        }
+    }
+
+    /**
+     * @brief Записывает кадр write_payload().
+     * 
+     * По умолчанию собирает кадр во временном буфере и передает его write_raw(). Порты с
+     * собственной очередью передачи собирают кадр прямо в ней.
+     * 
+     * @param frame Кадр.
+     * @return int Результат как у write_raw().
+     */
+    virtual int _write_frame(const Tx_Frame &frame);
+
+    /**
+     * @brief Собирает кадр на линии и присваивает ему очередной номер.
+     * 
+     * @param frame Кадр.
+     * @param buf Буфер размером не меньше frame.length().
+     */
+    void _encode_frame(const Tx_Frame &frame, uint8_t *buf);
+
+    /**
+     * @brief Разбирает байты из буфера и извлекает из них сообщения Mavlink.
+     * 
+     * Вызывается реализациями порта под их собственной блокировкой. Если состояние разбора
+     * не передано, используется состояние порта parse_buffer/parse_status. Если передан
+     * массив frames, также отмечает положение каждого кадра в buf.
+     * 
+     * @param buf Буфер с принятыми данными.
+     * @param len Количество байт в буфере.
+     * @param pos Позиция первого неразобранного байта, сдвигается по мере разбора.
+     * @param messages Массив для найденных сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массива messages.
+     * @param rx_buffer Буфер собираемого сообщения отдельного соединения или NULL.
+     * @param rx_status Состояние разбора отдельного соединения или NULL.
+     * @return int Количество найденных сообщений.
+     */
+    int _parse_buffer(const uint8_t *buf, int len, int &pos, mavlink_message_t *messages, Raw_Frame *frames,
+                      int max_messages, mavlink_message_t *rx_buffer = NULL, mavlink_status_t *rx_status = NULL);
+
+    /**
+     * @brief Разбирает один байт с собственным состоянием разбора.
+     * 
+     * Аналог mavlink_parse_char() для состояния, не привязанного к каналу Mavlink, поэтому
+     * количество одновременно разбираемых соединений не ограничено MAVLINK_COMM_NUM_BUFFERS.
+     * 
+     * @param rx_buffer Буфер собираемого сообщения.
+     * @param rx_status Состояние разбора.
+     * @param c Очередной байт.
+     * @param message Сообщение, в которое копируется собранный кадр.
+     * @param status Копия состояния разбора после байта.
+     * @return uint8_t 1 если сообщение собрано и контрольная сумма верна, иначе 0.
+     */
+    static uint8_t _parse_char(mavlink_message_t *rx_buffer, mavlink_status_t *rx_status, uint8_t c,
+                               mavlink_message_t *message, mavlink_status_t *status);
+
+    /**
+     * @brief Возвращает длину кадра сообщения на линии.
+     * 
+     * @param message Разобранное сообщение.
+     * @return unsigned Длина кадра, включая подпись.
+     */
+    static unsigned _frame_length(const mavlink_message_t &message);
+
+    /**
+     * @brief Ищет следующее правдоподобное начало кадра.
+     * 
+     * Кандидаты с неизвестным идентификатором сообщения или неизвестными флагами
+     * несовместимости отбрасываются и учитываются в parse_error. Длина не проверяется:
+     * кадр новой версии диалекта может быть длиннее за счет полей-расширений.
+     * Кандидат, заголовок которого еще не принят целиком, считается правдоподобным.
+     * 
+     * @param buf Буфер с принятыми данными.
+     * @param pos Позиция начала поиска.
+     * @param len Количество байт в буфере.
+     * @param rx_status Состояние разбора, в котором учитываются отброшенные кандидаты.
+     * @return int Позиция кандидата или len, если его нет.
+     */
+    static int _find_frame_start(const uint8_t *buf, int pos, int len, mavlink_status_t *rx_status);
+
+    /**
+     * @brief Разбирает кадр MAVLink 2, целиком находящийся в буфере, за один шаг.
+     * 
+     * Контрольная сумма проверяется Mavlink_Crc, сообщение и состояние разбора заполняются
+     * так же, как при побайтовом разборе. Подписанные кадры, кадры неизвестных сообщений и
+     * кадры с неверной контрольной суммой остаются побайтовому разбору.
+     * 
+     * @param frame Байт начала кадра в буфере.
+     * @param avail Количество байт от frame до конца буфера.
+     * @param message Сообщение, в которое копируется кадр.
+     * @param rx_status Состояние разбора в ожидании начала кадра.
+     * @param status Копия состояния разбора после кадра.
+     * @return int Длина разобранного кадра или 0.
+     */
+    static int _decode_frame(const uint8_t *frame, int avail, mavlink_message_t *message, mavlink_status_t *rx_status,
+                             mavlink_status_t *status);
+
+private:
+    const static int RX_THREAD_BATCH = 64; ///< Максимум сообщений за один вызов read_messages() потока приема.
+
+    mavlink_message_t *rx_queue; ///< Кольцевая очередь принятых сообщений.
+    unsigned rx_queue_mask; ///< Емкость очереди минус один.
+    alignas(64) std::atomic<unsigned> rx_queue_head; ///< Счетчик записанных потоком приема сообщений.
+    alignas(64) std::atomic<unsigned> rx_queue_tail; ///< Счетчик забранных потребителем сообщений.
+    alignas(64) std::atomic<bool> rx_consumer_waiting; ///< Потребитель ждет в pop_messages().
+    std::atomic<unsigned long> rx_overflows; ///< Количество отброшенных сообщений.
+    std::atomic<int> rx_error; ///< errno ошибки, остановившей поток приема, или 0.
+    std::atomic<bool> rx_thread_running; ///< Флаг работы потока приема.
+    bool rx_thread_created; ///< Поток приема создан и еще не присоединен.
+    pthread_t rx_thread; ///< Поток приема.
+    int rx_wake_fd; ///< eventfd для остановки потока приема.
+    int rx_ready_fd; ///< eventfd для пробуждения потребителя.
+    mavlink_message_t rx_overflow_batch[RX_THREAD_BATCH]; ///< Сообщения, читаемые при заполненной очереди.
+
+    /**
+     * @brief Цикл потока приема.
+     */
+    void _rx_loop();
+
+    /**
+     * @brief Точка входа потока приема.
+     * 
+     * @param args Указатель на объект Generic_Port.
+     * @return void* Всегда NULL.
+     */
+    static void *_start_rx_thread(void *args);
 };
 
 #endif // GENERIC_PORT_H_
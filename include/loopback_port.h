@@ -0,0 +1,208 @@
+#ifndef LOOPBACK_PORT_H_
+#define LOOPBACK_PORT_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <atomic>
+
+#include <common/mavlink.h>
+
+#include "generic_port.h"
+
+/**
+ * @brief Порт, соединенный с другим таким же портом внутри процесса.
+ *
+ * Кадры, переданные одним портом пары, появляются в read_message() другого. Каждый порт
+ * принимает в собственное кольцо байт в общей памяти процесса: передающая сторона
+ * собирает кадр прямо в кольце получателя, а получатель разбирает кадры прямо из него.
+ * Данные не проходят через ядро, поэтому пара показывает затраты самой библиотеки на
+ * разбор и обработку без затрат ввода-вывода.
+ *
+ * Передающих потоков может быть несколько, они сериализуются мьютексом кольца
+ * получателя. Получатель читает без блокировок относительно передающих. Если в кольце
+ * нет места, кадр не передается, как при переполнении буфера настоящего канала.
+ *
+ * О новых байтах получатель может узнавать через eventfd, возвращаемый get_fd(), поэтому
+ * порт можно добавить в Port_Reactor, а поток приема ждет данные в poll(). Сигнал
+ * включается первым вызовом get_fd(), до него ни передача, ни прием не обращаются к
+ * системе. Передающая сторона сигнализирует eventfd только один раз до следующего
+ * чтения получателя.
+ */
+class Loopback_Port : public Generic_Port
+{
+
+public:
+    /**
+     * @brief Конструктор.
+     *
+     * @param capacity Емкость кольца приема, байт (округляется до степени двойки).
+     */
+    Loopback_Port(int capacity = 1 << 16);
+
+    /**
+     * @brief Деструктор.
+     */
+    virtual ~Loopback_Port();
+
+    /**
+     * @brief Соединяет порт с другим портом в обоих направлениях.
+     *
+     * Вызывается до запуска портов. Порт, соединенный сам с собой, принимает свои кадры.
+     *
+     * @param peer_ Второй порт пары.
+     */
+    void connect(Loopback_Port *peer_);
+
+    /**
+     * @brief Читает одно сообщение.
+     *
+     * @param message Сообщение.
+     * @return int 1 если сообщение прочитано, 0 если его нет, -1 если порт не запущен.
+     */
+    int read_message(mavlink_message_t &message);
+
+    /**
+     * @brief Читает сообщения, переданные вторым портом пары.
+     *
+     * Байты прочитанных кадров возвращаются передающей стороне при следующем чтении,
+     * поэтому представления read_views() указывают прямо в кольцо.
+     *
+     * @param messages Массив для сообщений.
+     * @param max_messages Размер массива messages.
+     * @return int Количество сообщений или -1, если порт не запущен.
+     */
+    int read_messages(mavlink_message_t *messages, int max_messages);
+
+    /**
+     * @brief Передает сообщение второму порту пары.
+     *
+     * @param message Сообщение.
+     * @return int Длина кадра, 0 если в кольце получателя нет места, -1 если порт не запущен.
+     */
+    int write_message(const mavlink_message_t &message);
+
+    /**
+     * @brief Передает готовые кадры второму порту пары.
+     *
+     * @param buf Байты кадров.
+     * @param len Длина данных.
+     * @return int len, 0 если в кольце получателя нет места, -1 если порт не запущен.
+     */
+    int write_raw(const uint8_t *buf, unsigned len);
+
+    /**
+     * @brief Возвращает количество принятых, но еще не разобранных байт.
+     *
+     * @return int Количество байт.
+     */
+    int rx_pending();
+
+    /**
+     * @brief Возвращает eventfd, сигнализирующий о переданных вторым портом байтах.
+     *
+     * Первый вызов включает сигнал для передающей стороны.
+     *
+     * @return int Дескриптор.
+     */
+    int get_fd();
+
+    /**
+     * @brief Возвращает количество кадров, не переданных из-за отсутствия места.
+     *
+     * @return unsigned long Количество кадров.
+     */
+    unsigned long get_tx_overflows()
+    {
+        return tx_overflows.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Проверяет, запущен ли порт.
+     *
+     * @return true если порт запущен.
+     */
+    bool is_running()
+    {
+        return is_open;
+    }
+
+    /**
+     * @brief Запускает порт. Ранее принятые данные отбрасываются.
+     */
+    void start();
+
+    /**
+     * @brief Останавливает порт.
+     */
+    void stop();
+
+protected:
+    /**
+     * @brief Читает сообщения вместе с их исходными байтами в кольце приема.
+     *
+     * @param messages Массив для сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массивов.
+     * @return int Количество сообщений или -1, если порт не запущен.
+     */
+    int read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+    /**
+     * @brief Собирает кадр write_payload() прямо в кольце получателя.
+     *
+     * @param frame Кадр.
+     * @return int Результат как у write_raw().
+     */
+    int _write_frame(const Tx_Frame &frame);
+
+private:
+    static constexpr int MIN_CAPACITY = 4096; ///< Наименьшая емкость кольца, байт.
+
+    Loopback_Port *peer; ///< Второй порт пары или NULL.
+    bool is_open; ///< Флаг запущенного порта.
+    std::atomic<unsigned long> tx_overflows; ///< Кадры, не переданные из-за отсутствия места.
+
+    uint8_t *rx_ring; ///< Кольцо приема.
+    size_t rx_mask; ///< Емкость кольца минус один.
+    alignas(64) std::atomic<size_t> rx_head; ///< Позиция записи, сдвигается передающей стороной.
+    alignas(64) std::atomic<size_t> rx_tail; ///< Граница байт, возвращенных передающей стороне.
+    size_t rx_read; ///< Позиция разбора, сдвигается получателем.
+    uint8_t rx_scratch[MAVLINK_MAX_PACKET_LEN]; ///< Кадр, не помещающийся в конец кольца.
+    int rx_event_fd; ///< eventfd, сигнализирующий о новых байтах в кольце.
+    std::atomic<bool> rx_waitable; ///< Флаг ожидания rx_event_fd, устанавливается get_fd().
+    std::atomic<bool> rx_signalled; ///< Флаг сигнала rx_event_fd, еще не забранного получателем.
+
+    pthread_mutex_t lock; ///< Мьютекс чтения.
+    pthread_mutex_t rx_write_lock; ///< Мьютекс передающих сторон.
+
+    /**
+     * @brief Выделяет место для кадра в кольце приема. Вызывается под rx_write_lock.
+     *
+     * @param len Длина кадра, не больше MAVLINK_MAX_PACKET_LEN.
+     * @return uint8_t* Место в кольце, rx_scratch, если кадр не помещается в конец
+     * кольца, или NULL, если в кольце нет места.
+     */
+    uint8_t *_reserve(unsigned len);
+
+    /**
+     * @brief Публикует кадр, собранный в месте, выделенном _reserve(). Вызывается под rx_write_lock.
+     *
+     * @param frame Место кадра.
+     * @param len Длина кадра.
+     */
+    void _commit(const uint8_t *frame, unsigned len);
+
+    /**
+     * @brief Сообщает получателю о новых байтах, если его дескриптор ожидается.
+     *
+     * Вызывается под rx_write_lock после сдвига rx_head.
+     */
+    void _signal();
+};
+
+#endif // LOOPBACK_PORT_H_
@@ -0,0 +1,42 @@
+#ifndef MAVLINK_CRC_H_
+#define MAVLINK_CRC_H_
+
+#include <stdint.h>
+
+#include <common/mavlink.h>
+
+/**
+ * @brief Контрольная сумма CRC-16/MCRF4XX (X.25) кадров MAVLink.
+ *
+ * Дает тот же результат, что crc_accumulate() библиотеки MAVLink, но обрабатывает по восемь
+ * байт за шаг по таблицам slice-by-8, построенным во время компиляции.
+ */
+class Mavlink_Crc
+{
+
+public:
+    /**
+     * @brief Добавляет байты к контрольной сумме.
+     *
+     * @param buf Байты.
+     * @param len Количество байт.
+     * @param crc Накопленная контрольная сумма, X25_INIT_CRC для первого вызова.
+     * @return uint16_t Новая контрольная сумма.
+     */
+    static uint16_t accumulate(const uint8_t *buf, unsigned len, uint16_t crc = X25_INIT_CRC);
+
+    /**
+     * @brief Вычисляет контрольную сумму кадра на линии.
+     *
+     * Сумма берется от заголовка без байта начала кадра и полезной нагрузки, затем
+     * добавляется CRC_EXTRA сообщения.
+     *
+     * @param frame Кадр MAVLink 1 или MAVLink 2, начиная с байта начала кадра.
+     * @param payload_len Длина полезной нагрузки.
+     * @param crc_extra CRC_EXTRA сообщения.
+     * @return uint16_t Контрольная сумма.
+     */
+    static uint16_t frame_checksum(const uint8_t *frame, unsigned payload_len, uint8_t crc_extra);
+};
+
+#endif // MAVLINK_CRC_H_
@@ -0,0 +1,193 @@
+#ifndef MESSAGE_ARENA_H_
+#define MESSAGE_ARENA_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include <common/mavlink.h>
+
+#include "frame_view.h"
+
+/**
+ * @brief Кадр MAVLink в блоке Message_Arena.
+ *
+ * Хранит кадр в том виде, в каком он передается по каналу, поэтому занимает столько
+ * памяти, сколько нужно его классу размера, а не полный mavlink_message_t. Байты кадра
+ * располагаются сразу за заголовком блока.
+ */
+struct Pooled_Frame
+{
+    Pooled_Frame *next; ///< Следующий свободный блок класса.
+    std::atomic<int> references; ///< Количество владельцев кадра.
+    uint16_t len; ///< Длина кадра.
+    uint8_t size_class; ///< Класс размера блока.
+
+    /**
+     * @brief Возвращает байты кадра.
+     *
+     * @return uint8_t* Байты кадра.
+     */
+    uint8_t *data()
+    {
+        return (uint8_t *)(this + 1);
+    }
+
+    /**
+     * @brief Возвращает байты кадра.
+     *
+     * @return const uint8_t* Байты кадра.
+     */
+    const uint8_t *data() const
+    {
+        return (const uint8_t *)(this + 1);
+    }
+
+    /**
+     * @brief Возвращает представление кадра для чтения полей.
+     *
+     * @return Frame_View Представление, действительное, пока кадр не освобожден.
+     */
+    Frame_View view() const
+    {
+        Frame_View view;
+        view.data = data();
+        view.len = len;
+        return view;
+    }
+};
+
+/**
+ * @brief Пул кадров MAVLink с классами размеров по длине кадра.
+ *
+ * Блоки каждого класса выделяются пачками по SLAB_FRAMES и после освобождения
+ * возвращаются в список свободных блоков своего класса, поэтому в установившемся режиме
+ * выделение кадра не обращается к malloc. Пул общий для потоков приема, обработчиков и
+ * очередей передачи: каждый список защищен своим мьютексом, а кадр, переданный нескольким
+ * получателям, освобождается последним из них.
+ */
+class Message_Arena
+{
+
+public:
+    const static int SIZE_CLASSES = 4; ///< Количество классов размеров.
+    const static int SLAB_FRAMES = 64; ///< Количество блоков, выделяемых за один раз.
+
+    /**
+     * @brief Статистика пула.
+     */
+    struct Stats
+    {
+        unsigned long frames; ///< Количество выделенных блоков.
+        unsigned long free_frames; ///< Количество свободных блоков.
+        unsigned long bytes; ///< Память всех блоков, байт.
+    };
+
+    /**
+     * @brief Конструктор.
+     */
+    Message_Arena();
+
+    /**
+     * @brief Деструктор. Освобождает всю память, выданные кадры становятся недействительными.
+     */
+    ~Message_Arena();
+
+    /**
+     * @brief Выделяет кадр.
+     *
+     * @param len Длина кадра, не больше MAVLINK_MAX_PACKET_LEN.
+     * @return Pooled_Frame* Кадр с одним владельцем или NULL, если длина слишком велика.
+     */
+    Pooled_Frame *allocate(unsigned len);
+
+    /**
+     * @brief Копирует кадр в пул.
+     *
+     * @param frame Байты кадра.
+     * @param len Длина кадра.
+     * @return Pooled_Frame* Кадр с одним владельцем или NULL.
+     */
+    Pooled_Frame *copy(const uint8_t *frame, unsigned len);
+
+    /**
+     * @brief Копирует кадр, например выданный read_views(), в пул.
+     *
+     * @param view Представление кадра.
+     * @return Pooled_Frame* Кадр с одним владельцем или NULL.
+     */
+    Pooled_Frame *copy(const Frame_View &view)
+    {
+        return copy(view.data, view.len);
+    }
+
+    /**
+     * @brief Сериализует сообщение в кадр пула.
+     *
+     * @param message Сообщение.
+     * @return Pooled_Frame* Кадр с одним владельцем.
+     */
+    Pooled_Frame *encode(const mavlink_message_t &message);
+
+    /**
+     * @brief Добавляет владельца кадра, например перед передачей его нескольким очередям.
+     *
+     * @param frame Кадр.
+     */
+    void retain(Pooled_Frame *frame)
+    {
+        frame->references.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Освобождает кадр. Блок возвращается в пул после освобождения последним владельцем.
+     *
+     * @param frame Кадр или NULL.
+     */
+    void release(Pooled_Frame *frame);
+
+    /**
+     * @brief Возвращает статистику пула.
+     *
+     * @return Stats Статистика.
+     */
+    Stats get_stats();
+
+private:
+    /**
+     * @brief Список свободных блоков одного класса размера.
+     */
+    struct Free_List
+    {
+        pthread_mutex_t lock; ///< Мьютекс списка.
+        Pooled_Frame *head; ///< Первый свободный блок.
+        unsigned long frames; ///< Количество выделенных блоков класса.
+        unsigned long free_frames; ///< Количество свободных блоков класса.
+        std::vector<uint8_t *> slabs; ///< Пачки блоков класса.
+    };
+
+    const static unsigned CAPACITIES[SIZE_CLASSES]; ///< Наибольшая длина кадра каждого класса.
+
+    Free_List lists[SIZE_CLASSES]; ///< Списки свободных блоков по классам.
+
+    /**
+     * @brief Возвращает размер блока класса вместе с заголовком.
+     *
+     * @param size_class Класс размера.
+     * @return unsigned Размер, кратный выравниванию заголовка.
+     */
+    static unsigned _block_size(int size_class);
+
+    /**
+     * @brief Выделяет очередную пачку блоков класса. Вызывается под блокировкой списка.
+     *
+     * @param size_class Класс размера.
+     */
+    void _grow(int size_class);
+};
+
+#endif // MESSAGE_ARENA_H_
@@ -0,0 +1,135 @@
+#ifndef MESSAGE_DISPATCHER_H_
+#define MESSAGE_DISPATCHER_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <functional>
+#include <unordered_map>
+
+#include <common/mavlink.h>
+
+#include "frame_view.h"
+
+/**
+ * @brief Таблица обработчиков сообщений по msgid.
+ *
+ * Обработчики сообщений с msgid меньше COMMON_IDS хранятся в массиве и выбираются одним
+ * индексированным чтением, остальные идентификаторы 24-битного диапазона MAVLink 2 - в
+ * хеш-таблице. Типизированные обработчики получают уже декодированную структуру сообщения.
+ */
+class Message_Dispatcher
+{
+
+public:
+    /**
+     * @brief Обработчик сообщения.
+     */
+    typedef std::function<void(const mavlink_message_t &message)> Handler;
+
+    const static uint32_t COMMON_IDS = 256; ///< Количество msgid, хранящихся в массиве.
+
+    /**
+     * @brief Конструктор.
+     */
+    Message_Dispatcher();
+
+    /**
+     * @brief Устанавливает обработчик сообщений с указанным msgid.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @param handler Обработчик, заменяющий предыдущий, или пустой объект.
+     */
+    void set_handler(uint32_t msgid, Handler handler);
+
+    /**
+     * @brief Устанавливает обработчик, получающий декодированное сообщение.
+     *
+     * Пример: set_handler(MAVLINK_MSG_ID_ATTITUDE, mavlink_msg_attitude_decode,
+     * [](const mavlink_message_t &message, const mavlink_attitude_t &attitude) { ... });
+     *
+     * @param msgid Идентификатор сообщения.
+     * @param decode Функция декодирования сообщения из библиотеки MAVLink.
+     * @param handler Обработчик вида void(const mavlink_message_t &, const T &).
+     */
+    template <typename T, typename F>
+    void set_handler(uint32_t msgid, void (*decode)(const mavlink_message_t *, T *), F handler)
+    {
+        set_handler(msgid, [decode, handler](const mavlink_message_t &message) {
+            T decoded;
+            decode(&message, &decoded);
+            handler(message, decoded);
+        });
+    }
+
+    /**
+     * @brief Удаляет обработчик сообщений с указанным msgid.
+     *
+     * @param msgid Идентификатор сообщения.
+     */
+    void remove_handler(uint32_t msgid);
+
+    /**
+     * @brief Устанавливает обработчик сообщений, для которых нет своего обработчика.
+     *
+     * @param handler Обработчик или пустой объект.
+     */
+    void set_default_handler(Handler handler);
+
+    /**
+     * @brief Передает сообщение его обработчику.
+     *
+     * @param message Сообщение.
+     * @return true если сообщение передано обработчику его msgid.
+     */
+    bool dispatch(const mavlink_message_t &message)
+    {
+        const Handler *handler = message.msgid < COMMON_IDS ? &common[message.msgid] : _find_extended(message.msgid);
+
+        if (handler != NULL && *handler)
+        {
+            (*handler)(message);
+            return true;
+        }
+
+        if (default_handler)
+        {
+            default_handler(message);
+        }
+        return false;
+    }
+
+    /**
+     * @brief Передает обработчику кадр, например из read_views() или Message_Arena.
+     *
+     * Кадр восстанавливается в mavlink_message_t только если для него есть обработчик.
+     *
+     * @param view Представление кадра.
+     * @return true если сообщение передано обработчику его msgid.
+     */
+    bool dispatch(const Frame_View &view);
+
+    /**
+     * @brief Передает обработчикам массив сообщений, например результат read_messages().
+     *
+     * @param messages Сообщения.
+     * @param count Количество сообщений.
+     * @return int Количество сообщений, переданных обработчикам их msgid.
+     */
+    int dispatch(const mavlink_message_t *messages, int count);
+
+private:
+    Handler common[COMMON_IDS]; ///< Обработчики msgid меньше COMMON_IDS.
+    std::unordered_map<uint32_t, Handler> extended; ///< Обработчики остальных msgid.
+    Handler default_handler; ///< Обработчик сообщений без своего обработчика.
+    mavlink_message_t view_message; ///< Сообщение, восстановленное из кадра в dispatch().
+
+    /**
+     * @brief Ищет обработчик msgid, не меньшего COMMON_IDS.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @return const Handler* Обработчик или NULL.
+     */
+    const Handler *_find_extended(uint32_t msgid);
+};
+
+#endif // MESSAGE_DISPATCHER_H_
@@ -0,0 +1,30 @@
+#ifndef MESSAGE_ENTRIES_H_
+#define MESSAGE_ENTRIES_H_
+
+#include <stdint.h>
+
+#include <common/mavlink.h>
+
+/**
+ * @brief Описания сообщений диалекта (CRC_EXTRA, длины, смещения адресатов) по msgid.
+ *
+ * Заменяет двоичный поиск mavlink_get_msg_entry(). Во время компиляции из
+ * MAVLINK_MESSAGE_CRCS строится таблица, индексируемая msgid, поэтому описание находится
+ * одним чтением. Идентификаторы не меньше MAX_DIRECT_IDS ищутся двоичным поиском.
+ */
+class Message_Entries
+{
+
+public:
+    const static uint32_t MAX_DIRECT_IDS = 1 << 14; ///< Наибольший размер индексируемой таблицы.
+
+    /**
+     * @brief Возвращает описание сообщения.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @return const mavlink_msg_entry_t* Описание или NULL, если сообщения нет в диалекте.
+     */
+    static const mavlink_msg_entry_t *find(uint32_t msgid);
+};
+
+#endif // MESSAGE_ENTRIES_H_
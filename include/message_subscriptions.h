@@ -0,0 +1,184 @@
+#ifndef MESSAGE_SUBSCRIPTIONS_H_
+#define MESSAGE_SUBSCRIPTIONS_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "generic_port.h"
+
+/**
+ * @brief Менеджер подписок на потоки сообщений автопилота.
+ *
+ * Для каждого объявленного сообщения отправляет MAV_CMD_SET_MESSAGE_INTERVAL с нужной
+ * частотой и проверяет частоту, с которой сообщение действительно приходит. Если автопилот
+ * отклоняет команду или частота не достигается после нескольких попыток, сообщение
+ * запрашивается командой MAV_CMD_REQUEST_MESSAGE с той же частотой.
+ *
+ * Связь с автопилотом отслеживается по HEARTBEAT: после пропадания и восстановления
+ * сердцебиения все подписки согласуются заново.
+ *
+ * Методы вызываются из одного потока: handle_message() для каждого принятого сообщения и
+ * update() не реже нескольких раз в секунду.
+ */
+class Message_Subscriptions
+{
+
+public:
+    /**
+     * @brief Состояние подписки.
+     */
+    enum State
+    {
+        STATE_PENDING,   ///< Ожидает отправки или подтверждения MAV_CMD_SET_MESSAGE_INTERVAL.
+        STATE_STREAMING, ///< Автопилот передает сообщение с заданным интервалом.
+        STATE_POLLING    ///< Сообщение запрашивается MAV_CMD_REQUEST_MESSAGE.
+    };
+
+    const static int ACK_TIMEOUT_MS = 1000; ///< Время ожидания COMMAND_ACK, мс.
+    const static int MAX_ATTEMPTS = 3; ///< Попыток согласования до перехода к запросам.
+    const static int VERIFY_PERIOD_MS = 3000; ///< Наименьший период измерения частоты, мс.
+    const static int LINK_TIMEOUT_MS = 3000; ///< Время без HEARTBEAT, после которого связь потеряна, мс.
+
+    /**
+     * @brief Конструктор.
+     *
+     * @param port_ Порт, через который идут команды.
+     * @param target_system_ Идентификатор системы автопилота.
+     * @param target_component_ Идентификатор компонента автопилота.
+     * @param system_id_ Идентификатор системы отправителя команд.
+     * @param component_id_ Идентификатор компонента отправителя команд.
+     */
+    Message_Subscriptions(Generic_Port *port_, uint8_t target_system_ = 1, uint8_t target_component_ = 1,
+                          uint8_t system_id_ = 255, uint8_t component_id_ = MAV_COMP_ID_ONBOARD_COMPUTER);
+
+    /**
+     * @brief Объявляет сообщение и частоту, с которой оно нужно.
+     *
+     * Повторный вызов для того же сообщения меняет частоту и согласует ее заново.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @param rate_hz Частота, Гц.
+     * @return true если подписка добавлена.
+     */
+    bool subscribe(uint32_t msgid, float rate_hz);
+
+    /**
+     * @brief Отменяет подписку и возвращает сообщению частоту автопилота по умолчанию.
+     *
+     * @param msgid Идентификатор сообщения.
+     */
+    void unsubscribe(uint32_t msgid);
+
+    /**
+     * @brief Учитывает принятое сообщение.
+     *
+     * @param message Сообщение.
+     */
+    void handle_message(const mavlink_message_t &message);
+
+    /**
+     * @brief Отправляет команды и проверяет частоты согласно прошедшему времени.
+     */
+    void update();
+
+    /**
+     * @brief Возвращает состояние подписки.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @return State Состояние, STATE_PENDING если подписки нет.
+     */
+    State get_state(uint32_t msgid);
+
+    /**
+     * @brief Возвращает частоту сообщения за последний период измерения.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @return float Частота, Гц, 0 если подписки нет или период еще не закончился.
+     */
+    float get_rate(uint32_t msgid);
+
+    /**
+     * @brief Проверяет, есть ли связь с автопилотом.
+     *
+     * @return true если HEARTBEAT автопилота приходил последние LINK_TIMEOUT_MS.
+     */
+    bool is_link_up()
+    {
+        return link_up;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief Подписка на одно сообщение.
+     */
+    struct Subscription
+    {
+        uint32_t msgid; ///< Идентификатор сообщения.
+        float rate_hz; ///< Требуемая частота, Гц.
+        State state; ///< Состояние.
+        int attempts; ///< Неудачные попытки согласования подряд.
+        Clock::time_point window_start; ///< Начало периода измерения частоты.
+        unsigned window_count; ///< Сообщений с начала периода измерения.
+        float measured_rate; ///< Частота за последний период, Гц.
+        Clock::time_point last_request; ///< Время последнего MAV_CMD_REQUEST_MESSAGE.
+    };
+
+    Generic_Port *port; ///< Порт, через который идут команды.
+    uint8_t target_system; ///< Идентификатор системы автопилота.
+    uint8_t target_component; ///< Идентификатор компонента автопилота.
+    uint8_t system_id; ///< Идентификатор системы отправителя.
+    uint8_t component_id; ///< Идентификатор компонента отправителя.
+    std::vector<Subscription> subscriptions; ///< Подписки.
+    int inflight; ///< Индекс подписки, ждущей COMMAND_ACK, или -1.
+    Clock::time_point inflight_sent; ///< Время отправки ожидающей команды.
+    bool link_up; ///< Флаг наличия связи с автопилотом.
+    Clock::time_point last_heartbeat; ///< Время последнего HEARTBEAT автопилота.
+
+    /**
+     * @brief Ищет подписку по идентификатору сообщения.
+     *
+     * @param msgid Идентификатор сообщения.
+     * @return int Индекс подписки или -1.
+     */
+    int _find(uint32_t msgid);
+
+    /**
+     * @brief Отправляет команду автопилоту.
+     *
+     * @param command Команда.
+     * @param param1 Первый параметр.
+     * @param param2 Второй параметр.
+     * @return true если команда передана порту.
+     */
+    bool _send_command(uint16_t command, float param1, float param2);
+
+    /**
+     * @brief Отправляет MAV_CMD_SET_MESSAGE_INTERVAL для подписки и ждет подтверждения.
+     *
+     * @param index Индекс подписки.
+     */
+    void _negotiate(int index);
+
+    /**
+     * @brief Засчитывает неудачную попытку согласования.
+     *
+     * После MAX_ATTEMPTS неудач подписка переходит к запросам MAV_CMD_REQUEST_MESSAGE.
+     *
+     * @param index Индекс подписки.
+     */
+    void _fail(int index);
+
+    /**
+     * @brief Начинает новый период измерения частоты.
+     *
+     * @param subscription Подписка.
+     * @param now Текущее время.
+     */
+    void _restart_window(Subscription &subscription, Clock::time_point now);
+};
+
+#endif // MESSAGE_SUBSCRIPTIONS_H_
@@ -0,0 +1,186 @@
+#ifndef PORT_BRIDGE_H_
+#define PORT_BRIDGE_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "generic_port.h"
+#include "port_reactor.h"
+
+/**
+ * @brief Мост, пересылающий сообщения между портами.
+ *
+ * Каждый кадр, принятый одним из портов, записывается во все остальные порты через
+ * write_raw() прямо из буфера приема, без повторной сериализации. Повторно сериализуются
+ * только кадры, пришедшие несколькими порциями. Работает в потоке, выполняющем run()
+ * или run_once(); таймеры можно добавить через get_reactor().
+ *
+ * Мост запоминает, на каких портах встречались sysid/compid отправителей. Сообщения с
+ * target_system уходят только в порты, где эта система уже была замечена; широковещательные
+ * сообщения и сообщения неизвестным системам отправляются во все порты.
+ */
+class Port_Bridge
+{
+
+public:
+    /**
+     * @brief Конструктор.
+     */
+    Port_Bridge();
+
+    /**
+     * @brief Деструктор.
+     */
+    ~Port_Bridge();
+
+    const static int MAX_PORTS = 64; ///< Наибольшее количество портов моста.
+
+    /**
+     * @brief Добавляет запущенный порт.
+     *
+     * @param port Порт, get_fd() которого должен быть действительным.
+     * @return true если порт добавлен, false если портов уже MAX_PORTS.
+     */
+    bool add_port(Generic_Port *port);
+
+    /**
+     * @brief Удаляет порт. Может вызываться из обработчика сообщений.
+     *
+     * @param port Порт.
+     */
+    void remove_port(Generic_Port *port);
+
+    /**
+     * @brief Устанавливает обработчик, вызываемый для каждого пересланного сообщения.
+     *
+     * @param callback Обработчик или пустой объект.
+     */
+    void set_message_callback(Port_Reactor::Message_Callback callback);
+
+    /**
+     * @brief Возвращает порты, на которых была замечена система.
+     *
+     * @param system_id Идентификатор системы.
+     * @return uint64_t Битовая маска индексов портов в порядке добавления.
+     */
+    uint64_t get_route(uint8_t system_id)
+    {
+        return system_links[system_id];
+    }
+
+    /**
+     * @brief Забывает все выученные маршруты.
+     */
+    void clear_routes();
+
+    /**
+     * @brief Возвращает реактор моста.
+     *
+     * @return Port_Reactor& Реактор.
+     */
+    Port_Reactor &get_reactor()
+    {
+        return reactor;
+    }
+
+    /**
+     * @brief Выполняет одну итерацию пересылки.
+     *
+     * @param timeout_ms Время ожидания событий, мс, -1 - без ограничения.
+     * @return int Количество пересланных сообщений или -1 при ошибке.
+     */
+    int run_once(int timeout_ms)
+    {
+        return reactor.run_once(timeout_ms);
+    }
+
+    /**
+     * @brief Пересылает сообщения до вызова stop().
+     */
+    void run()
+    {
+        reactor.run();
+    }
+
+    /**
+     * @brief Останавливает run(). Может вызываться из любого потока.
+     */
+    void stop()
+    {
+        reactor.stop();
+    }
+
+    /**
+     * @brief Возвращает количество пересланных сообщений.
+     *
+     * @return unsigned long Количество сообщений.
+     */
+    unsigned long get_forwarded()
+    {
+        return forwarded;
+    }
+
+    /**
+     * @brief Возвращает количество сообщений, не отправленных в часть портов благодаря маршрутам.
+     *
+     * @return unsigned long Количество сообщений.
+     */
+    unsigned long get_routed()
+    {
+        return routed;
+    }
+
+    /**
+     * @brief Возвращает количество сообщений, которые пришлось сериализовать повторно.
+     *
+     * @return unsigned long Количество сообщений.
+     */
+    unsigned long get_reencoded()
+    {
+        return reencoded;
+    }
+
+private:
+    Port_Reactor reactor; ///< Реактор, ожидающий данные портов.
+    std::vector<Generic_Port *> ports; ///< Порты моста.
+    std::vector<int *> port_bits; ///< Индексы портов в ports, захваченные их обработчиками реактора.
+    Port_Reactor::Message_Callback on_message; ///< Обработчик пересланных сообщений.
+    unsigned long forwarded; ///< Количество пересланных сообщений.
+    unsigned long reencoded; ///< Количество повторно сериализованных сообщений.
+    unsigned long routed; ///< Количество сообщений, отправленных не во все порты.
+    uint64_t system_links[256]; ///< Порты, на которых замечена система, по sysid.
+    std::vector<uint64_t> component_links; ///< Порты, на которых замечен компонент, по (sysid << 8) | compid.
+
+    /**
+     * @brief Возвращает индекс порта в ports.
+     *
+     * @param port Порт.
+     * @return int Индекс или -1, если порт не добавлен.
+     */
+    int _port_index(Generic_Port *port);
+
+    /**
+     * @brief Выбирает порты, в которые нужно отправить сообщение.
+     *
+     * @param message Сообщение.
+     * @param all Маска всех портов моста.
+     * @return uint64_t Битовая маска индексов портов.
+     */
+    uint64_t _route(const mavlink_message_t &message, uint64_t all);
+
+    /**
+     * @brief Пересылает кадр во все порты, кроме порта-источника.
+     *
+     * @param from_index Индекс порта-источника в ports.
+     * @param from Порт, принявший кадр.
+     * @param message Разобранное сообщение.
+     * @param frame Кадр в буфере приема порта.
+     */
+    void _forward(int from_index, Generic_Port *from, const mavlink_message_t &message,
+                  const Generic_Port::Raw_Frame &frame);
+};
+
+#endif // PORT_BRIDGE_H_
@@ -0,0 +1,194 @@
+#ifndef PORT_REACTOR_H_
+#define PORT_REACTOR_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "generic_port.h"
+
+/**
+ * @brief Однопоточный реактор, обслуживающий несколько портов.
+ *
+ * Регистрирует дескрипторы портов и таймеров в одном epoll, читает готовые порты
+ * через read_messages() и передает разобранные сообщения обработчикам.
+ * Все обработчики вызываются из потока, выполняющего run() или run_once().
+ */
+class Port_Reactor
+{
+
+public:
+    /**
+     * @brief Обработчик принятого сообщения.
+     */
+    typedef std::function<void(Generic_Port *port, const mavlink_message_t &message)> Message_Callback;
+
+    /**
+     * @brief Обработчик принятого сообщения вместе с его исходным кадром.
+     */
+    typedef std::function<void(Generic_Port *port, const mavlink_message_t &message, const Generic_Port::Raw_Frame &frame)> Frame_Callback;
+
+    /**
+     * @brief Обработчик принятого кадра без разобранного сообщения.
+     */
+    typedef std::function<void(Generic_Port *port, const Frame_View &frame)> View_Callback;
+
+    /**
+     * @brief Обработчик срабатывания таймера.
+     */
+    typedef std::function<void()> Timer_Callback;
+
+    /**
+     * @brief Конструктор.
+     */
+    Port_Reactor();
+
+    /**
+     * @brief Деструктор. Закрывает таймеры, порты не останавливает.
+     */
+    ~Port_Reactor();
+
+    /**
+     * @brief Добавляет запущенный порт.
+     *
+     * @param port Порт, get_fd() которого должен быть действительным.
+     * @param callback Обработчик сообщений порта.
+     * @return true если порт добавлен.
+     * @return false если порт не поддерживает ожидание готовности или не запущен.
+     */
+    bool add_port(Generic_Port *port, Message_Callback callback);
+
+    /**
+     * @brief Добавляет запущенный порт, сообщения которого передаются вместе с кадрами.
+     *
+     * Порт читается через read_frames(), кадры действительны только внутри обработчика.
+     *
+     * @param port Порт, get_fd() которого должен быть действительным.
+     * @param callback Обработчик сообщений и кадров порта.
+     * @return true если порт добавлен.
+     */
+    bool add_port_frames(Generic_Port *port, Frame_Callback callback);
+
+    /**
+     * @brief Добавляет запущенный порт, кадры которого передаются в виде представлений.
+     *
+     * Порт читается через read_views(), представления действительны только внутри обработчика.
+     *
+     * @param port Порт, get_fd() которого должен быть действительным.
+     * @param callback Обработчик кадров порта.
+     * @return true если порт добавлен.
+     */
+    bool add_port_views(Generic_Port *port, View_Callback callback);
+
+    /**
+     * @brief Удаляет порт. Может вызываться из обработчиков.
+     *
+     * @param port Порт.
+     */
+    void remove_port(Generic_Port *port);
+
+    /**
+     * @brief Добавляет периодический таймер.
+     *
+     * @param interval_ms Период, мс (больше нуля).
+     * @param callback Обработчик таймера.
+     * @return int Идентификатор таймера или -1 при ошибке.
+     */
+    int add_timer(int interval_ms, Timer_Callback callback);
+
+    /**
+     * @brief Удаляет таймер. Может вызываться из обработчиков.
+     *
+     * @param timer_id Идентификатор таймера.
+     */
+    void remove_timer(int timer_id);
+
+    /**
+     * @brief Выполняет одну итерацию: ожидание событий и их обработку.
+     *
+     * @param timeout_ms Время ожидания событий, мс, -1 - без ограничения.
+     * @return int Количество переданных обработчикам сообщений или -1 при ошибке.
+     */
+    int run_once(int timeout_ms);
+
+    /**
+     * @brief Обрабатывает события до вызова stop().
+     */
+    void run();
+
+    /**
+     * @brief Останавливает run(). Может вызываться из любого потока.
+     */
+    void stop();
+
+private:
+    const static int MAX_EVENTS = 32; ///< Количество событий за один вызов epoll_wait.
+    const static int BATCH_MESSAGES = 64; ///< Размер массива для read_messages().
+
+    /**
+     * @brief Зарегистрированный источник событий: порт или таймер.
+     */
+    struct Source
+    {
+        int fd; ///< Дескриптор в epoll.
+        Generic_Port *port; ///< Порт или NULL для таймера.
+        Message_Callback on_message; ///< Обработчик сообщений порта.
+        Frame_Callback on_frame; ///< Обработчик сообщений с кадрами или пустой.
+        View_Callback on_view; ///< Обработчик представлений кадров или пустой.
+        Timer_Callback on_timer; ///< Обработчик таймера.
+        bool removed; ///< Источник удален и будет освобожден после текущей итерации.
+    };
+
+    int epfd; ///< Дескриптор epoll.
+    int wakefd; ///< eventfd для пробуждения из stop().
+    std::atomic<bool> running; ///< Флаг работы run().
+    std::vector<Source *> sources; ///< Зарегистрированные источники.
+    mavlink_message_t messages[BATCH_MESSAGES]; ///< Сообщения, принятые за один вызов read_messages().
+    Generic_Port::Raw_Frame frames[BATCH_MESSAGES]; ///< Кадры сообщений для портов с Frame_Callback.
+    Frame_View views[BATCH_MESSAGES]; ///< Представления кадров для портов с View_Callback.
+
+    /**
+     * @brief Регистрирует источник в epoll.
+     *
+     * @param source Источник.
+     * @return true если источник зарегистрирован.
+     */
+    bool _add_source(Source *source);
+
+    /**
+     * @brief Помечает источник удаленным и снимает его с epoll.
+     *
+     * @param source Источник.
+     */
+    void _remove_source(Source *source);
+
+    /**
+     * @brief Освобождает удаленные источники.
+     */
+    void _release_removed();
+
+    /**
+     * @brief Читает сообщения готового порта и передает их обработчику.
+     *
+     * @param source Источник порта.
+     * @return int Количество переданных сообщений.
+     */
+    int _service_port(Source *source);
+
+    /**
+     * @brief Обрабатывает срабатывание таймера.
+     *
+     * @param source Источник таймера.
+     */
+    void _service_timer(Source *source);
+};
+
+#endif // PORT_REACTOR_H_
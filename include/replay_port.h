@@ -0,0 +1,289 @@
+#ifndef REPLAY_PORT_H_
+#define REPLAY_PORT_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <common/mavlink.h>
+
+#include "generic_port.h"
+
+/**
+ * @brief Порт, воспроизводящий записанный трафик.
+ *
+ * Отображает в память файл tlog (например, записанный Tlog_Recorder) или сырую запись
+ * потока байт канала и выдает его кадры через тот же интерфейс Generic_Port, что и
+ * настоящие порты. Кадры разбираются прямо из отображения, read_views() не копирует их.
+ *
+ * Кадры выдаются либо без пауз, либо в темпе времени записи tlog, ускоренном в заданное
+ * количество раз. Сообщения, переданные порту, не уходят в канал, а сохраняются в виде
+ * записей tlog для последующего сравнения с эталоном.
+ */
+class Replay_Port : public Generic_Port
+{
+
+public:
+    /**
+     * @brief Формат файла записи.
+     */
+    enum Format
+    {
+        FORMAT_AUTO, ///< Определить по содержимому файла.
+        FORMAT_TLOG, ///< Записи tlog: время в мкс (8 байт, big-endian) и кадр.
+        FORMAT_RAW   ///< Сырой поток байт канала без меток времени.
+    };
+
+    /**
+     * @brief Конструктор.
+     *
+     * @param path_ Путь к файлу записи.
+     * @param format_ Формат файла.
+     */
+    Replay_Port(const char *path_, Format format_ = FORMAT_AUTO);
+
+    /**
+     * @brief Деструктор.
+     */
+    virtual ~Replay_Port();
+
+    /**
+     * @brief Читает одно сообщение записи.
+     *
+     * @param message Сообщение.
+     * @return int 1 если сообщение прочитано, 0 если его еще нет, -1 если порт не запущен.
+     */
+    int read_message(mavlink_message_t &message);
+
+    /**
+     * @brief Читает сообщения записи, время которых наступило.
+     *
+     * Если ни одно сообщение еще не пора выдавать, ждет до ближайшего, но не дольше
+     * MAX_WAIT_US, и возвращает 0. В конце записи без повторения также ждет MAX_WAIT_US.
+     *
+     * @param messages Массив для сообщений.
+     * @param max_messages Размер массива messages.
+     * @return int Количество сообщений или -1, если порт не запущен.
+     */
+    int read_messages(mavlink_message_t *messages, int max_messages);
+
+    /**
+     * @brief Сохраняет переданное сообщение.
+     *
+     * @param message Сообщение.
+     * @return int Длина кадра или -1, если порт не запущен.
+     */
+    int write_message(const mavlink_message_t &message);
+
+    /**
+     * @brief Сохраняет переданные кадры.
+     *
+     * @param buf Байты кадров.
+     * @param len Длина данных.
+     * @return int len или -1, если порт не запущен.
+     */
+    int write_raw(const uint8_t *buf, unsigned len);
+
+    /**
+     * @brief Задает темп воспроизведения. Вызывается до start().
+     *
+     * Темп применяется только к файлам tlog, сырая запись всегда выдается без пауз.
+     *
+     * @param factor Ускорение относительно времени записи (1, 10, 100...), 0 - без пауз.
+     */
+    void set_speed(double factor);
+
+    /**
+     * @brief Включает повторение записи с начала после ее окончания.
+     *
+     * @param enable true для повторения.
+     */
+    void set_loop(bool enable);
+
+    /**
+     * @brief Проверяет, выданы ли все кадры записи.
+     *
+     * @return true если запись закончилась и повторение выключено.
+     */
+    bool is_finished();
+
+    /**
+     * @brief Возвращает формат открытого файла.
+     *
+     * @return Format FORMAT_TLOG или FORMAT_RAW после start(), до него - заданный в конструкторе.
+     */
+    Format get_format()
+    {
+        return format;
+    }
+
+    /**
+     * @brief Возвращает количество прочитанных байт записи с момента запуска.
+     *
+     * @return unsigned long Количество байт, включая повторения.
+     */
+    unsigned long get_bytes_replayed()
+    {
+        return bytes_replayed;
+    }
+
+    /**
+     * @brief Копирует переданные порту кадры.
+     *
+     * Каждый кадр предваряется меткой времени записи, на которой он был передан, в
+     * формате tlog, поэтому при воспроизведении без пауз результат не зависит от скорости
+     * машины. Сырая запись не содержит времени, для нее метка - текущее время.
+     *
+     * @param records Записи tlog.
+     * @return unsigned long Количество переданных кадров.
+     */
+    unsigned long get_written(std::vector<uint8_t> &records);
+
+    /**
+     * @brief Сохраняет переданные порту кадры в файл tlog.
+     *
+     * Файл можно воспроизвести другим Replay_Port и сравнить сообщения с эталоном.
+     *
+     * @param path_ Путь к файлу.
+     * @return true если файл записан.
+     */
+    bool save_written(const char *path_);
+
+    /**
+     * @brief Удаляет сохраненные переданные кадры.
+     */
+    void clear_written();
+
+    /**
+     * @brief Проверяет, запущен ли порт.
+     *
+     * @return true если файл записи открыт.
+     */
+    bool is_running()
+    {
+        return is_open;
+    }
+
+    /**
+     * @brief Открывает и отображает в память файл записи.
+     */
+    void start();
+
+    /**
+     * @brief Закрывает файл записи. Сохраненные переданные кадры остаются доступны.
+     */
+    void stop();
+
+protected:
+    /**
+     * @brief Читает сообщения записи вместе с их байтами в отображении файла.
+     *
+     * @param messages Массив для сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массивов.
+     * @return int Количество сообщений или -1, если порт не запущен.
+     */
+    int read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+private:
+    static constexpr size_t RAW_MAX_PARSE = 1 << 30; ///< Наибольшая порция сырой записи на один разбор, байт.
+    static constexpr uint64_t MAX_WAIT_US = 100000; ///< Наибольшее ожидание в read_messages(), мкс.
+    static constexpr unsigned TLOG_TIMESTAMP_LEN = 8; ///< Длина метки времени записи tlog.
+
+    std::string path; ///< Путь к файлу записи.
+    Format format; ///< Формат файла записи.
+    double speed; ///< Ускорение воспроизведения, 0 - без пауз.
+    bool loop; ///< Флаг повторения записи.
+    bool is_open; ///< Флаг отображенного файла.
+    bool finished; ///< Флаг окончания записи.
+
+    const uint8_t *data; ///< Отображение файла записи.
+    size_t size; ///< Размер файла записи.
+    size_t offset; ///< Позиция следующей записи.
+    unsigned long bytes_replayed; ///< Количество прочитанных байт записи.
+
+    bool paced_started; ///< Флаг выданной первой записи текущего прохода.
+    uint64_t first_timestamp_us; ///< Метка времени первой записи прохода.
+    uint64_t start_us; ///< Время выдачи первой записи прохода по steady_clock, мкс.
+    std::atomic<uint64_t> log_time_us; ///< Метка времени последней выданной записи.
+
+    std::vector<uint8_t> written; ///< Переданные кадры в формате tlog.
+    unsigned long written_frames; ///< Количество переданных кадров.
+
+    pthread_mutex_t lock; ///< Мьютекс чтения записи.
+    pthread_mutex_t write_lock; ///< Мьютекс переданных кадров.
+
+    /**
+     * @brief Определяет формат отображенного файла.
+     *
+     * @return Format FORMAT_TLOG или FORMAT_RAW.
+     */
+    Format _detect_format();
+
+    /**
+     * @brief Читает метку времени записи tlog.
+     *
+     * @param record Начало записи.
+     * @return uint64_t Время, мкс.
+     */
+    static uint64_t _read_timestamp(const uint8_t *record);
+
+    /**
+     * @brief Вычисляет длину кадра по его заголовку.
+     *
+     * @param frame Начало кадра.
+     * @param avail Количество доступных байт.
+     * @return unsigned Длина кадра или 0, если frame не начинается с целого кадра.
+     */
+    static unsigned _record_frame_length(const uint8_t *frame, size_t avail);
+
+    /**
+     * @brief Читает кадры сырой записи.
+     *
+     * @param messages Массив для сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массива messages.
+     * @return int Количество сообщений.
+     */
+    int _read_raw(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+    /**
+     * @brief Читает кадры записи tlog, время которых наступило.
+     *
+     * @param messages Массив для сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массива messages.
+     * @param wait_us Время до следующей записи, мкс, если ее еще рано выдавать.
+     * @return int Количество сообщений.
+     */
+    int _read_tlog(mavlink_message_t *messages, Raw_Frame *frames, int max_messages, uint64_t &wait_us);
+
+    /**
+     * @brief Начинает запись с начала или отмечает ее окончание.
+     *
+     * @return true если запись начата заново.
+     */
+    bool _rewind();
+
+    /**
+     * @brief Возвращает текущее время по steady_clock.
+     *
+     * @return uint64_t Время, мкс.
+     */
+    static uint64_t _now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+#endif // REPLAY_PORT_H_
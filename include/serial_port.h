@@ -3,13 +3,21 @@
 
 #include <cstdlib>
 #include <stdio.h>   // Standard input/output definitions
+#include <string.h>
 #include <unistd.h>  // UNIX standard function definitions
 #include <fcntl.h>   // File control definitions
 #include <termios.h> // POSIX terminal control definitions
 #include <pthread.h> // This uses POSIX Threads
 #include <signal.h>
+#include <sys/ioctl.h>
+#include <functional>
+
+#ifdef __linux__
+#include <linux/serial.h>
+#endif
 
 #include "generic_port.h"
+#include "uring_engine.h"
 
 #ifndef B460800
 #define B460800 460800
@@ -29,6 +37,24 @@ class Serial_Port : public Generic_Port
 {
 
 public:
+    /**
+     * @brief Режим настройки приема данных.
+     */
+    enum Rx_Mode
+    {
+        RX_MODE_LATENCY,   ///< read() возвращается с первым же принятым байтом.
+        RX_MODE_THROUGHPUT ///< read() ждет накопления порции байт, реже будит поток.
+    };
+
+    /**
+     * @brief Обработчик завершения записи.
+     * 
+     * Вызывается из потока передачи после каждого вызова write() с количеством
+     * переданных драйверу байт (или -1 при ошибке). С io_uring вызывается из потока
+     * чтения по завершении каждой записи.
+     */
+    typedef std::function<void(int bytes_written)> Write_Callback;
+
     /**
      * @brief Конструктор по умолчанию.
      */
@@ -56,13 +82,90 @@ public:
     int read_message(mavlink_message_t &message);
 
     /**
-     * @brief Записывает сообщение в последовательный порт.
+     * @brief Читает все сообщения из очередной порции данных последовательного порта.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param max_messages Размер массива messages.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    int read_messages(mavlink_message_t *messages, int max_messages);
+
+    /**
+     * @brief Ставит сообщение в очередь передачи последовательного порта.
+     * 
+     * Сообщение передается драйверу потоком передачи, вызов не ждет физической отправки.
      * 
      * @param message Константная ссылка на объект сообщения Mavlink, которое будет отправлено.
-     * @return int Количество байт, записанных в порт.
+     * @return int Количество байт, поставленных в очередь, или -1 если порт не запущен.
      */
     int write_message(const mavlink_message_t &message);
 
+    /**
+     * @brief Ставит готовые кадры в очередь передачи последовательного порта.
+     * 
+     * @param buf Байты кадров.
+     * @param len Длина данных.
+     * @return int Количество байт, поставленных в очередь, или -1 если порт не запущен.
+     */
+    int write_raw(const uint8_t *buf, unsigned len);
+
+    /**
+     * @brief Дожидается передачи очереди драйверу и выполняет tcdrain().
+     * 
+     * Блокирует только вызывающий поток, чтение порта при этом продолжается.
+     * 
+     * @return int 0 при успехе, -1 при ошибке.
+     */
+    int flush();
+
+    /**
+     * @brief Устанавливает обработчик завершения записи.
+     * 
+     * @param callback Обработчик, вызываемый из потока передачи.
+     */
+    void set_write_callback(Write_Callback callback);
+
+    /**
+     * @brief Выбирает механизм ввода-вывода. Вызывается до запуска порта.
+     * 
+     * С io_uring чтение идет повторяемым запросом read() в кольцо буферов ядра, а
+     * запись - запросами write() из зарегистрированных буферов без потока передачи.
+     * 
+     * @param engine Механизм ввода-вывода.
+     * @return true если механизм выбран.
+     */
+    bool set_io_engine(Io_Engine engine);
+
+    /**
+     * @brief Возвращает дескриптор последовательного порта или очереди io_uring.
+     * 
+     * @return int Дескриптор.
+     */
+    int get_fd()
+    {
+        return uring.is_ready() ? uring.get_fd() : fd;
+    }
+
+    /**
+     * @brief Возвращает ошибку записи, остановившую поток передачи.
+     * 
+     * Прерванные сигналом и временно невозможные записи повторяются и ошибками не считаются.
+     * После ошибки очередь передачи сбрасывается, а запись и flush() возвращают -1 до stop().
+     * 
+     * @return int Значение errno или 0, если поток не останавливался из-за ошибки.
+     */
+    int get_tx_error()
+    {
+        return tx_error.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Возвращает количество байт кольцевого буфера, ожидающих разбора.
+     * 
+     * @return int Количество байт.
+     */
+    int rx_pending();
+
     /**
      * @brief Проверяет, запущен ли порт.
      * 
@@ -74,6 +177,26 @@ public:
         return is_open;
     }
 
+    /**
+     * @brief Устанавливает режим приема данных.
+     * 
+     * Режим задает VMIN/VTIME порта и размер запросов read(). Может быть изменен
+     * как до запуска порта, так и во время работы.
+     * 
+     * @param mode Режим приема.
+     */
+    void set_rx_mode(Rx_Mode mode);
+
+    /**
+     * @brief Возвращает текущий режим приема данных.
+     * 
+     * @return Rx_Mode Режим приема.
+     */
+    Rx_Mode get_rx_mode()
+    {
+        return rx_mode;
+    }
+
     /**
      * @brief Открывает последовательный порт и настраивает его.
      */
@@ -83,9 +206,20 @@ public:
      * @brief Закрывает последовательный порт.
      */
     void stop();
+
+protected:
+    /**
+     * @brief Читает сообщения вместе с их исходными байтами в кольцевом буфере приема.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массивов.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    int read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
 private:
     int fd; ///< Дескриптор файла порта.
-    mavlink_status_t lastStatus; ///< Статус последнего сообщения Mavlink.
     pthread_mutex_t lock; ///< Мьютекс для синхронизации доступа к порту.
 
     /**
@@ -93,7 +227,25 @@ private:
      */
     void initialize_defaults();
 
-    bool debug; ///< Флаг для включения режима отладки.
+    const static unsigned RX_RING_LEN = 4096; ///< Длина кольцевого буфера приема (степень двойки).
+    uint8_t rx_ring[RX_RING_LEN]; ///< Кольцевой буфер приема.
+    unsigned rx_head; ///< Счетчик записанных в кольцо байт.
+    unsigned rx_tail; ///< Счетчик разобранных байт кольца.
+    Rx_Mode rx_mode; ///< Режим приема данных.
+
+    const static unsigned TX_RING_LEN = 8192; ///< Длина кольцевой очереди передачи (степень двойки).
+    uint8_t tx_ring[TX_RING_LEN]; ///< Кольцевая очередь передачи.
+    unsigned tx_head; ///< Счетчик поставленных в очередь байт.
+    unsigned tx_tail; ///< Счетчик переданных драйверу байт.
+    bool tx_running; ///< Флаг работы потока передачи.
+    std::atomic<int> tx_error; ///< Ошибка записи, остановившая поток передачи.
+    pthread_t tx_thread; ///< Поток передачи.
+    pthread_mutex_t tx_lock; ///< Мьютекс очереди передачи, не пересекается с lock.
+    pthread_cond_t tx_cond; ///< Условие изменения очереди передачи.
+    Write_Callback write_callback; ///< Обработчик завершения записи.
+    const static int URING_RX_BATCH = 4; ///< Количество результатов io_uring за одно ожидание.
+    Io_Engine io_engine; ///< Выбранный механизм ввода-вывода.
+    Uring_Engine uring; ///< Очередь io_uring, если она используется.
     const char *uart_name; ///< Имя UART устройства.
     int baudrate; ///< Скорость передачи данных (бод).
     bool is_open; ///< Флаг, указывающий, открыт ли порт.
@@ -128,13 +280,87 @@ private:
     int _read_port(uint8_t &cp);
 
     /**
-     * @brief Записывает данные в последовательный порт.
+     * @brief Дочитывает данные из последовательного порта в кольцевой буфер.
+     * 
+     * Вызывается под блокировкой порта. Запрашивает все непрерывное свободное место
+     * кольца, read() возвращает столько байт, сколько накопил драйвер.
+     * 
+     * @return int Количество прочитанных байт или результат операции чтения при ошибке.
+     */
+    int _fill_ring();
+
+    /**
+     * @brief Переносит в пустой кольцевой буфер данные, прочитанные через io_uring.
+     * 
+     * Вызывается из _fill_ring() под блокировкой порта. Завершения записи передаются
+     * обработчику write_callback.
+     * 
+     * @return int Количество перенесенных байт, 0 если завершились только записи, или результат
+     * операции чтения при ошибке.
+     */
+    int _fill_uring();
+
+    /**
+     * @brief Разбирает накопленные в кольцевом буфере байты.
+     * 
+     * @param messages Массив для найденных сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массива messages.
+     * @return int Количество найденных сообщений.
+     */
+    int _parse_ring(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+    /**
+     * @brief Заполняет VMIN/VTIME конфигурации порта согласно режиму приема.
+     * 
+     * @param config Конфигурация порта.
+     */
+    void _set_rx_timing(struct termios &config);
+
+    /**
+     * @brief Включает или выключает флаг низкой задержки драйвера UART.
+     * 
+     * @param enable Требуемое состояние флага.
+     */
+    void _set_low_latency(bool enable);
+
+    /**
+     * @brief Ставит данные в очередь передачи.
      * 
      * @param buf Буфер с данными для записи.
      * @param len Длина данных для записи.
-     * @return int Количество записанных байт.
+     * @return int Количество поставленных в очередь байт или -1 если поток передачи не запущен.
      */
     int _write_port(char *buf, unsigned len);
+
+    /**
+     * @brief Собирает кадр write_payload() прямо в очереди передачи.
+     * 
+     * @param frame Кадр.
+     * @return int Количество поставленных в очередь байт или -1 если поток передачи не запущен.
+     */
+    int _write_frame(const Tx_Frame &frame);
+
+    /**
+     * @brief Дожидается места в очереди передачи. Вызывается под блокировкой tx_lock.
+     * 
+     * @param len Требуемое количество байт.
+     * @return true если место есть, false если поток передачи остановлен.
+     */
+    bool _wait_tx_room(unsigned len);
+
+    /**
+     * @brief Цикл потока передачи: переносит данные из очереди в драйвер.
+     */
+    void _tx_loop();
+
+    /**
+     * @brief Точка входа потока передачи.
+     * 
+     * @param args Указатель на объект Serial_Port.
+     * @return void* Всегда NULL.
+     */
+    static void *_start_tx_thread(void *args);
 };
 
 #endif // SERIAL_PORT_H_
@@ -8,6 +8,7 @@
 #include <pthread.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -17,21 +18,37 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <stdbool.h>
+#include <vector>
+#include <deque>
 
 #include <common/mavlink.h>
 
 #include "generic_port.h"
+#include "uring_engine.h"
 
 /**
  * @brief Класс для работы с TCP сервером.
  * 
- * Этот класс предоставляет методы для чтения и записи сообщений через TCP соединение,
- * а также для управления состоянием сервера.
+ * Этот класс предоставляет методы для чтения и записи сообщений через TCP соединения
+ * с любым количеством клиентов, а также для управления состоянием сервера.
+ * Сокеты неблокирующие и обслуживаются через epoll: новые клиенты принимаются и данные
+ * читаются в read_message()/read_messages(), записываемые сообщения рассылаются всем клиентам.
+ * С io_uring подключения и данные приходят многократными запросами accept/recv, а рассылка
+ * ставит записи в очередь без копирования в буферы клиентов.
  */
 class TCP_Server : public Generic_Port
 {
 
 public:
+    /**
+     * @brief Поведение сервера при переполнении буфера передачи клиента.
+     */
+    enum Slow_Client_Policy
+    {
+        SLOW_CLIENT_DISCONNECT, ///< Отключить клиента, не успевающего принимать данные.
+        SLOW_CLIENT_DROP        ///< Пропускать сообщения клиента, пока буфер не освободится.
+    };
+
     /**
      * @brief Конструктор по умолчанию.
      */
@@ -50,7 +67,7 @@ public:
     virtual ~TCP_Server();
 
     /**
-     * @brief Читает сообщение из TCP соединения.
+     * @brief Читает сообщение от любого из клиентов.
      * 
      * @param message Ссылка на объект сообщения Mavlink, в который будет записано прочитанное сообщение.
      * @return int Возвращает true, если сообщение было успешно прочитано.
@@ -58,13 +75,86 @@ public:
     int read_message(mavlink_message_t &message);
 
     /**
-     * @brief Записывает сообщение в TCP соединение.
+     * @brief Читает все сообщения из данных, готовых на соединениях клиентов.
+     * 
+     * Ожидает события epoll, принимает новых клиентов и разбирает принятые данные.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param max_messages Размер массива messages.
+     * @return int Количество прочитанных сообщений или -1 при ошибке ожидания.
+     */
+    int read_messages(mavlink_message_t *messages, int max_messages);
+
+    /**
+     * @brief Рассылает сообщение всем подключенным клиентам.
      * 
      * @param message Константная ссылка на объект сообщения Mavlink, которое будет отправлено.
-     * @return int Количество байт, записанных в соединение.
+     * @return int Длина сообщения, если оно передано или поставлено в очередь хотя бы одному клиенту,
+     *             0 если клиентов нет, -1 если ни один клиент его не принял.
      */
     int write_message(const mavlink_message_t &message);
 
+    /**
+     * @brief Рассылает готовые кадры всем подключенным клиентам.
+     * 
+     * @param buf Байты кадров.
+     * @param len Длина данных.
+     * @return int len, 0 если клиентов нет, -1 если ни один клиент данные не принял.
+     */
+    int write_raw(const uint8_t *buf, unsigned len);
+
+    /**
+     * @brief Устанавливает поведение при переполнении буфера передачи клиента.
+     * 
+     * Данные, часть которых уже отправлена клиенту, ставятся в очередь целиком, даже если
+     * предел при этом превышается, иначе поток клиента оборвался бы посреди кадра.
+     * 
+     * @param policy Отключать медленного клиента или пропускать его сообщения.
+     * @param max_buffered_bytes Максимальный объем неотправленных данных одного клиента.
+     */
+    void set_slow_client_policy(Slow_Client_Policy policy, int max_buffered_bytes);
+
+    /**
+     * @brief Включает пересылку сообщений, принятых от клиента, остальным клиентам.
+     * 
+     * @param relay true - пересылать.
+     */
+    void set_client_relay(bool relay);
+
+    /**
+     * @brief Возвращает количество подключенных клиентов.
+     * 
+     * @return int Количество клиентов.
+     */
+    int get_client_count();
+
+    /**
+     * @brief Выбирает механизм ввода-вывода. Вызывается до запуска сервера.
+     * 
+     * @param engine Механизм ввода-вывода.
+     * @return true если механизм выбран.
+     */
+    bool set_io_engine(Io_Engine engine);
+
+    /**
+     * @brief Возвращает дескриптор epoll сервера или очереди io_uring.
+     * 
+     * Дескриптор готов к чтению при новых подключениях и данных любого из клиентов.
+     * 
+     * @return int Дескриптор.
+     */
+    int get_fd()
+    {
+        return uring.is_ready() ? uring.get_fd() : epfd;
+    }
+
+    /**
+     * @brief Возвращает количество принятых байт всех клиентов, ожидающих разбора.
+     * 
+     * @return int Количество байт.
+     */
+    int rx_pending();
+
     /**
      * @brief Проверяет, запущен ли сервер.
      * 
@@ -77,48 +167,193 @@ public:
     }
 
     /**
-     * @brief Запускает TCP сервер и ожидает подключения клиента.
+     * @brief Запускает TCP сервер, не дожидаясь подключения клиентов.
      */
     void start();
 
     /**
-     * @brief Останавливает TCP сервер и закрывает соединение.
+     * @brief Останавливает TCP сервер и закрывает все соединения.
      */
     void stop();
+
+protected:
+    /**
+     * @brief Читает сообщения вместе с их исходными байтами в буферах клиентов.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массивов.
+     * @return int Количество прочитанных сообщений или -1 при ошибке ожидания.
+     */
+    int read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
 private:
-    mavlink_status_t lastStatus; ///< Статус последнего сообщения Mavlink.
-    pthread_mutex_t lock; ///< Мьютекс для синхронизации доступа к соединению.
+    const static int BUFF_LEN = 2041; ///< Длина буфера для чтения данных.
+    const static int MAX_EVENTS = 32; ///< Количество событий за один вызов epoll_wait.
+
+    /**
+     * @brief Состояние подключенного клиента.
+     */
+    struct Client
+    {
+        int fd; ///< Дескриптор сокета клиента.
+        uint64_t id; ///< Метка запросов io_uring клиента.
+        char name[INET_ADDRSTRLEN + 8]; ///< Адрес клиента для сообщений.
+        uint8_t rx_buff[BUFF_LEN]; ///< Буфер для чтения данных.
+        int rx_ptr; ///< Указатель на текущую позицию в буфере.
+        int rx_len; ///< Длина данных в буфере.
+        const uint8_t *rx_data; ///< Разбираемые данные: rx_buff или буфер io_uring.
+        int rx_buffer; ///< Буфер io_uring под rx_data или -1.
+        std::deque<Uring_Engine::Completion> rx_chunks; ///< Принятые через io_uring данные, ждущие разбора.
+        mavlink_message_t rx_msg; ///< Собираемое сообщение клиента.
+        mavlink_status_t rx_status; ///< Состояние разбора клиента.
+        std::vector<uint8_t> tx_buff; ///< Данные, не принятые сокетом клиента.
+        bool want_write; ///< Подписан ли сокет на EPOLLOUT.
+        bool closing; ///< Клиент должен быть отключен.
+        unsigned long dropped; ///< Количество пропущенных сообщений.
+    };
+
+    pthread_mutex_t lock; ///< Мьютекс чтения: ожидание событий и буферы приема.
+    pthread_mutex_t tx_lock; ///< Мьютекс списка клиентов и буферов передачи.
 
     /**
      * @brief Инициализирует значения по умолчанию для атрибутов.
      */
     void initialize_defaults();
 
-    const static int BUFF_LEN = 2041; ///< Длина буфера для чтения данных.
-    char buff[BUFF_LEN]; ///< Буфер для чтения данных.
-    int buff_ptr; ///< Указатель на текущую позицию в буфере.
-    int buff_len; ///< Длина данных в буфере.
-    bool debug; ///< Флаг для включения режима отладки.
     int port; ///< Порт TCP для сервера.
-    int sockfd, connfd; ///< Дескрипторы сокетов для сервера и соединения.
+    int sockfd; ///< Дескриптор слушающего сокета.
+    int epfd; ///< Дескриптор epoll.
     bool is_open; ///< Флаг, указывающий, открыт ли сервер.
+    std::vector<Client *> clients; ///< Подключенные клиенты.
+    int next_client; ///< Клиент, с которого начинается следующий разбор.
+    Slow_Client_Policy slow_client_policy; ///< Поведение при переполнении буфера клиента.
+    int max_buffered_bytes; ///< Максимальный объем неотправленных данных клиента.
+    bool client_relay; ///< Пересылать ли сообщения клиента остальным клиентам.
+    Io_Engine io_engine; ///< Выбранный механизм ввода-вывода.
+    Uring_Engine uring; ///< Очередь io_uring, если она используется.
+    uint64_t next_client_id; ///< Метка следующего клиента, 0 - слушающий сокет.
+    std::vector<Client *> retired; ///< Отключенные клиенты, кадры которых еще могут обрабатываться.
+    std::vector<int> uring_spent; ///< Разобранные буферы io_uring, возвращаемые при следующем чтении.
+
+    /**
+     * @brief Принимает все ожидающие подключения.
+     */
+    void _accept_clients();
+
+    /**
+     * @brief Регистрирует принятое соединение.
+     * 
+     * @param fd Сокет клиента.
+     * @param cli Адрес клиента.
+     */
+    void _add_client(int fd, const struct sockaddr_in &cli);
+
+    /**
+     * @brief Дожидается результатов io_uring и раздает их клиентам.
+     * 
+     * Вызывается под блокировкой lock.
+     * 
+     * @return int Количество результатов или -1 при ошибке ожидания.
+     */
+    int _wait_uring();
+
+    /**
+     * @brief Находит клиента по метке io_uring.
+     * 
+     * @param id Метка клиента.
+     * @return Client* Клиент или NULL, если он уже отключен.
+     */
+    Client *_find_client(uint64_t id);
+
+    /**
+     * @brief Переходит к следующей принятой через io_uring порции данных клиента.
+     * 
+     * Возвращает буфер разобранной порции в кольцо.
+     * 
+     * @param client Клиент.
+     * @return true если есть данные для разбора.
+     */
+    bool _next_chunk(Client *client);
+
+    /**
+     * @brief Читает данные клиента в его буфер.
+     * 
+     * @param client Клиент.
+     */
+    void _read_client(Client *client);
+
+    /**
+     * @brief Разбирает накопленные данные клиентов.
+     * 
+     * @param messages Массив для найденных сообщений.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массива messages.
+     * @return int Количество найденных сообщений.
+     */
+    int _parse_clients(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
+    /**
+     * @brief Отключает клиентов, помеченных на закрытие.
+     */
+    void _remove_closed_clients();
+
+    /**
+     * @brief Освобождает буферы и клиентов, отложенные до следующего чтения.
+     * 
+     * Кадры read_frames() указывают в эти буферы, пока вызывающий их обрабатывает.
+     */
+    void _release_retired();
+
+    /**
+     * @brief Передает клиенту данные или ставит их в его очередь.
+     * 
+     * Вызывается под блокировкой tx_lock.
+     * 
+     * @param client Клиент.
+     * @param buf Буфер с данными.
+     * @param len Длина данных.
+     * @return true если данные переданы или поставлены в очередь.
+     * @return false если клиент отключается или сообщение пропущено.
+     */
+    bool _queue_client(Client *client, const uint8_t *buf, unsigned len);
+
+    /**
+     * @brief Применяет к клиенту поведение при переполнении буфера передачи.
+     * 
+     * Вызывается под блокировкой tx_lock.
+     * 
+     * @param client Клиент.
+     * @return false всегда: сообщение клиенту не передано.
+     */
+    bool _slow_client(Client *client);
+
+    /**
+     * @brief Отправляет накопленные данные клиента.
+     * 
+     * Вызывается под блокировкой tx_lock.
+     * 
+     * @param client Клиент.
+     */
+    void _send_pending(Client *client);
 
     /**
-     * @brief Читает байт из TCP соединения.
+     * @brief Подписывает сокет клиента на EPOLLOUT или отписывает от него.
      * 
-     * @param cp Ссылка на переменную, в которую будет записан прочитанный байт.
-     * @return int Результат операции чтения.
+     * @param client Клиент.
+     * @param want_write Нужна ли подписка.
      */
-    int _read_port(uint8_t &cp);
+    void _watch_write(Client *client, bool want_write);
 
     /**
-     * @brief Записывает данные в TCP соединение.
+     * @brief Рассылает данные клиентам.
      * 
      * @param buf Буфер с данными для записи.
      * @param len Длина данных для записи.
-     * @return int Количество записанных байт.
+     * @param except Клиент, которому данные не отправляются, или NULL.
+     * @return int Количество клиентов, принявших данные.
      */
-    int _write_port(char *buf, unsigned len);
+    int _write_clients(const uint8_t *buf, unsigned len, Client *except);
 };
 
 #endif // TCP_Server_H_
@@ -0,0 +1,150 @@
+#ifndef TELEMETRY_CACHE_H_
+#define TELEMETRY_CACHE_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <atomic>
+#include <chrono>
+
+#include <common/mavlink.h>
+
+/**
+ * @brief Кеш последних значений сообщений по (sysid, compid, msgid).
+ *
+ * Каждая запись защищена seqlock: писатель увеличивает счетчик до и после копирования
+ * сообщения, читатель копирует запись без блокировок и повторяет копирование, если счетчик
+ * изменился. Писатели сериализуются мьютексом, читатели его не берут и не мешают приему.
+ *
+ * Записи располагаются в таблице с открытой адресацией фиксированного размера и никогда не
+ * перемещаются, поэтому поиск записи тоже не требует блокировок.
+ */
+class Telemetry_Cache
+{
+
+public:
+    /**
+     * @brief Снимок записи кеша.
+     */
+    struct Snapshot
+    {
+        mavlink_message_t message; ///< Последнее сообщение, отброшенные нули полезной нагрузки восстановлены.
+        uint64_t timestamp_us; ///< Время приема по steady_clock, мкс.
+        uint32_t updates; ///< Количество обновлений записи.
+    };
+
+    /**
+     * @brief Конструктор.
+     *
+     * @param capacity Наибольшее количество различных (sysid, compid, msgid), округляется до степени двойки.
+     */
+    Telemetry_Cache(int capacity = 256);
+
+    /**
+     * @brief Деструктор.
+     */
+    ~Telemetry_Cache();
+
+    /**
+     * @brief Сохраняет сообщение как последнее значение своего ключа.
+     *
+     * @param message Сообщение.
+     * @return true если сообщение сохранено, false если в таблице нет места.
+     */
+    bool update(const mavlink_message_t &message);
+
+    /**
+     * @brief Копирует последнее значение сообщения.
+     *
+     * @param sysid Идентификатор системы.
+     * @param compid Идентификатор компонента.
+     * @param msgid Идентификатор сообщения.
+     * @param snapshot Снимок записи.
+     * @return true если сообщение уже принималось.
+     */
+    bool get(uint8_t sysid, uint8_t compid, uint32_t msgid, Snapshot &snapshot);
+
+    /**
+     * @brief Копирует и декодирует последнее значение сообщения.
+     *
+     * Пример: get(1, 1, MAVLINK_MSG_ID_ATTITUDE, mavlink_msg_attitude_decode, attitude).
+     *
+     * @param sysid Идентификатор системы.
+     * @param compid Идентификатор компонента.
+     * @param msgid Идентификатор сообщения.
+     * @param decode Функция декодирования сообщения из библиотеки MAVLink.
+     * @param value Декодированное сообщение.
+     * @param timestamp_us Время приема, мкс, или NULL.
+     * @return true если сообщение уже принималось.
+     */
+    template <typename T>
+    bool get(uint8_t sysid, uint8_t compid, uint32_t msgid, void (*decode)(const mavlink_message_t *, T *), T &value,
+             uint64_t *timestamp_us = NULL)
+    {
+        Snapshot snapshot;
+        if (!get(sysid, compid, msgid, snapshot))
+        {
+            return false;
+        }
+
+        decode(&snapshot.message, &value);
+        if (timestamp_us)
+        {
+            *timestamp_us = snapshot.timestamp_us;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Возвращает текущее время в шкале timestamp_us.
+     *
+     * @return uint64_t Время, мкс.
+     */
+    static uint64_t now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    /**
+     * @brief Запись кеша.
+     */
+    struct Entry
+    {
+        std::atomic<uint64_t> key; ///< Ключ записи или 0, если запись свободна.
+        std::atomic<uint32_t> sequence; ///< Счетчик seqlock, нечетный во время записи.
+        uint32_t updates; ///< Количество обновлений.
+        uint64_t timestamp_us; ///< Время приема, мкс.
+        mavlink_message_t message; ///< Последнее сообщение.
+    };
+
+    Entry *entries; ///< Таблица записей.
+    unsigned mask; ///< Размер таблицы минус один.
+    pthread_mutex_t write_lock; ///< Мьютекс писателей.
+    bool full_reported; ///< Флаг выданного предупреждения о заполнении таблицы.
+
+    /**
+     * @brief Составляет ключ записи.
+     *
+     * @param sysid Идентификатор системы.
+     * @param compid Идентификатор компонента.
+     * @param msgid Идентификатор сообщения.
+     * @return uint64_t Ключ, никогда не равный 0.
+     */
+    static uint64_t _key(uint8_t sysid, uint8_t compid, uint32_t msgid)
+    {
+        return ((uint64_t)1 << 48) | ((uint64_t)sysid << 32) | ((uint64_t)compid << 24) | msgid;
+    }
+
+    /**
+     * @brief Ищет запись ключа или свободную запись, в которую его можно поместить.
+     *
+     * @param key Ключ.
+     * @return Entry* Запись или NULL, если ключа нет и свободных записей не осталось.
+     */
+    Entry *_find(uint64_t key);
+};
+
+#endif // TELEMETRY_CACHE_H_
@@ -0,0 +1,222 @@
+#ifndef TLOG_RECORDER_H_
+#define TLOG_RECORDER_H_
+
+#include <cstdlib>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+
+#include <common/mavlink.h>
+
+/**
+ * @brief Запись принятых кадров в файлы формата tlog.
+ *
+ * Каждая запись tlog - время приема в микросекундах от начала эпохи Unix (8 байт,
+ * big-endian), за которым следует кадр MAVLink в том виде, в каком он передается по
+ * каналу. Такие файлы открывают QGroundControl, Mission Planner и pymavlink.
+ *
+ * Кадры записывают потоки приема любых портов: запись занимает ячейку кольцевой очереди
+ * без блокировок и никогда не ждет диска. Если очередь заполнена, кадр отбрасывается и
+ * учитывается в статистике. Фоновый поток собирает записи в выровненный буфер и пишет его
+ * большими блоками, по желанию с O_DIRECT, и начинает новый файл по размеру или времени.
+ */
+class Tlog_Recorder
+{
+
+public:
+    /**
+     * @brief Статистика записи.
+     */
+    struct Stats
+    {
+        unsigned long frames; ///< Количество записанных в буфер кадров.
+        unsigned long bytes; ///< Количество записанных в файлы байт.
+        unsigned long dropped; ///< Количество кадров, отброшенных из-за заполненной очереди.
+        unsigned long files; ///< Количество открытых файлов.
+    };
+
+    /**
+     * @brief Конструктор.
+     *
+     * @param capacity Емкость очереди в кадрах (округляется до степени двойки).
+     */
+    Tlog_Recorder(int capacity = 4096);
+
+    /**
+     * @brief Деструктор. Останавливает запись.
+     */
+    ~Tlog_Recorder();
+
+    /**
+     * @brief Задает условия перехода к новому файлу. Вызывается до start().
+     *
+     * @param max_bytes Размер файла, после которого начинается новый, байт, 0 - без ограничения.
+     * @param max_seconds Наибольшая продолжительность файла, с, 0 - без ограничения.
+     */
+    void set_rotation(unsigned long max_bytes, int max_seconds);
+
+    /**
+     * @brief Включает запись в обход кеша страниц (O_DIRECT). Вызывается до start().
+     *
+     * Блоки записываются кратно DIRECT_ALIGN, неполный последний блок дописывается при
+     * закрытии файла.
+     *
+     * @param enable true для O_DIRECT.
+     */
+    void set_direct_io(bool enable);
+
+    /**
+     * @brief Открывает первый файл и запускает поток записи.
+     *
+     * Файлы называются <prefix>_<номер>.tlog, номер начинается с 0.
+     *
+     * @param prefix Путь и начало имени файлов.
+     * @return true если запись запущена.
+     */
+    bool start(const char *prefix);
+
+    /**
+     * @brief Дописывает очередь в файл, закрывает его и останавливает поток записи.
+     */
+    void stop();
+
+    /**
+     * @brief Ставит сообщение в очередь записи. Не блокируется.
+     *
+     * @param message Принятое сообщение.
+     * @return true если кадр поставлен в очередь, false если запись остановлена или очередь заполнена.
+     */
+    bool record(const mavlink_message_t &message);
+
+    /**
+     * @brief Ставит готовый кадр в очередь записи. Не блокируется.
+     *
+     * @param frame Байты кадра.
+     * @param len Длина кадра, не больше MAVLINK_MAX_PACKET_LEN.
+     * @return true если кадр поставлен в очередь, false если запись остановлена или очередь заполнена.
+     */
+    bool record(const uint8_t *frame, unsigned len);
+
+    /**
+     * @brief Возвращает статистику записи.
+     *
+     * @return Stats Статистика.
+     */
+    Stats get_stats();
+
+private:
+    const static unsigned RECORD_MAX = 8 + MAVLINK_MAX_PACKET_LEN; ///< Наибольшая длина записи tlog.
+    const static unsigned DIRECT_ALIGN = 4096; ///< Выравнивание буфера, размера и смещения записей O_DIRECT.
+    const static unsigned BUFFER_LEN = 1 << 20; ///< Размер буфера записи.
+    const static unsigned WRITE_LEN = 1 << 19; ///< Заполнение буфера, при котором он записывается в файл.
+    const static int FLUSH_INTERVAL_MS = 200; ///< Наибольшее время хранения записей в буфере.
+    const static int IDLE_SLEEP_US = 1000; ///< Пауза потока записи при пустой очереди.
+
+    /**
+     * @brief Ячейка очереди.
+     */
+    struct Slot
+    {
+        std::atomic<unsigned> sequence; ///< Номер позиции, для которой ячейка свободна или заполнена.
+        unsigned len; ///< Длина записи.
+        uint8_t data[RECORD_MAX]; ///< Время и кадр.
+    };
+
+    Slot *slots; ///< Кольцевая очередь записей.
+    unsigned mask; ///< Емкость очереди минус один.
+    alignas(64) std::atomic<unsigned> head; ///< Счетчик занятых производителями ячеек.
+    alignas(64) unsigned tail; ///< Счетчик ячеек, забранных потоком записи.
+
+    std::atomic<unsigned long> frames; ///< Количество записанных кадров.
+    std::atomic<unsigned long> dropped; ///< Количество отброшенных кадров.
+    std::atomic<unsigned long> bytes; ///< Количество записанных в файлы байт.
+    std::atomic<unsigned long> files; ///< Количество открытых файлов.
+
+    std::string prefix; ///< Начало имени файлов.
+    unsigned long max_bytes; ///< Размер файла, после которого начинается новый, 0 - без ограничения.
+    int max_seconds; ///< Наибольшая продолжительность файла, 0 - без ограничения.
+    bool direct_io; ///< Флаг записи с O_DIRECT.
+
+    int fd; ///< Дескриптор текущего файла.
+    unsigned long file_bytes; ///< Количество байт в текущем файле.
+    uint64_t file_opened_ms; ///< Время открытия текущего файла.
+    uint8_t *buffer; ///< Выровненный буфер записи.
+    unsigned buffer_len; ///< Заполнение буфера.
+    uint64_t last_write_ms; ///< Время последней записи в файл.
+
+    std::atomic<bool> running; ///< Флаг работы потока записи.
+    bool writer_created; ///< Флаг созданного потока записи.
+    pthread_t writer_thread; ///< Поток записи.
+
+    /**
+     * @brief Занимает ячейку очереди.
+     *
+     * @param position Позиция занятой ячейки.
+     * @return Slot* Ячейка или NULL, если очередь заполнена.
+     */
+    Slot *_reserve(unsigned &position);
+
+    /**
+     * @brief Заполняет время записи и передает ячейку потоку записи.
+     *
+     * @param slot Ячейка с кадром после 8 байт времени.
+     * @param position Позиция ячейки.
+     * @param frame_len Длина кадра.
+     */
+    void _commit(Slot *slot, unsigned position, unsigned frame_len);
+
+    /**
+     * @brief Цикл потока записи.
+     */
+    void _writer_loop();
+
+    /**
+     * @brief Переносит записи из очереди в буфер.
+     *
+     * @return int Количество перенесенных записей.
+     */
+    int _drain();
+
+    /**
+     * @brief Записывает буфер в файл.
+     *
+     * @param all true чтобы записать и неполный последний блок O_DIRECT.
+     * @return bool false при ошибке записи.
+     */
+    bool _write_buffer(bool all);
+
+    /**
+     * @brief Открывает очередной файл.
+     *
+     * @return bool true если файл открыт.
+     */
+    bool _open_file();
+
+    /**
+     * @brief Дописывает буфер и закрывает текущий файл.
+     */
+    void _close_file();
+
+    /**
+     * @brief Возвращает время по CLOCK_MONOTONIC.
+     *
+     * @return uint64_t Время, мс.
+     */
+    static uint64_t _now_ms();
+
+    /**
+     * @brief Функция запуска потока записи.
+     *
+     * @param args Указатель на объект Tlog_Recorder.
+     * @return void* Всегда NULL.
+     */
+    static void *_start_writer_thread(void *args);
+};
+
+#endif // TLOG_RECORDER_H_
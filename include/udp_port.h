@@ -17,10 +17,12 @@
 #include <time.h>
 #include <arpa/inet.h>
 #include <stdbool.h>
+#include <vector>
 
 #include <common/mavlink.h>
 
 #include "generic_port.h"
+#include "uring_engine.h"
 
 /**
  * @brief Класс для работы с UDP портом.
@@ -32,6 +34,20 @@ class UDP_Port : public Generic_Port
 {
 
 public:
+    const static int TX_BATCH_LEN = 64; ///< Максимальная длина очереди пакетной передачи.
+    const static int TX_COALESCE_MAX = 1472; ///< Максимальный размер объединенной датаграммы (MTU Ethernet без заголовков IP/UDP).
+
+    /**
+     * @brief Счетчики передачи.
+     * 
+     * Отношение frames / datagrams показывает достигнутое количество сообщений на датаграмму.
+     */
+    struct Tx_Stats
+    {
+        unsigned long datagrams; ///< Отправлено датаграмм.
+        unsigned long frames; ///< Отправлено сообщений Mavlink.
+    };
+
     /**
      * @brief Конструктор по умолчанию.
      */
@@ -58,6 +74,15 @@ public:
      */
     int read_message(mavlink_message_t &message);
 
+    /**
+     * @brief Читает все сообщения из очередной датаграммы UDP.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param max_messages Размер массива messages.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    int read_messages(mavlink_message_t *messages, int max_messages);
+
     /**
      * @brief Записывает сообщение в UDP соединение.
      * 
@@ -66,6 +91,121 @@ public:
      */
     int write_message(const mavlink_message_t &message);
 
+    /**
+     * @brief Записывает готовые кадры в UDP соединение.
+     * 
+     * @param buf Байты кадров.
+     * @param len Длина данных.
+     * @return int Количество байт, записанных в соединение.
+     */
+    int write_raw(const uint8_t *buf, unsigned len);
+
+    /**
+     * @brief Добавляет получателя для пакетной передачи.
+     * 
+     * Адрес разрешается один раз и используется всеми последующими вызовами queue_message().
+     * Получатель 0 всегда соответствует целевому адресу порта.
+     * 
+     * @param ip IP-адрес получателя.
+     * @param port UDP порт получателя.
+     * @return int Номер получателя или -1 при неверном адресе.
+     */
+    int add_peer(const char *ip, int port);
+
+    /**
+     * @brief Ставит сообщение в очередь пакетной передачи.
+     * 
+     * Сообщения отправляются одним вызовом sendmmsg() в flush_batch().
+     * 
+     * @param message Сообщение Mavlink.
+     * @param peer Номер получателя, 0 - целевой адрес порта.
+     * @return int Позиция сообщения в очереди (индекс в массиве результатов flush_batch()) или -1, если очередь заполнена или получатель неизвестен.
+     */
+    int queue_message(const mavlink_message_t &message, int peer = 0);
+
+    /**
+     * @brief Отправляет очередь пакетной передачи одним вызовом sendmmsg().
+     * 
+     * @param results Массив размером не меньше TX_BATCH_LEN для результата каждого сообщения:
+     *                количество отправленных байт или -1. Может быть NULL.
+     * @return int Количество успешно отправленных сообщений.
+     */
+    int flush_batch(int *results = NULL);
+
+    /**
+     * @brief Отправляет очередь пакетной передачи.
+     * 
+     * @return int 0 если все сообщения отправлены, -1 иначе.
+     */
+    int flush();
+
+    /**
+     * @brief Включает объединение сообщений write_message() в общие датаграммы.
+     * 
+     * Сообщения накапливаются, пока датаграмма не достигнет max_bytes или пока с момента
+     * постановки первого сообщения не пройдет deadline_us. Срок соблюдает поток передачи
+     * порта, поэтому последнее сообщение не ждет следующей записи или приема.
+     * 
+     * @param max_bytes Максимальный размер датаграммы (не больше TX_COALESCE_MAX), 0 - отключить объединение.
+     * @param deadline_us Максимальное время ожидания первого сообщения датаграммы, мкс.
+     */
+    void set_tx_coalescing(int max_bytes, int deadline_us = 1000);
+
+    /**
+     * @brief Отправляет накопленную датаграмму, если истек срок ее ожидания.
+     * 
+     * Поток передачи делает это сам, вызов нужен только для проверки раньше срока его пробуждения.
+     */
+    void poll_tx();
+
+    /**
+     * @brief Возвращает счетчики передачи.
+     * 
+     * @return Tx_Stats Количество отправленных датаграмм и сообщений.
+     */
+    Tx_Stats get_tx_stats();
+
+    /**
+     * @brief Включает пакетный прием датаграмм через recvmmsg().
+     * 
+     * За один системный вызов принимается до datagrams датаграмм в заранее выделенные буферы,
+     * read_messages() возвращает сообщения из всех датаграмм пакета сразу.
+     * Вызывается до запуска порта.
+     * 
+     * @param datagrams Максимальное количество датаграмм за вызов, 1 - прием по одной через recvfrom().
+     */
+    void set_rx_batch(int datagrams);
+
+    /**
+     * @brief Выбирает механизм ввода-вывода. Вызывается до запуска порта.
+     * 
+     * С io_uring прием идет многократным recvmsg() в кольцо буферов ядра, одно ожидание
+     * возвращает все пришедшие датаграммы, а передача ставит запросы sendmsg() в очередь,
+     * flush_batch() отправляет всю очередь одним вызовом io_uring_enter().
+     * 
+     * @param engine Механизм ввода-вывода.
+     * @return true если механизм выбран.
+     */
+    bool set_io_engine(Io_Engine engine);
+
+    /**
+     * @brief Возвращает дескриптор сокета или очереди io_uring.
+     * 
+     * @return int Дескриптор.
+     */
+    int get_fd()
+    {
+        return uring.is_ready() ? uring.get_fd() : sock;
+    }
+
+    /**
+     * @brief Возвращает количество принятых байт, ожидающих разбора,
+     * включая еще не разобранные датаграммы пакета recvmmsg().
+     * 
+     * @return int Количество байт.
+     */
+    int rx_pending();
+
     /**
      * @brief Проверяет, запущен ли порт.
      * 
@@ -86,9 +226,24 @@ public:
      * @brief Закрывает UDP порт.
      */
     void stop();
+
+protected:
+    /**
+     * @brief Читает сообщения вместе с их исходными байтами в буфере датаграмм.
+     * 
+     * @param messages Массив, в который будут записаны прочитанные сообщения.
+     * @param frames Массив кадров того же размера или NULL.
+     * @param max_messages Размер массивов.
+     * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+     */
+    int read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages);
+
 private:
-    mavlink_status_t lastStatus; ///< Статус последнего сообщения Mavlink.
     pthread_mutex_t lock; ///< Мьютекс для синхронизации доступа к порту.
+    pthread_mutex_t tx_lock; ///< Мьютекс передачи: очередь и адреса получателей.
+    pthread_cond_t tx_cond; ///< Условие появления накапливаемой датаграммы (часы CLOCK_MONOTONIC).
+    pthread_t tx_thread; ///< Поток отправки датаграмм по истечении срока.
+    bool tx_running; ///< Флаг работы потока передачи.
 
     /**
      * @brief Инициализирует значения по умолчанию для атрибутов.
@@ -99,7 +254,40 @@ private:
     char buff[BUFF_LEN]; ///< Буфер для чтения данных.
     int buff_ptr; ///< Указатель на текущую позицию в буфере.
     int buff_len; ///< Длина данных в буфере.
-    bool debug; ///< Флаг для включения режима отладки.
+    char *rx_data; ///< Разбираемая датаграмма: buff или один из буферов пакета.
+    in_addr_t target_addr; ///< Целевой IP-адрес в двоичном виде.
+
+    int rx_batch; ///< Максимальное количество датаграмм за один recvmmsg().
+    int rx_batch_count; ///< Количество датаграмм, принятых последним recvmmsg().
+    int rx_batch_index; ///< Индекс разбираемой датаграммы пакета.
+    std::vector<char> rx_batch_buffers; ///< Буферы датаграмм пакета, по BUFF_LEN на каждую.
+    std::vector<struct mmsghdr> rx_batch_msgs; ///< Заголовки recvmmsg().
+    std::vector<struct iovec> rx_batch_iovecs; ///< Векторы ввода для буферов пакета.
+    std::vector<struct sockaddr_in> rx_batch_addrs; ///< Адреса отправителей датаграмм пакета.
+
+    const static int URING_RX_BATCH = 64; ///< Количество результатов io_uring за одно ожидание.
+    Io_Engine io_engine; ///< Выбранный механизм ввода-вывода.
+    Uring_Engine uring; ///< Очередь io_uring, если она используется.
+    Uring_Engine::Completion uring_rx[URING_RX_BATCH]; ///< Принятые через io_uring датаграммы.
+    int uring_rx_count; ///< Количество датаграмм в uring_rx.
+    int uring_rx_index; ///< Индекс разбираемой датаграммы uring_rx.
+    std::vector<int> uring_spent; ///< Буферы разобранных датаграмм, возвращаемые перед следующим ожиданием.
+
+    std::vector<struct sockaddr_in> peers; ///< Разрешенные адреса получателей, 0 - целевой адрес.
+    int tx_batch_count; ///< Количество сообщений в очереди пакетной передачи.
+    uint8_t tx_batch_buffers[TX_BATCH_LEN][MAVLINK_MAX_PACKET_LEN]; ///< Сериализованные сообщения очереди.
+    int tx_batch_peers[TX_BATCH_LEN]; ///< Получатели сообщений очереди.
+    int tx_batch_map[TX_BATCH_LEN]; ///< Позиции в очереди для заголовков sendmmsg().
+    struct mmsghdr tx_batch_msgs[TX_BATCH_LEN]; ///< Заголовки sendmmsg().
+    struct iovec tx_batch_iovecs[TX_BATCH_LEN]; ///< Векторы вывода сообщений очереди.
+
+    int tx_coalesce_bytes; ///< Максимальный размер объединенной датаграммы, 0 - объединение выключено.
+    int tx_coalesce_deadline_us; ///< Срок ожидания первого сообщения датаграммы, мкс.
+    uint8_t tx_pending[TX_COALESCE_MAX]; ///< Накапливаемая датаграмма.
+    int tx_pending_len; ///< Длина накопленной датаграммы.
+    int tx_pending_frames; ///< Количество сообщений в накопленной датаграмме.
+    uint64_t tx_pending_since_us; ///< Время постановки первого сообщения датаграммы.
+    Tx_Stats tx_stats; ///< Счетчики передачи.
     const char *target_ip; ///< Целевой IP-адрес.
     int rx_port; ///< Порт для приема данных.
     int tx_port; ///< Порт для передачи данных.
@@ -114,6 +302,35 @@ private:
      */
     int _read_port(uint8_t &cp);
 
+    /**
+     * @brief Переходит к следующей датаграмме.
+     * 
+     * Вызывается под блокировкой порта, когда текущая датаграмма полностью разобрана.
+     * Берет следующую датаграмму уже принятого пакета или выполняет recvmmsg()/recvfrom().
+     * 
+     * @return int Длина датаграммы или результат системного вызова при ошибке.
+     */
+    int _receive_datagram();
+
+    /**
+     * @brief Дожидается датаграмм из очереди io_uring.
+     * 
+     * Вызывается под блокировкой порта. Ошибки передачи из очереди выводятся и отбрасываются.
+     * 
+     * @return int Количество датаграмм в uring_rx или -1 при ошибке.
+     */
+    int _wait_uring();
+
+    /**
+     * @brief Проверяет, остались ли неразобранные датаграммы уже принятого пакета.
+     * 
+     * @return true если следующая датаграмма доступна без системного вызова.
+     */
+    bool _datagram_queued()
+    {
+        return rx_batch_index + 1 < rx_batch_count || uring_rx_index + 1 < uring_rx_count;
+    }
+
     /**
      * @brief Записывает данные в UDP соединение.
      * 
@@ -122,6 +339,49 @@ private:
      * @return int Количество записанных байт.
      */
     int _write_port(char *buf, unsigned len);
+
+    /**
+     * @brief Добавляет данные в накапливаемую датаграмму.
+     * 
+     * Вызывается под блокировкой передачи.
+     * 
+     * @param buf Буфер с сообщением.
+     * @param len Длина сообщения.
+     * @return int Количество принятых байт или -1 при ошибке отправки.
+     */
+    int _coalesce(const char *buf, unsigned len);
+
+    /**
+     * @brief Отправляет накопленную датаграмму целевому адресу.
+     * 
+     * Вызывается под блокировкой передачи.
+     * 
+     * @return int Количество отправленных байт или -1 при ошибке.
+     */
+    int _send_pending();
+
+    /**
+     * @brief Отправляет очередь пакетной передачи.
+     * 
+     * Вызывается под блокировкой передачи.
+     * 
+     * @param results Массив результатов, как в flush_batch(), или NULL.
+     * @return int Количество успешно отправленных сообщений.
+     */
+    int _flush_batch_locked(int *results);
+
+    /**
+     * @brief Цикл потока передачи: отправляет накопленную датаграмму по истечении срока.
+     */
+    void _tx_loop();
+
+    /**
+     * @brief Точка входа потока передачи.
+     * 
+     * @param args Указатель на объект UDP_Port.
+     * @return void* Всегда NULL.
+     */
+    static void *_start_tx_thread(void *args);
 };
 
 #endif // UDP_PORT_H_
@@ -0,0 +1,438 @@
+#ifndef URING_ENGINE_H_
+#define URING_ENGINE_H_
+
+#include <cstdlib>
+#include <stdint.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/io_uring.h>
+#include <vector>
+
+/**
+ * @brief Механизм ввода-вывода на основе io_uring.
+ *
+ * Прием выполняется многократными (multishot) запросами recv/recvmsg/accept, которые
+ * остаются в очереди и выбирают буферы из зарегистрированного кольца буферов приема,
+ * поэтому один вызов io_uring_enter() возвращает данные многих датаграмм и соединений.
+ * Передаваемые данные копируются в зарегистрированные слоты и отправляются пачкой запросов.
+ * Данные потока (TCP, последовательный порт) дописываются в слоты, пока предыдущая запись
+ * не завершена, и уходят следующей записью, сохраняя порядок байт.
+ *
+ * Работает через системные вызовы io_uring напрямую, без liburing.
+ * Требуется ядро 5.19 или новее (кольцо буферов приема, многократный прием).
+ * Ожидание wait() рассчитано на один поток чтения, send() может вызываться из других потоков.
+ */
+class Uring_Engine
+{
+
+public:
+    /**
+     * @brief Вид запроса приема.
+     */
+    enum Recv_Mode
+    {
+        RECV_STREAM,   ///< Многократный recv() потокового сокета.
+        RECV_DATAGRAM, ///< Многократный recvmsg() с адресом отправителя.
+        RECV_READ      ///< Повторяемый read() для файлов, не являющихся сокетами.
+    };
+
+    /**
+     * @brief Вид завершенного запроса.
+     */
+    enum Completion_Kind
+    {
+        COMPLETION_RECV,   ///< Приняты данные, конец потока или ошибка приема.
+        COMPLETION_ACCEPT, ///< Принято соединение, result - его дескриптор.
+        COMPLETION_SEND    ///< Ошибка передачи или, если включено, завершенная запись потока.
+    };
+
+    /**
+     * @brief Результат завершенного запроса.
+     */
+    struct Completion
+    {
+        Completion_Kind kind; ///< Вид запроса.
+        uint64_t tag; ///< Метка, переданная при постановке запроса.
+        int result; ///< Количество байт, дескриптор соединения или -errno.
+        const uint8_t *data; ///< Принятые данные или NULL.
+        int buffer; ///< Номер буфера приема для recycle() или -1.
+        struct sockaddr_in addr; ///< Адрес отправителя датаграммы.
+    };
+
+    /**
+     * @brief Конструктор. Очередь создается в init().
+     */
+    Uring_Engine();
+
+    /**
+     * @brief Деструктор. Освобождает очередь.
+     */
+    ~Uring_Engine();
+
+    /**
+     * @brief Создает очередь, кольцо буферов приема и слоты передачи.
+     *
+     * @param rx_buffer_len Размер одного буфера приема.
+     * @param rx_buffers Количество буферов приема (округляется до степени двойки).
+     * @param tx_slots Количество слотов передачи.
+     * @return true если очередь создана.
+     * @return false если ядро не поддерживает нужные возможности io_uring.
+     */
+    bool init(int rx_buffer_len, int rx_buffers = 256, int tx_slots = 64);
+
+    /**
+     * @brief Закрывает очередь. Незавершенные запросы отменяются.
+     */
+    void release();
+
+    /**
+     * @brief Проверяет, создана ли очередь.
+     *
+     * @return true если очередь создана.
+     */
+    bool is_ready()
+    {
+        return ring_fd >= 0;
+    }
+
+    /**
+     * @brief Возвращает дескриптор очереди.
+     *
+     * Дескриптор готов к чтению, когда в очереди есть завершенные запросы.
+     *
+     * @return int Дескриптор или -1.
+     */
+    int get_fd()
+    {
+        return ring_fd;
+    }
+
+    /**
+     * @brief Ставит запрос приема, который повторяется до отмены или конца потока.
+     *
+     * @param fd Дескриптор.
+     * @param tag Метка для результатов.
+     * @param mode Вид запроса.
+     * @return true если запрос поставлен.
+     */
+    bool recv(int fd, uint64_t tag, Recv_Mode mode);
+
+    /**
+     * @brief Ставит многократный запрос приема соединений.
+     *
+     * @param fd Слушающий сокет.
+     * @param tag Метка для результатов.
+     * @return true если запрос поставлен.
+     */
+    bool accept(int fd, uint64_t tag);
+
+    /**
+     * @brief Отменяет прием и передачу для дескриптора.
+     *
+     * Вызывается до закрытия дескриптора. Неотправленные данные потока отбрасываются.
+     *
+     * @param fd Дескриптор.
+     */
+    void cancel(int fd);
+
+    /**
+     * @brief Ставит данные в очередь передачи.
+     *
+     * @param fd Дескриптор.
+     * @param tag Метка для ошибок передачи.
+     * @param buf Данные.
+     * @param len Длина данных, не больше TX_SLOT_LEN.
+     * @param addr Получатель датаграммы или NULL для потока.
+     * @param block Ждать освобождения слота, если все слоты заняты.
+     * @return int len или -1, если свободного слота нет.
+     */
+    int send(int fd, uint64_t tag, const uint8_t *buf, unsigned len, const struct sockaddr_in *addr = NULL, bool block = true);
+
+    /**
+     * @brief Устанавливает количество подготовленных запросов, при котором send() отправляет их ядру.
+     *
+     * Меньшее количество отправляется вместе с ближайшим ожиданием wait(), вызовом submit() или drain().
+     *
+     * @param count Количество запросов, 1 - отправлять каждый сразу.
+     */
+    void set_submit_batch(int count);
+
+    /**
+     * @brief Включает выдачу COMPLETION_SEND для каждой завершенной записи потока.
+     *
+     * @param report true - выдавать.
+     */
+    void set_report_sends(bool report);
+
+    /**
+     * @brief Отправляет ядру подготовленные запросы.
+     *
+     * @return int Количество отправленных запросов или -1 при ошибке.
+     */
+    int submit();
+
+    /**
+     * @brief Дожидается завершения всех поставленных передач.
+     *
+     * @return int 0 при успехе, -1 если очередь не создана.
+     */
+    int drain();
+
+    /**
+     * @brief Возвращает объем неотправленных данных потока.
+     *
+     * @param fd Дескриптор.
+     * @return int Количество байт.
+     */
+    int stream_pending(int fd);
+
+    /**
+     * @brief Отправляет подготовленные запросы и забирает завершенные.
+     *
+     * Буферы данных остаются занятыми до вызова recycle().
+     *
+     * @param completions Массив для результатов.
+     * @param max_completions Размер массива.
+     * @param timeout_ms Время ожидания, мс, -1 - без ограничения, 0 - не ждать.
+     * @return int Количество результатов или -1 при ошибке.
+     */
+    int wait(Completion *completions, int max_completions, int timeout_ms);
+
+    /**
+     * @brief Возвращает количество завершенных запросов, еще не выданных wait().
+     *
+     * @return int Количество результатов.
+     */
+    int ready_count();
+
+    /**
+     * @brief Возвращает буфер приема в кольцо.
+     *
+     * @param buffer Номер буфера из Completion::buffer, -1 игнорируется.
+     */
+    void recycle(int buffer);
+
+    const static int TX_SLOT_LEN = 16384; ///< Размер слота передачи.
+
+private:
+    const static unsigned RING_ENTRIES = 256; ///< Размер очереди запросов.
+    const static int BUFFER_GROUP = 0; ///< Группа буферов приема.
+
+    /**
+     * @brief Тип запроса в старших битах user_data.
+     */
+    enum Request_Type
+    {
+        REQUEST_RECV = 1,
+        REQUEST_SEND,
+        REQUEST_WAKE,
+        REQUEST_CANCEL
+    };
+
+    /**
+     * @brief Повторяемый запрос приема.
+     */
+    struct Receiver
+    {
+        int fd; ///< Дескриптор.
+        uint64_t tag; ///< Метка результатов.
+        Recv_Mode mode; ///< Вид приема.
+        bool is_accept; ///< Запрос приема соединений.
+        bool active; ///< Запрос не отменен.
+        bool armed; ///< Запрос находится в ядре.
+        bool starved; ///< Запрос остановлен из-за нехватки буферов приема.
+        struct msghdr msg; ///< Заголовок recvmsg().
+    };
+
+    /**
+     * @brief Слот передачи в зарегистрированной памяти.
+     */
+    struct Slot
+    {
+        int len; ///< Длина данных.
+        int stream; ///< Поток слота или -1 для датаграммы.
+        int next; ///< Следующий слот потока или свободного списка.
+        uint64_t tag; ///< Метка датаграммы.
+        struct sockaddr_in addr; ///< Получатель датаграммы.
+        struct iovec iov; ///< Вектор sendmsg().
+        struct msghdr msg; ///< Заголовок sendmsg().
+    };
+
+    /**
+     * @brief Упорядоченная передача в один дескриптор.
+     */
+    struct Stream
+    {
+        int fd; ///< Дескриптор.
+        uint64_t tag; ///< Метка результатов.
+        bool is_socket; ///< Дескриптор - сокет, запись идет send() без SIGPIPE.
+        bool active; ///< Поток не отменен.
+        bool writing; ///< Запись находится в ядре.
+        int head; ///< Первый слот очереди или -1.
+        int tail; ///< Последний слот очереди или -1.
+        int offset; ///< Отправленная часть первого слота.
+        int pending; ///< Неотправленные байты.
+    };
+
+    pthread_mutex_t lock; ///< Мьютекс очередей, слотов и результатов.
+
+    int ring_fd; ///< Дескриптор io_uring.
+    void *sq_ptr; ///< Отображение очереди запросов.
+    size_t sq_size; ///< Размер отображения очереди запросов.
+    void *cq_ptr; ///< Отображение очереди завершений.
+    size_t cq_size; ///< Размер отображения очереди завершений.
+    struct io_uring_sqe *sqes; ///< Массив запросов.
+    size_t sqes_size; ///< Размер массива запросов.
+    unsigned *sq_head; ///< Голова очереди запросов (ядро).
+    unsigned *sq_tail; ///< Хвост очереди запросов.
+    unsigned *sq_array; ///< Индексы запросов.
+    unsigned sq_mask; ///< Маска очереди запросов.
+    unsigned sq_entries; ///< Размер очереди запросов.
+    unsigned sq_local_tail; ///< Хвост с учетом еще не опубликованных запросов.
+    unsigned *cq_head; ///< Голова очереди завершений.
+    unsigned *cq_tail; ///< Хвост очереди завершений (ядро).
+    unsigned cq_mask; ///< Маска очереди завершений.
+    struct io_uring_cqe *cqes; ///< Массив завершений.
+
+    struct io_uring_buf_ring *buf_ring; ///< Кольцо буферов приема.
+    size_t buf_ring_size; ///< Размер кольца буферов приема.
+    unsigned buf_mask; ///< Маска кольца буферов приема.
+    unsigned short buf_tail; ///< Хвост кольца буферов приема.
+    uint8_t *rx_pool; ///< Память буферов приема.
+    int rx_buffer_len; ///< Размер буфера приема.
+    int rx_buffers; ///< Количество буферов приема.
+
+    uint8_t *tx_pool; ///< Память слотов передачи.
+    bool tx_registered; ///< Память слотов зарегистрирована для WRITE_FIXED.
+    std::vector<Slot> slots; ///< Слоты передачи.
+    int free_slot; ///< Первый свободный слот или -1.
+    int sends_in_flight; ///< Запросы передачи в ядре.
+
+    std::vector<Receiver *> receivers; ///< Запросы приема.
+    std::vector<Stream> streams; ///< Потоки передачи.
+    std::vector<Completion> ready; ///< Результаты, еще не выданные wait().
+    size_t ready_pos; ///< Первый невыданный результат.
+    bool waiting; ///< Поток чтения ждет в io_uring_enter().
+    int submit_batch; ///< Порог отправки запросов из send().
+    bool report_sends; ///< Выдавать завершенные записи потоков.
+
+    /**
+     * @brief Вызывает io_uring_enter().
+     *
+     * @param to_submit Количество запросов для отправки.
+     * @param min_complete Минимальное количество завершений для ожидания.
+     * @param timeout_ms Время ожидания, мс, -1 - без ограничения.
+     * @return int Результат системного вызова.
+     */
+    int _enter(unsigned to_submit, unsigned min_complete, int timeout_ms);
+
+    /**
+     * @brief Возвращает количество подготовленных, но не отправленных запросов.
+     *
+     * @return unsigned Количество запросов.
+     */
+    unsigned _sq_ready();
+
+    /**
+     * @brief Выделяет запрос в очереди, при переполнении отправляет очередь ядру.
+     *
+     * @param type Тип запроса.
+     * @param index Номер приемника или слота.
+     * @return io_uring_sqe* Обнуленный запрос.
+     */
+    struct io_uring_sqe *_get_sqe(Request_Type type, unsigned index);
+
+    /**
+     * @brief Отправляет подготовленные запросы под блокировкой.
+     *
+     * @return int Результат io_uring_enter().
+     */
+    int _submit_locked();
+
+    /**
+     * @brief Забирает завершения из очереди ядра.
+     */
+    void _reap();
+
+    /**
+     * @brief Обрабатывает завершение приема.
+     *
+     * @param index Номер приемника.
+     * @param cqe Завершение.
+     */
+    void _complete_recv(unsigned index, const struct io_uring_cqe *cqe);
+
+    /**
+     * @brief Обрабатывает завершение передачи.
+     *
+     * @param index Номер слота.
+     * @param res Результат записи.
+     */
+    void _complete_send(unsigned index, int res);
+
+    /**
+     * @brief Ставит запрос приема в очередь.
+     *
+     * @param index Номер приемника.
+     */
+    void _arm(unsigned index);
+
+    /**
+     * @brief Добавляет приемник.
+     *
+     * @param fd Дескриптор.
+     * @param tag Метка.
+     * @param mode Вид приема.
+     * @param is_accept Прием соединений.
+     * @return true если запрос поставлен.
+     */
+    bool _add_receiver(int fd, uint64_t tag, Recv_Mode mode, bool is_accept);
+
+    /**
+     * @brief Берет свободный слот передачи.
+     *
+     * @param block Ждать освобождения слота.
+     * @return int Номер слота или -1.
+     */
+    int _take_slot(bool block);
+
+    /**
+     * @brief Возвращает слот в свободный список.
+     *
+     * @param index Номер слота.
+     */
+    void _free_slot(unsigned index);
+
+    /**
+     * @brief Ставит запись первого слота потока, если поток не пишет.
+     *
+     * @param index Номер потока.
+     */
+    void _write_stream(int index);
+
+    /**
+     * @brief Освобождает все слоты потока.
+     *
+     * @param index Номер потока.
+     */
+    void _drop_stream(int index);
+
+    /**
+     * @brief Возвращает буфер приема в кольцо под блокировкой.
+     *
+     * @param buffer Номер буфера, -1 игнорируется.
+     */
+    void _return_buffer(int buffer);
+};
+
+#endif // URING_ENGINE_H_
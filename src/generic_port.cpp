@@ -0,0 +1,876 @@
+#include "generic_port.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Конструктор класса Generic_Port.
+ * 
+ * Каждый порт разбирает данные своим состоянием, поэтому порты можно читать из разных потоков.
+ */
+Generic_Port::Generic_Port()
+{
+    debug = false;
+    memset(&lastStatus, 0, sizeof(lastStatus));
+    _reset_parser();
+    telemetry = NULL;
+    recorder = NULL;
+    view_messages = NULL;
+    view_frames = NULL;
+    view_bytes = NULL;
+    view_capacity = 0;
+    resync_scan = true;
+    tx_seq = 0;
+
+    rx_queue = NULL;
+    rx_queue_mask = 0;
+    rx_queue_head = 0;
+    rx_queue_tail = 0;
+    rx_consumer_waiting = false;
+    rx_overflows = 0;
+    rx_error = 0;
+    rx_thread_running = false;
+    rx_thread_created = false;
+    rx_wake_fd = -1;
+    rx_ready_fd = -1;
+}
+
+/**
+ * @brief Деструктор класса Generic_Port.
+ * 
+ * Освобождает очередь приема. Поток приема вызывает методы наследника,
+ * поэтому он должен быть остановлен в stop() порта.
+ */
+Generic_Port::~Generic_Port()
+{
+    delete[] rx_queue;
+    delete[] view_messages;
+    delete[] view_frames;
+    delete[] view_bytes;
+
+    if (rx_wake_fd >= 0)
+    {
+        close(rx_wake_fd);
+    }
+    if (rx_ready_fd >= 0)
+    {
+        close(rx_ready_fd);
+    }
+}
+
+/**
+ * @brief Запускает фоновый поток приема запущенного порта.
+ * 
+ * @param capacity Емкость очереди в сообщениях (округляется до степени двойки).
+ * @return true если поток запущен.
+ */
+bool Generic_Port::start_rx_thread(int capacity)
+{
+    if (rx_thread_created || !is_running())
+    {
+        fprintf(stderr, "ERROR: rx thread needs a started port without a running rx thread\n");
+        return false;
+    }
+
+    if (rx_wake_fd < 0)
+    {
+        rx_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    if (rx_ready_fd < 0)
+    {
+        rx_ready_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+    if (rx_wake_fd < 0 || rx_ready_fd < 0)
+    {
+        fprintf(stderr, "ERROR: Could not create rx thread events, errno = %d : %m\n", errno);
+        return false;
+    }
+
+    // masking the counters needs a power of two
+    unsigned size = 1;
+    while (size < (unsigned)capacity)
+    {
+        size <<= 1;
+    }
+    if (size != rx_queue_mask + 1 || rx_queue == NULL)
+    {
+        delete[] rx_queue;
+        rx_queue = new mavlink_message_t[size];
+        rx_queue_mask = size - 1;
+    }
+    rx_queue_head = 0;
+    rx_queue_tail = 0;
+    rx_error = 0;
+
+    rx_thread_running = true;
+    if (pthread_create(&rx_thread, NULL, &Generic_Port::_start_rx_thread, this) != 0)
+    {
+        rx_thread_running = false;
+        fprintf(stderr, "ERROR: Could not start rx thread\n");
+        return false;
+    }
+    rx_thread_created = true;
+
+    return true;
+}
+
+/**
+ * @brief Останавливает фоновый поток приема.
+ */
+void Generic_Port::stop_rx_thread()
+{
+    if (!rx_thread_created)
+    {
+        return;
+    }
+
+    // wake up poll() of the receive thread
+    rx_thread_running = false;
+    uint64_t value = 1;
+    if (write(rx_wake_fd, &value, sizeof(value)) < 0)
+    {
+        fprintf(stderr, "WARNING: Could not wake up rx thread\n");
+    }
+
+    pthread_join(rx_thread, NULL);
+    rx_thread_created = false;
+
+    while (read(rx_wake_fd, &value, sizeof(value)) > 0)
+    {
+    }
+}
+
+/**
+ * @brief Читает сообщения вместе с их исходными байтами.
+ * 
+ * @param messages Массив, в который будут записаны прочитанные сообщения.
+ * @param frames Массив кадров того же размера.
+ * @param max_messages Размер массивов.
+ * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+ */
+int Generic_Port::read_frames(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    return read_messages(messages, frames, max_messages);
+}
+
+/**
+ * @brief Читает сообщения вместе с их исходными байтами под блокировкой порта.
+ * 
+ * Реализация по умолчанию не знает буфера приема порта и возвращает кадры без байт,
+ * read_views() собирает их заново.
+ * 
+ * @param messages Массив, в который будут записаны прочитанные сообщения.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массивов.
+ * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+ */
+int Generic_Port::read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    int count = read_messages(messages, max_messages);
+
+    for (int i = 0; frames && i < count; i++)
+    {
+        frames[i].data = NULL;
+        frames[i].len = _frame_length(messages[i]);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Читает кадры в виде представлений без копирования в mavlink_message_t.
+ * 
+ * @param views Массив представлений.
+ * @param max_views Размер массива views.
+ * @return int Количество прочитанных кадров или -1 при ошибке чтения.
+ */
+int Generic_Port::read_views(Frame_View *views, int max_views)
+{
+    if (max_views > view_capacity)
+    {
+        delete[] view_messages;
+        delete[] view_frames;
+        delete[] view_bytes;
+        view_messages = new mavlink_message_t[max_views];
+        view_frames = new Raw_Frame[max_views];
+        view_bytes = new uint8_t[(size_t)max_views * MAVLINK_MAX_PACKET_LEN];
+        view_capacity = max_views;
+    }
+
+    int count = read_frames(view_messages, view_frames, max_views);
+
+    for (int i = 0; i < count; i++)
+    {
+        views[i].data = view_frames[i].data;
+        views[i].len = view_frames[i].len;
+
+        // only a frame split between reads is put together again
+        if (views[i].data == NULL)
+        {
+            uint8_t *buf = view_bytes + (size_t)i * MAVLINK_MAX_PACKET_LEN;
+            views[i].len = mavlink_msg_to_send_buffer(buf, &view_messages[i]);
+            views[i].data = buf;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Читает кадры и копирует их в пул кадров.
+ * 
+ * @param arena Пул кадров.
+ * @param frames Массив для кадров.
+ * @param max_frames Размер массива frames.
+ * @return int Количество прочитанных кадров или -1 при ошибке чтения.
+ */
+int Generic_Port::read_pooled(Message_Arena &arena, Pooled_Frame **frames, int max_frames)
+{
+    Frame_View views[RX_THREAD_BATCH];
+    int count = read_views(views, max_frames < RX_THREAD_BATCH ? max_frames : RX_THREAD_BATCH);
+
+    for (int i = 0; i < count; i++)
+    {
+        frames[i] = arena.copy(views[i]);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Забирает сообщения, принятые фоновым потоком.
+ * 
+ * @param messages Массив для сообщений.
+ * @param max_messages Размер массива messages.
+ * @param timeout_ms Время ожидания пустой очереди, мс, -1 - без ограничения, 0 - не ждать.
+ * @return int Количество сообщений, 0 если их нет или поток приема остановлен.
+ */
+int Generic_Port::pop_messages(mavlink_message_t *messages, int max_messages, int timeout_ms)
+{
+    if (rx_queue == NULL)
+    {
+        return 0;
+    }
+
+    unsigned tail = rx_queue_tail.load(std::memory_order_relaxed);
+    unsigned head = rx_queue_head.load(std::memory_order_acquire);
+
+    if (head == tail && timeout_ms != 0 && rx_thread_running)
+    {
+        // announce the wait before the last look at the queue,
+        // the receive thread only signals a consumer that waits
+        rx_consumer_waiting.store(true);
+        if (rx_queue_head.load() == tail && rx_thread_running)
+        {
+            struct pollfd pfd;
+            pfd.fd = rx_ready_fd;
+            pfd.events = POLLIN;
+            poll(&pfd, 1, timeout_ms);
+
+            uint64_t value;
+            while (read(rx_ready_fd, &value, sizeof(value)) > 0)
+            {
+            }
+        }
+        rx_consumer_waiting.store(false);
+
+        head = rx_queue_head.load(std::memory_order_acquire);
+    }
+
+    int count = head - tail;
+    if (count > max_messages)
+    {
+        count = max_messages;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        messages[i] = rx_queue[(tail + i) & rx_queue_mask];
+    }
+
+    rx_queue_tail.store(tail + count, std::memory_order_release);
+
+    return count;
+}
+
+/**
+ * @brief Цикл потока приема.
+ */
+void Generic_Port::_rx_loop()
+{
+    struct pollfd fds[2];
+    fds[1].fd = rx_wake_fd;
+    fds[1].events = POLLIN;
+
+    while (rx_thread_running)
+    {
+        // sleep in poll() rather than in the port, so stop_rx_thread() can wake the thread
+        int fd = get_fd();
+        if (fd >= 0 && rx_pending() == 0)
+        {
+            fds[0].fd = fd;
+            fds[0].events = POLLIN;
+            if (poll(fds, 2, -1) < 0 && errno != EINTR)
+            {
+                rx_error = errno;
+                fprintf(stderr, "ERROR: Could not wait for port data, errno = %d : %m\n", errno);
+                break;
+            }
+            if (!rx_thread_running)
+            {
+                break;
+            }
+            if (!(fds[0].revents & (POLLIN | POLLERR | POLLHUP)))
+            {
+                continue;
+            }
+        }
+
+        unsigned head = rx_queue_head.load(std::memory_order_relaxed);
+        unsigned tail = rx_queue_tail.load(std::memory_order_acquire);
+        unsigned space = rx_queue_mask + 1 - (head - tail);
+
+        // messages are parsed straight into the queue; a full queue still drains
+        // the port so the kernel buffer does not overrun, the messages are counted and dropped
+        mavlink_message_t *target = rx_overflow_batch;
+        unsigned request = RX_THREAD_BATCH;
+        if (space > 0)
+        {
+            unsigned index = head & rx_queue_mask;
+            target = &rx_queue[index];
+            request = rx_queue_mask + 1 - index;
+            if (request > space)
+            {
+                request = space;
+            }
+            if (request > (unsigned)RX_THREAD_BATCH)
+            {
+                request = RX_THREAD_BATCH;
+            }
+        }
+
+        int n = read_messages(target, request);
+        if (n < 0)
+        {
+            // a signal is not a failure of the port, anything else is already reported by it
+            int error = errno;
+            if (error == EINTR || error == EAGAIN)
+            {
+                continue;
+            }
+            rx_error = error != 0 ? error : EIO;
+            break;
+        }
+
+        if (target == rx_overflow_batch)
+        {
+            rx_overflows.fetch_add(n, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (n > 0)
+        {
+            rx_queue_head.store(head + n);
+            if (rx_consumer_waiting.load())
+            {
+                uint64_t value = 1;
+                if (write(rx_ready_fd, &value, sizeof(value)) < 0)
+                {
+                    fprintf(stderr, "WARNING: Could not wake up rx consumer\n");
+                }
+            }
+        }
+    }
+
+    // a consumer waiting for messages that will not come returns right away
+    rx_thread_running = false;
+    uint64_t value = 1;
+    if (write(rx_ready_fd, &value, sizeof(value)) < 0)
+    {
+        fprintf(stderr, "WARNING: Could not wake up rx consumer\n");
+    }
+}
+
+/**
+ * @brief Точка входа потока приема.
+ * 
+ * @param args Указатель на объект Generic_Port.
+ * @return void* Всегда NULL.
+ */
+void *Generic_Port::_start_rx_thread(void *args)
+{
+    Generic_Port *port = (Generic_Port *)args;
+    port->_rx_loop();
+    return NULL;
+}
+
+/**
+ * @brief Сериализует полезную нагрузку прямо в кадр передачи.
+ * 
+ * @param system_id Идентификатор системы отправителя.
+ * @param component_id Идентификатор компонента отправителя.
+ * @param msgid Идентификатор сообщения.
+ * @param payload Полезная нагрузка в порядке полей на линии.
+ * @param len Длина полезной нагрузки, равная полной длине сообщения.
+ * @return int Результат как у write_message() или -1, если сообщения нет в диалекте или
+ * длина не совпадает.
+ */
+int Generic_Port::write_payload(uint8_t system_id, uint8_t component_id, uint32_t msgid, const void *payload, unsigned len)
+{
+    const mavlink_msg_entry_t *entry = Message_Entries::find(msgid);
+    if (entry == NULL)
+    {
+        fprintf(stderr, "ERROR: message #%u is not in the dialect\n", msgid);
+        return -1;
+    }
+
+    // a struct of another dialect version would put its fields at the wrong offsets
+    if (len != entry->max_msg_len)
+    {
+        fprintf(stderr, "ERROR: message #%u is %u bytes long, not %u\n", msgid, entry->max_msg_len, len);
+        return -1;
+    }
+
+    Tx_Frame frame;
+    frame.system_id = system_id;
+    frame.component_id = component_id;
+    frame.msgid = msgid;
+    frame.crc_extra = entry->crc_extra;
+    frame.payload = (const uint8_t *)payload;
+    frame.payload_len = len;
+
+    // MAVLink 2 trims trailing zeros of the payload, one byte always stays
+    while (frame.payload_len > 1 && frame.payload[frame.payload_len - 1] == 0)
+    {
+        frame.payload_len--;
+    }
+
+    return _write_frame(frame);
+}
+
+/**
+ * @brief Записывает кадр write_payload() через временный буфер.
+ * 
+ * @param frame Кадр.
+ * @return int Результат как у write_raw().
+ */
+int Generic_Port::_write_frame(const Tx_Frame &frame)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    _encode_frame(frame, buf);
+
+    return write_raw(buf, frame.length());
+}
+
+/**
+ * @brief Собирает кадр на линии и присваивает ему очередной номер.
+ * 
+ * @param frame Кадр.
+ * @param buf Буфер размером не меньше frame.length().
+ */
+void Generic_Port::_encode_frame(const Tx_Frame &frame, uint8_t *buf)
+{
+    buf[0] = MAVLINK_STX;
+    buf[1] = frame.payload_len;
+    buf[2] = 0;
+    buf[3] = 0;
+    buf[4] = tx_seq.fetch_add(1, std::memory_order_relaxed);
+    buf[5] = frame.system_id;
+    buf[6] = frame.component_id;
+    buf[7] = frame.msgid & 0xff;
+    buf[8] = (frame.msgid >> 8) & 0xff;
+    buf[9] = (frame.msgid >> 16) & 0xff;
+    memcpy(buf + MAVLINK_NUM_HEADER_BYTES, frame.payload, frame.payload_len);
+
+    uint16_t checksum = Mavlink_Crc::frame_checksum(buf, frame.payload_len, frame.crc_extra);
+    buf[MAVLINK_NUM_HEADER_BYTES + frame.payload_len] = checksum & 0xff;
+    buf[MAVLINK_NUM_HEADER_BYTES + frame.payload_len + 1] = checksum >> 8;
+}
+
+/**
+ * @brief Разбирает байты из буфера и извлекает из них сообщения Mavlink.
+ * 
+ * @param buf Буфер с принятыми данными.
+ * @param len Количество байт в буфере.
+ * @param pos Позиция первого неразобранного байта, сдвигается по мере разбора.
+ * @param messages Массив для найденных сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массива messages.
+ * @param rx_buffer Буфер собираемого сообщения отдельного соединения или NULL.
+ * @param rx_status Состояние разбора отдельного соединения или NULL.
+ * @return int Количество найденных сообщений.
+ */
+int Generic_Port::_parse_buffer(const uint8_t *buf, int len, int &pos, mavlink_message_t *messages, Raw_Frame *frames,
+                                int max_messages, mavlink_message_t *rx_buffer, mavlink_status_t *rx_status)
+{
+    // connections without their own state use the state of the port
+    if (!rx_buffer || !rx_status)
+    {
+        rx_buffer = &parse_buffer;
+        rx_status = &parse_status;
+    }
+
+    int count = 0;
+    int start = pos;
+    int frame_start = -1;
+    mavlink_status_t status = lastStatus;
+    uint16_t drop_count = lastStatus.packet_rx_drop_count;
+
+    while (pos < len && count < max_messages)
+    {
+        // between frames the byte parser would only discard noise, jump over it
+        if (resync_scan && rx_status->parse_state <= MAVLINK_PARSE_STATE_IDLE)
+        {
+            pos = _find_frame_start(buf, pos, len, rx_status);
+            status = *rx_status;
+            if (pos == len)
+            {
+                break;
+            }
+        }
+
+        uint8_t cp;
+        uint8_t msgReceived = 0;
+
+        // a whole frame in buf is checked and copied at once
+        int frame_len = 0;
+        if (rx_status->parse_state <= MAVLINK_PARSE_STATE_IDLE)
+        {
+            frame_len = _decode_frame(buf + pos, len - pos, &messages[count], rx_status, &status);
+        }
+
+        if (frame_len > 0)
+        {
+            frame_start = pos;
+            pos += frame_len;
+            cp = buf[pos - 1];
+            msgReceived = 1;
+        }
+        else
+        {
+            cp = buf[pos++];
+
+            // the parsing
+            msgReceived = _parse_char(rx_buffer, rx_status, cp, &messages[count], &status);
+
+            // the parser only sits in GOT_STX right after a start byte
+            if (rx_status->parse_state == MAVLINK_PARSE_STATE_GOT_STX)
+            {
+                frame_start = pos - 1;
+            }
+        }
+
+        if (msgReceived)
+        {
+            // a frame that started in an earlier chunk is not contiguous in buf
+            unsigned frame_len = _frame_length(messages[count]);
+            bool contiguous = frame_start >= 0 && (unsigned)(pos - frame_start) == frame_len;
+            const uint8_t *frame_data = contiguous ? buf + frame_start : NULL;
+            frame_start = -1;
+
+            if (frames)
+            {
+                frames[count].data = frame_data;
+                frames[count].len = frame_len;
+            }
+
+            _publish(messages[count], frame_data, frame_len);
+            if (debug)
+            {
+                printf("Received message with ID #%d (sys:%d|comp:%d)\n", messages[count].msgid, messages[count].sysid, messages[count].compid);
+            }
+            count++;
+        }
+
+        // check for dropped packets
+        if ((drop_count != status.packet_rx_drop_count) && debug)
+        {
+            printf("ERROR: DROPPED %d PACKETS\n", status.packet_rx_drop_count);
+            fprintf(stderr, "%02x ", cp);
+        }
+        drop_count = status.packet_rx_drop_count;
+    }
+
+    // keep the status of the last parsed byte, once per chunk
+    if (pos > start)
+    {
+        lastStatus = status;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Возвращает длину кадра сообщения на линии.
+ * 
+ * @param message Разобранное сообщение.
+ * @return unsigned Длина кадра, включая подпись.
+ */
+unsigned Generic_Port::_frame_length(const mavlink_message_t &message)
+{
+    if (message.magic == MAVLINK_STX_MAVLINK1)
+    {
+        return MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + message.len + MAVLINK_NUM_CHECKSUM_BYTES;
+    }
+
+    unsigned len = MAVLINK_NUM_NON_PAYLOAD_BYTES + message.len;
+    if (message.incompat_flags & MAVLINK_IFLAG_SIGNED)
+    {
+        len += MAVLINK_SIGNATURE_BLOCK_LEN;
+    }
+    return len;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/**
+ * @brief Ищет байт начала кадра командами AVX2.
+ * 
+ * @param buf Буфер.
+ * @param pos Позиция начала поиска.
+ * @param len Количество байт в буфере.
+ * @return int Позиция байта MAVLINK_STX или MAVLINK_STX_MAVLINK1 либо первая непроверенная позиция.
+ */
+__attribute__((target("avx2"))) static int scan_stx_avx2(const uint8_t *buf, int pos, int len)
+{
+    const __m256i stx = _mm256_set1_epi8((char)MAVLINK_STX);
+    const __m256i stx1 = _mm256_set1_epi8((char)MAVLINK_STX_MAVLINK1);
+
+    for (; pos + 32 <= len; pos += 32)
+    {
+        __m256i bytes = _mm256_loadu_si256((const __m256i *)(buf + pos));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, stx), _mm256_cmpeq_epi8(bytes, stx1)));
+        if (mask)
+        {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return pos;
+}
+#endif
+
+#ifdef __SSE2__
+/**
+ * @brief Ищет байт начала кадра командами SSE2.
+ * 
+ * @param buf Буфер.
+ * @param pos Позиция начала поиска.
+ * @param len Количество байт в буфере.
+ * @return int Позиция байта MAVLINK_STX или MAVLINK_STX_MAVLINK1 либо первая непроверенная позиция.
+ */
+static int scan_stx_sse2(const uint8_t *buf, int pos, int len)
+{
+    const __m128i stx = _mm_set1_epi8((char)MAVLINK_STX);
+    const __m128i stx1 = _mm_set1_epi8((char)MAVLINK_STX_MAVLINK1);
+
+    for (; pos + 16 <= len; pos += 16)
+    {
+        __m128i bytes = _mm_loadu_si128((const __m128i *)(buf + pos));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, stx), _mm_cmpeq_epi8(bytes, stx1)));
+        if (mask)
+        {
+            return pos + __builtin_ctz(mask);
+        }
+    }
+    return pos;
+}
+#endif
+
+/**
+ * @brief Ищет байт начала кадра.
+ * 
+ * Векторная часть выбирается по возможностям процессора, остаток короче вектора
+ * просматривается побайтно.
+ * 
+ * @param buf Буфер.
+ * @param pos Позиция начала поиска.
+ * @param len Количество байт в буфере.
+ * @return int Позиция байта MAVLINK_STX или MAVLINK_STX_MAVLINK1 либо len.
+ */
+static int scan_stx(const uint8_t *buf, int pos, int len)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    if (has_avx2)
+    {
+        pos = scan_stx_avx2(buf, pos, len);
+    }
+#endif
+#ifdef __SSE2__
+    pos = scan_stx_sse2(buf, pos, len);
+#endif
+
+    for (; pos < len; pos++)
+    {
+        if (buf[pos] == MAVLINK_STX || buf[pos] == MAVLINK_STX_MAVLINK1)
+        {
+            break;
+        }
+    }
+    return pos;
+}
+
+/**
+ * @brief Ищет следующее правдоподобное начало кадра.
+ * 
+ * @param buf Буфер с принятыми данными.
+ * @param pos Позиция начала поиска.
+ * @param len Количество байт в буфере.
+ * @param rx_status Состояние разбора, в котором учитываются отброшенные кандидаты.
+ * @return int Позиция кандидата или len, если его нет.
+ */
+int Generic_Port::_find_frame_start(const uint8_t *buf, int pos, int len, mavlink_status_t *rx_status)
+{
+    while ((pos = scan_stx(buf, pos, len)) < len)
+    {
+        const uint8_t *header = buf + pos;
+        int avail = len - pos;
+
+        uint32_t msgid;
+        if (header[0] == MAVLINK_STX)
+        {
+            if (avail < MAVLINK_NUM_HEADER_BYTES)
+            {
+                return pos;
+            }
+            msgid = header[7] | ((uint32_t)header[8] << 8) | ((uint32_t)header[9] << 16);
+
+            // the byte parser rejects these flags as well, but only after the start byte
+            if (header[2] & ~MAVLINK_IFLAG_MASK)
+            {
+                rx_status->parse_error++;
+                pos++;
+                continue;
+            }
+        }
+        else
+        {
+            if (avail < MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1)
+            {
+                return pos;
+            }
+            msgid = header[5];
+        }
+
+        // a frame of an unknown message never passes the checksum, a longer one may carry
+        // extension fields of a newer dialect and goes to the byte parser
+        if (Message_Entries::find(msgid))
+        {
+            return pos;
+        }
+
+        rx_status->parse_error++;
+        pos++;
+    }
+    return len;
+}
+
+/**
+ * @brief Разбирает кадр MAVLink 2, целиком находящийся в буфере, за один шаг.
+ * 
+ * @param frame Байт начала кадра в буфере.
+ * @param avail Количество байт от frame до конца буфера.
+ * @param message Сообщение, в которое копируется кадр.
+ * @param rx_status Состояние разбора в ожидании начала кадра.
+ * @param status Копия состояния разбора после кадра.
+ * @return int Длина разобранного кадра или 0.
+ */
+int Generic_Port::_decode_frame(const uint8_t *frame, int avail, mavlink_message_t *message, mavlink_status_t *rx_status,
+                                mavlink_status_t *status)
+{
+    if (avail < MAVLINK_NUM_NON_PAYLOAD_BYTES || frame[0] != MAVLINK_STX || frame[2] != 0)
+    {
+        return 0;
+    }
+
+    unsigned payload_len = frame[1];
+    int frame_len = MAVLINK_NUM_NON_PAYLOAD_BYTES + payload_len;
+    if (avail < frame_len)
+    {
+        return 0;
+    }
+
+    uint32_t msgid = frame[7] | ((uint32_t)frame[8] << 8) | ((uint32_t)frame[9] << 16);
+    const mavlink_msg_entry_t *entry = Message_Entries::find(msgid);
+    if (entry == NULL || payload_len > entry->max_msg_len)
+    {
+        return 0;
+    }
+
+    const uint8_t *ck = frame + MAVLINK_NUM_HEADER_BYTES + payload_len;
+    uint16_t checksum = Mavlink_Crc::frame_checksum(frame, payload_len, entry->crc_extra);
+    if (ck[0] != (checksum & 0xff) || ck[1] != (checksum >> 8))
+    {
+        return 0;
+    }
+
+    message->magic = MAVLINK_STX;
+    message->len = payload_len;
+    message->incompat_flags = 0;
+    message->compat_flags = frame[3];
+    message->seq = frame[4];
+    message->sysid = frame[5];
+    message->compid = frame[6];
+    message->msgid = msgid;
+    message->checksum = checksum;
+    message->ck[0] = ck[0];
+    message->ck[1] = ck[1];
+
+    // truncated trailing zeros are restored like the byte parser does
+    uint8_t *payload = (uint8_t *)_MAV_PAYLOAD_NON_CONST(message);
+    memcpy(payload, frame + MAVLINK_NUM_HEADER_BYTES, payload_len);
+    memset(payload + payload_len, 0, entry->max_msg_len - payload_len);
+
+    // the same bookkeeping as mavlink_frame_char_buffer() on the last byte of a frame
+    rx_status->msg_received = MAVLINK_FRAMING_OK;
+    rx_status->parse_state = MAVLINK_PARSE_STATE_IDLE;
+    rx_status->current_rx_seq = message->seq;
+    if (rx_status->packet_rx_success_count == 0)
+    {
+        rx_status->packet_rx_drop_count = 0;
+    }
+    rx_status->packet_rx_success_count++;
+
+    status->msg_received = MAVLINK_FRAMING_OK;
+    status->parse_state = MAVLINK_PARSE_STATE_IDLE;
+    status->current_rx_seq = rx_status->current_rx_seq + 1;
+    status->packet_rx_success_count = rx_status->packet_rx_success_count;
+    status->packet_rx_drop_count = rx_status->parse_error;
+    status->flags = rx_status->flags;
+    rx_status->parse_error = 0;
+
+    return frame_len;
+}
+
+/**
+ * @brief Разбирает один байт с собственным состоянием разбора.
+ * 
+ * @param rx_buffer Буфер собираемого сообщения.
+ * @param rx_status Состояние разбора.
+ * @param c Очередной байт.
+ * @param message Сообщение, в которое копируется собранный кадр.
+ * @param status Копия состояния разбора после байта.
+ * @return uint8_t 1 если сообщение собрано и контрольная сумма верна, иначе 0.
+ */
+uint8_t Generic_Port::_parse_char(mavlink_message_t *rx_buffer, mavlink_status_t *rx_status, uint8_t c,
+                                  mavlink_message_t *message, mavlink_status_t *status)
+{
+    uint8_t msgReceived = mavlink_frame_char_buffer(rx_buffer, rx_status, c, message, status);
+
+    // same recovery as mavlink_parse_char(): a bad frame is a parse error,
+    // and its last byte may already start the next frame
+    if (msgReceived == MAVLINK_FRAMING_BAD_CRC || msgReceived == MAVLINK_FRAMING_BAD_SIGNATURE)
+    {
+        rx_status->parse_error++;
+        rx_status->msg_received = MAVLINK_FRAMING_INCOMPLETE;
+        rx_status->parse_state = MAVLINK_PARSE_STATE_IDLE;
+        if (c == MAVLINK_STX)
+        {
+            rx_status->parse_state = MAVLINK_PARSE_STATE_GOT_STX;
+            rx_buffer->len = 0;
+            mavlink_start_checksum(rx_buffer);
+        }
+        return 0;
+    }
+
+    return msgReceived;
+}
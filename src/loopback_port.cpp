@@ -0,0 +1,415 @@
+#include "loopback_port.h"
+
+/**
+ * @brief Конструктор класса Loopback_Port.
+ *
+ * @param capacity Емкость кольца приема, байт.
+ */
+Loopback_Port::Loopback_Port(int capacity)
+{
+    size_t size = MIN_CAPACITY;
+    while ((int)size < capacity)
+    {
+        size <<= 1;
+    }
+
+    peer = NULL;
+    is_open = false;
+    tx_overflows = 0;
+
+    rx_ring = new uint8_t[size];
+    rx_mask = size - 1;
+    rx_head = 0;
+    rx_tail = 0;
+    rx_read = 0;
+    rx_waitable = false;
+    rx_signalled = false;
+
+    rx_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (rx_event_fd < 0)
+    {
+        printf("\n eventfd init failed\n");
+        throw 1;
+    }
+
+    int result = pthread_mutex_init(&lock, NULL);
+    if (result == 0)
+    {
+        result = pthread_mutex_init(&rx_write_lock, NULL);
+    }
+    if (result != 0)
+    {
+        printf("\n mutex init failed\n");
+        throw 1;
+    }
+}
+
+/**
+ * @brief Деструктор класса Loopback_Port.
+ *
+ * Отсоединяет второй порт пары, который после этого не может передавать.
+ */
+Loopback_Port::~Loopback_Port()
+{
+    stop_rx_thread();
+
+    if (peer && peer != this)
+    {
+        peer->peer = NULL;
+    }
+
+    pthread_mutex_destroy(&lock);
+    pthread_mutex_destroy(&rx_write_lock);
+    close(rx_event_fd);
+    delete[] rx_ring;
+}
+
+/**
+ * @brief Соединяет порт с другим портом в обоих направлениях.
+ *
+ * @param peer_ Второй порт пары.
+ */
+void Loopback_Port::connect(Loopback_Port *peer_)
+{
+    peer = peer_;
+    peer_->peer = this;
+}
+
+/**
+ * @brief Читает одно сообщение.
+ *
+ * @param message Сообщение.
+ * @return int 1 если сообщение прочитано, 0 если его нет, -1 если порт не запущен.
+ */
+int Loopback_Port::read_message(mavlink_message_t &message)
+{
+    return read_messages(&message, 1);
+}
+
+/**
+ * @brief Читает сообщения, переданные вторым портом пары.
+ *
+ * @param messages Массив для сообщений.
+ * @param max_messages Размер массива messages.
+ * @return int Количество сообщений или -1, если порт не запущен.
+ */
+int Loopback_Port::read_messages(mavlink_message_t *messages, int max_messages)
+{
+    return read_messages(messages, NULL, max_messages);
+}
+
+/**
+ * @brief Читает сообщения вместе с их исходными байтами в кольце приема.
+ *
+ * @param messages Массив для сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массивов.
+ * @return int Количество сообщений или -1, если порт не запущен.
+ */
+int Loopback_Port::read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    int count = 0;
+
+    // Lock
+    pthread_mutex_lock(&lock);
+
+    if (!is_open)
+    {
+        pthread_mutex_unlock(&lock);
+        fprintf(stderr, "ERROR: Could not read from stopped loopback port\n");
+        return -1;
+    }
+
+    // views of the previous read are gone by now, their bytes go back to the writers
+    rx_tail.store(rx_read, std::memory_order_release);
+
+    // the flag is set only after the eventfd is written, so without it there is nothing to drain;
+    // once it is cleared, either a writer sees that and signals again or its bytes are seen below
+    if (rx_signalled.load(std::memory_order_acquire))
+    {
+        uint64_t value;
+        if (read(rx_event_fd, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        {
+            fprintf(stderr, "WARNING: Could not read loopback port signal\n");
+        }
+        rx_signalled.store(false, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    size_t head = rx_head.load(std::memory_order_acquire);
+    while (count < max_messages && rx_read != head)
+    {
+        // frames are parsed in place, a frame across the end of the ring goes through the byte parser
+        size_t index = rx_read & rx_mask;
+        size_t len = head - rx_read;
+        if (len > rx_mask + 1 - index)
+        {
+            len = rx_mask + 1 - index;
+        }
+
+        int pos = 0;
+        count += _parse_buffer(rx_ring + index, (int)len, pos, messages + count, frames ? frames + count : NULL,
+                               max_messages - count);
+        rx_read += pos;
+    }
+
+    // Unlock
+    pthread_mutex_unlock(&lock);
+
+    return count;
+}
+
+/**
+ * @brief Передает сообщение второму порту пары.
+ *
+ * @param message Сообщение.
+ * @return int Длина кадра, 0 если в кольце получателя нет места, -1 если порт не запущен.
+ */
+int Loopback_Port::write_message(const mavlink_message_t &message)
+{
+    Loopback_Port *target = peer;
+    if (!is_open || target == NULL)
+    {
+        return -1;
+    }
+
+    unsigned len = _frame_length(message);
+
+    pthread_mutex_lock(&target->rx_write_lock);
+
+    uint8_t *frame = target->_reserve(len);
+    if (frame)
+    {
+        mavlink_msg_to_send_buffer(frame, &message);
+        target->_commit(frame, len);
+    }
+
+    pthread_mutex_unlock(&target->rx_write_lock);
+
+    if (frame == NULL)
+    {
+        tx_overflows.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    return len;
+}
+
+/**
+ * @brief Передает готовые кадры второму порту пары.
+ *
+ * @param buf Байты кадров.
+ * @param len Длина данных.
+ * @return int len, 0 если в кольце получателя нет места, -1 если порт не запущен.
+ */
+int Loopback_Port::write_raw(const uint8_t *buf, unsigned len)
+{
+    Loopback_Port *target = peer;
+    if (!is_open || target == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&target->rx_write_lock);
+
+    size_t head = target->rx_head.load(std::memory_order_relaxed);
+    size_t tail = target->rx_tail.load(std::memory_order_acquire);
+    bool fits = target->rx_mask + 1 - (head - tail) >= len;
+    if (fits)
+    {
+        size_t index = head & target->rx_mask;
+        size_t first = target->rx_mask + 1 - index;
+        if (first > len)
+        {
+            first = len;
+        }
+        memcpy(target->rx_ring + index, buf, first);
+        memcpy(target->rx_ring, buf + first, len - first);
+        target->rx_head.store(head + len, std::memory_order_release);
+        target->_signal();
+    }
+
+    pthread_mutex_unlock(&target->rx_write_lock);
+
+    if (!fits)
+    {
+        tx_overflows.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    return len;
+}
+
+/**
+ * @brief Возвращает eventfd, сигнализирующий о переданных вторым портом байтах.
+ *
+ * @return int Дескриптор.
+ */
+int Loopback_Port::get_fd()
+{
+    // writers start signalling only now, bytes that came before are signalled at once
+    if (!rx_waitable.load(std::memory_order_acquire))
+    {
+        pthread_mutex_lock(&rx_write_lock);
+        rx_waitable.store(true, std::memory_order_release);
+        _signal();
+        pthread_mutex_unlock(&rx_write_lock);
+    }
+
+    return rx_event_fd;
+}
+
+/**
+ * @brief Возвращает количество принятых, но еще не разобранных байт.
+ *
+ * @return int Количество байт.
+ */
+int Loopback_Port::rx_pending()
+{
+    return (int)(rx_head.load(std::memory_order_acquire) - rx_read);
+}
+
+/**
+ * @brief Запускает порт.
+ */
+void Loopback_Port::start()
+{
+    pthread_mutex_lock(&lock);
+
+    // whatever the peer sent while the port was stopped is dropped
+    pthread_mutex_lock(&rx_write_lock);
+    rx_read = rx_head.load(std::memory_order_relaxed);
+    rx_tail.store(rx_read, std::memory_order_relaxed);
+    uint64_t value;
+    while (read(rx_event_fd, &value, sizeof(value)) > 0)
+    {
+    }
+    rx_signalled = false;
+    pthread_mutex_unlock(&rx_write_lock);
+
+    lastStatus.packet_rx_drop_count = 0;
+    _reset_parser();
+    is_open = true;
+
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Останавливает порт.
+ */
+void Loopback_Port::stop()
+{
+    // the RX thread reads through this port, it has to end first
+    stop_rx_thread();
+
+    pthread_mutex_lock(&lock);
+    is_open = false;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Собирает кадр write_payload() прямо в кольце получателя.
+ *
+ * @param frame Кадр.
+ * @return int Результат как у write_raw().
+ */
+int Loopback_Port::_write_frame(const Tx_Frame &frame)
+{
+    Loopback_Port *target = peer;
+    if (!is_open || target == NULL)
+    {
+        return -1;
+    }
+
+    unsigned len = frame.length();
+
+    pthread_mutex_lock(&target->rx_write_lock);
+
+    uint8_t *buf = target->_reserve(len);
+    if (buf)
+    {
+        _encode_frame(frame, buf);
+        target->_commit(buf, len);
+    }
+
+    pthread_mutex_unlock(&target->rx_write_lock);
+
+    if (buf == NULL)
+    {
+        tx_overflows.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+    return len;
+}
+
+/**
+ * @brief Выделяет место для кадра в кольце приема.
+ *
+ * @param len Длина кадра, не больше MAVLINK_MAX_PACKET_LEN.
+ * @return uint8_t* Место в кольце, rx_scratch или NULL, если в кольце нет места.
+ */
+uint8_t *Loopback_Port::_reserve(unsigned len)
+{
+    size_t head = rx_head.load(std::memory_order_relaxed);
+    size_t tail = rx_tail.load(std::memory_order_acquire);
+    if (rx_mask + 1 - (head - tail) < len)
+    {
+        return NULL;
+    }
+
+    size_t index = head & rx_mask;
+    if (index + len > rx_mask + 1)
+    {
+        return rx_scratch;
+    }
+    return rx_ring + index;
+}
+
+/**
+ * @brief Публикует кадр, собранный в месте, выделенном _reserve().
+ *
+ * @param frame Место кадра.
+ * @param len Длина кадра.
+ */
+void Loopback_Port::_commit(const uint8_t *frame, unsigned len)
+{
+    size_t head = rx_head.load(std::memory_order_relaxed);
+
+    // a frame across the end of the ring was put together aside
+    if (frame == rx_scratch)
+    {
+        size_t index = head & rx_mask;
+        size_t first = rx_mask + 1 - index;
+        memcpy(rx_ring + index, rx_scratch, first);
+        memcpy(rx_ring, rx_scratch + first, len - first);
+    }
+
+    rx_head.store(head + len, std::memory_order_release);
+    _signal();
+}
+
+/**
+ * @brief Сообщает получателю о новых байтах, если его дескриптор ожидается.
+ */
+void Loopback_Port::_signal()
+{
+    // nobody waits on the descriptor, the plain read/write path stays without syscalls
+    if (!rx_waitable.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    // pairs with the fence of read_messages(): either the flag is seen clear or rx_head is seen there
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    // one signal until the receiver reads, it then sees everything published before
+    if (rx_signalled.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+
+    uint64_t value = 1;
+    if (write(rx_event_fd, &value, sizeof(value)) < 0)
+    {
+        fprintf(stderr, "WARNING: Could not signal loopback port\n");
+    }
+    rx_signalled.store(true, std::memory_order_release);
+}
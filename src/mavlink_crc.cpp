@@ -0,0 +1,85 @@
+#include "mavlink_crc.h"
+
+/**
+ * @brief Таблицы slice-by-8.
+ *
+ * table[0] - сдвиг суммы на один байт, table[k] - на k + 1 байт, по которым
+ * обрабатывается байт, отстоящий от конца восьмерки на k позиций.
+ */
+struct Crc_Tables
+{
+    uint16_t table[8][256];
+};
+
+/**
+ * @brief Строит таблицы для отраженного полинома 0x1021.
+ *
+ * @return Crc_Tables Таблицы.
+ */
+static constexpr Crc_Tables make_tables()
+{
+    Crc_Tables tables = {};
+    for (unsigned i = 0; i < 256; i++)
+    {
+        uint16_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+        }
+        tables.table[0][i] = crc;
+    }
+    for (unsigned i = 0; i < 256; i++)
+    {
+        for (int k = 1; k < 8; k++)
+        {
+            uint16_t crc = tables.table[k - 1][i];
+            tables.table[k][i] = (crc >> 8) ^ tables.table[0][crc & 0xff];
+        }
+    }
+    return tables;
+}
+
+static constexpr Crc_Tables crc_tables = make_tables();
+
+/**
+ * @brief Добавляет байты к контрольной сумме.
+ *
+ * @param buf Байты.
+ * @param len Количество байт.
+ * @param crc Накопленная контрольная сумма, X25_INIT_CRC для первого вызова.
+ * @return uint16_t Новая контрольная сумма.
+ */
+uint16_t Mavlink_Crc::accumulate(const uint8_t *buf, unsigned len, uint16_t crc)
+{
+    const uint16_t(*t)[256] = crc_tables.table;
+
+    // the 16-bit sum folds into the first two bytes of every eight
+    while (len >= 8)
+    {
+        crc = t[7][(buf[0] ^ crc) & 0xff] ^ t[6][(buf[1] ^ (crc >> 8)) & 0xff] ^ t[5][buf[2]] ^ t[4][buf[3]] ^
+              t[3][buf[4]] ^ t[2][buf[5]] ^ t[1][buf[6]] ^ t[0][buf[7]];
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len--)
+    {
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xff];
+    }
+    return crc;
+}
+
+/**
+ * @brief Вычисляет контрольную сумму кадра на линии.
+ *
+ * @param frame Кадр MAVLink 1 или MAVLink 2, начиная с байта начала кадра.
+ * @param payload_len Длина полезной нагрузки.
+ * @param crc_extra CRC_EXTRA сообщения.
+ * @return uint16_t Контрольная сумма.
+ */
+uint16_t Mavlink_Crc::frame_checksum(const uint8_t *frame, unsigned payload_len, uint8_t crc_extra)
+{
+    unsigned header_len = frame[0] == MAVLINK_STX ? MAVLINK_CORE_HEADER_LEN : MAVLINK_CORE_HEADER_MAVLINK1_LEN;
+    uint16_t crc = accumulate(frame + 1, header_len + payload_len);
+    return accumulate(&crc_extra, 1, crc);
+}
@@ -0,0 +1,194 @@
+#include "message_arena.h"
+
+// most frames are under 64 bytes, the last class holds any frame
+const unsigned Message_Arena::CAPACITIES[SIZE_CLASSES] = {32, 64, 128, MAVLINK_MAX_PACKET_LEN};
+
+/**
+ * @brief Конструктор класса Message_Arena.
+ */
+Message_Arena::Message_Arena()
+{
+    for (int i = 0; i < SIZE_CLASSES; i++)
+    {
+        lists[i].head = NULL;
+        lists[i].frames = 0;
+        lists[i].free_frames = 0;
+        if (pthread_mutex_init(&lists[i].lock, NULL) != 0)
+        {
+            printf("\n mutex init failed\n");
+            throw 1;
+        }
+    }
+}
+
+/**
+ * @brief Деструктор класса Message_Arena.
+ */
+Message_Arena::~Message_Arena()
+{
+    for (int i = 0; i < SIZE_CLASSES; i++)
+    {
+        for (size_t j = 0; j < lists[i].slabs.size(); j++)
+        {
+            delete[] lists[i].slabs[j];
+        }
+        pthread_mutex_destroy(&lists[i].lock);
+    }
+}
+
+/**
+ * @brief Выделяет кадр.
+ *
+ * @param len Длина кадра, не больше MAVLINK_MAX_PACKET_LEN.
+ * @return Pooled_Frame* Кадр с одним владельцем или NULL, если длина слишком велика.
+ */
+Pooled_Frame *Message_Arena::allocate(unsigned len)
+{
+    int size_class = 0;
+    while (size_class < SIZE_CLASSES && CAPACITIES[size_class] < len)
+    {
+        size_class++;
+    }
+    if (size_class == SIZE_CLASSES)
+    {
+        fprintf(stderr, "ERROR: frame of %u bytes does not fit the arena\n", len);
+        return NULL;
+    }
+
+    Free_List &list = lists[size_class];
+    pthread_mutex_lock(&list.lock);
+
+    if (list.head == NULL)
+    {
+        _grow(size_class);
+    }
+
+    Pooled_Frame *frame = list.head;
+    list.head = frame->next;
+    list.free_frames--;
+
+    pthread_mutex_unlock(&list.lock);
+
+    frame->next = NULL;
+    frame->references.store(1, std::memory_order_relaxed);
+    frame->len = len;
+    frame->size_class = size_class;
+    return frame;
+}
+
+/**
+ * @brief Копирует кадр в пул.
+ *
+ * @param frame Байты кадра.
+ * @param len Длина кадра.
+ * @return Pooled_Frame* Кадр с одним владельцем или NULL.
+ */
+Pooled_Frame *Message_Arena::copy(const uint8_t *frame, unsigned len)
+{
+    Pooled_Frame *pooled = allocate(len);
+    if (pooled)
+    {
+        memcpy(pooled->data(), frame, len);
+    }
+    return pooled;
+}
+
+/**
+ * @brief Сериализует сообщение в кадр пула.
+ *
+ * @param message Сообщение.
+ * @return Pooled_Frame* Кадр с одним владельцем.
+ */
+Pooled_Frame *Message_Arena::encode(const mavlink_message_t &message)
+{
+    unsigned len = mavlink_msg_get_send_buffer_length(&message);
+    if (message.magic == MAVLINK_STX && (message.incompat_flags & MAVLINK_IFLAG_SIGNED))
+    {
+        len += MAVLINK_SIGNATURE_BLOCK_LEN;
+    }
+
+    // the length is an upper bound, the frame is sized exactly after serializing
+    Pooled_Frame *frame = allocate(len);
+    if (frame)
+    {
+        frame->len = mavlink_msg_to_send_buffer(frame->data(), &message);
+    }
+    return frame;
+}
+
+/**
+ * @brief Освобождает кадр. Блок возвращается в пул после освобождения последним владельцем.
+ *
+ * @param frame Кадр или NULL.
+ */
+void Message_Arena::release(Pooled_Frame *frame)
+{
+    if (frame == NULL || frame->references.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    Free_List &list = lists[frame->size_class];
+    pthread_mutex_lock(&list.lock);
+    frame->next = list.head;
+    list.head = frame;
+    list.free_frames++;
+    pthread_mutex_unlock(&list.lock);
+}
+
+/**
+ * @brief Возвращает статистику пула.
+ *
+ * @return Stats Статистика.
+ */
+Message_Arena::Stats Message_Arena::get_stats()
+{
+    Stats stats;
+    memset(&stats, 0, sizeof(stats));
+
+    for (int i = 0; i < SIZE_CLASSES; i++)
+    {
+        pthread_mutex_lock(&lists[i].lock);
+        stats.frames += lists[i].frames;
+        stats.free_frames += lists[i].free_frames;
+        stats.bytes += lists[i].frames * _block_size(i);
+        pthread_mutex_unlock(&lists[i].lock);
+    }
+    return stats;
+}
+
+/**
+ * @brief Возвращает размер блока класса вместе с заголовком.
+ *
+ * @param size_class Класс размера.
+ * @return unsigned Размер, кратный выравниванию заголовка.
+ */
+unsigned Message_Arena::_block_size(int size_class)
+{
+    unsigned align = alignof(Pooled_Frame);
+    return (sizeof(Pooled_Frame) + CAPACITIES[size_class] + align - 1) / align * align;
+}
+
+/**
+ * @brief Выделяет очередную пачку блоков класса. Вызывается под блокировкой списка.
+ *
+ * @param size_class Класс размера.
+ */
+void Message_Arena::_grow(int size_class)
+{
+    Free_List &list = lists[size_class];
+    unsigned block_size = _block_size(size_class);
+
+    // new[] of bytes is aligned for any fundamental type, blocks keep that alignment
+    uint8_t *slab = new uint8_t[(size_t)block_size * SLAB_FRAMES];
+    list.slabs.push_back(slab);
+
+    for (int i = SLAB_FRAMES - 1; i >= 0; i--)
+    {
+        Pooled_Frame *frame = new (slab + (size_t)i * block_size) Pooled_Frame;
+        frame->next = list.head;
+        list.head = frame;
+    }
+    list.frames += SLAB_FRAMES;
+    list.free_frames += SLAB_FRAMES;
+}
@@ -0,0 +1,108 @@
+#include "message_dispatcher.h"
+
+/**
+ * @brief Конструктор класса Message_Dispatcher.
+ */
+Message_Dispatcher::Message_Dispatcher()
+{
+}
+
+/**
+ * @brief Устанавливает обработчик сообщений с указанным msgid.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @param handler Обработчик, заменяющий предыдущий, или пустой объект.
+ */
+void Message_Dispatcher::set_handler(uint32_t msgid, Handler handler)
+{
+    if (msgid < COMMON_IDS)
+    {
+        common[msgid] = handler;
+    }
+    else if (handler)
+    {
+        extended[msgid] = handler;
+    }
+    else
+    {
+        extended.erase(msgid);
+    }
+}
+
+/**
+ * @brief Удаляет обработчик сообщений с указанным msgid.
+ *
+ * @param msgid Идентификатор сообщения.
+ */
+void Message_Dispatcher::remove_handler(uint32_t msgid)
+{
+    set_handler(msgid, Handler());
+}
+
+/**
+ * @brief Устанавливает обработчик сообщений, для которых нет своего обработчика.
+ *
+ * @param handler Обработчик или пустой объект.
+ */
+void Message_Dispatcher::set_default_handler(Handler handler)
+{
+    default_handler = handler;
+}
+
+/**
+ * @brief Передает обработчику кадр, например из read_views() или Message_Arena.
+ *
+ * @param view Представление кадра.
+ * @return true если сообщение передано обработчику его msgid.
+ */
+bool Message_Dispatcher::dispatch(const Frame_View &view)
+{
+    uint32_t msgid = view.msgid();
+    const Handler *handler = msgid < COMMON_IDS ? &common[msgid] : _find_extended(msgid);
+
+    if ((handler == NULL || !*handler) && !default_handler)
+    {
+        return false;
+    }
+
+    view.to_message(view_message);
+    return dispatch(view_message);
+}
+
+/**
+ * @brief Передает обработчикам массив сообщений.
+ *
+ * @param messages Сообщения.
+ * @param count Количество сообщений.
+ * @return int Количество сообщений, переданных обработчикам их msgid.
+ */
+int Message_Dispatcher::dispatch(const mavlink_message_t *messages, int count)
+{
+    int handled = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (dispatch(messages[i]))
+        {
+            handled++;
+        }
+    }
+    return handled;
+}
+
+/**
+ * @brief Ищет обработчик msgid, не меньшего COMMON_IDS.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @return const Handler* Обработчик или NULL.
+ */
+const Message_Dispatcher::Handler *Message_Dispatcher::_find_extended(uint32_t msgid)
+{
+    // most programs register no extended ids, skip hashing then
+    if (extended.empty())
+    {
+        return NULL;
+    }
+
+    std::unordered_map<uint32_t, Handler>::const_iterator it = extended.find(msgid);
+    return it == extended.end() ? NULL : &it->second;
+}
@@ -0,0 +1,84 @@
+#include "message_entries.h"
+
+static constexpr mavlink_msg_entry_t entries[] = MAVLINK_MESSAGE_CRCS;
+static constexpr unsigned entry_count = sizeof(entries) / sizeof(entries[0]);
+
+/**
+ * @brief Вычисляет размер индексируемой таблицы.
+ *
+ * @return uint32_t Наибольший msgid диалекта плюс один, но не больше MAX_DIRECT_IDS.
+ */
+static constexpr uint32_t direct_ids()
+{
+    uint32_t count = 0;
+    for (unsigned i = 0; i < entry_count; i++)
+    {
+        if (entries[i].msgid < Message_Entries::MAX_DIRECT_IDS && entries[i].msgid >= count)
+        {
+            count = entries[i].msgid + 1;
+        }
+    }
+    return count;
+}
+
+static constexpr uint32_t direct_count = direct_ids();
+
+/**
+ * @brief Таблица номеров описаний по msgid.
+ */
+struct Entry_Index
+{
+    uint16_t slot[direct_count]; ///< Номер описания в entries плюс один или 0.
+};
+
+/**
+ * @brief Строит таблицу номеров описаний.
+ *
+ * @return Entry_Index Таблица.
+ */
+static constexpr Entry_Index make_index()
+{
+    Entry_Index index = {};
+    for (unsigned i = 0; i < entry_count; i++)
+    {
+        if (entries[i].msgid < direct_count)
+        {
+            index.slot[entries[i].msgid] = i + 1;
+        }
+    }
+    return index;
+}
+
+static constexpr Entry_Index entry_index = make_index();
+
+/**
+ * @brief Возвращает описание сообщения.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @return const mavlink_msg_entry_t* Описание или NULL, если сообщения нет в диалекте.
+ */
+const mavlink_msg_entry_t *Message_Entries::find(uint32_t msgid)
+{
+    if (msgid < direct_count)
+    {
+        uint16_t slot = entry_index.slot[msgid];
+        return slot ? &entries[slot - 1] : NULL;
+    }
+
+    // MAVLINK_MESSAGE_CRCS is sorted by msgid
+    unsigned low = 0;
+    unsigned high = entry_count;
+    while (low < high)
+    {
+        unsigned middle = (low + high) / 2;
+        if (entries[middle].msgid < msgid)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return low < entry_count && entries[low].msgid == msgid ? &entries[low] : NULL;
+}
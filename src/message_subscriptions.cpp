@@ -0,0 +1,360 @@
+#include "message_subscriptions.h"
+
+// std::chrono takes the timeouts by reference
+const int Message_Subscriptions::ACK_TIMEOUT_MS;
+const int Message_Subscriptions::LINK_TIMEOUT_MS;
+
+/**
+ * @brief Конструктор класса Message_Subscriptions.
+ *
+ * @param port_ Порт, через который идут команды.
+ * @param target_system_ Идентификатор системы автопилота.
+ * @param target_component_ Идентификатор компонента автопилота.
+ * @param system_id_ Идентификатор системы отправителя команд.
+ * @param component_id_ Идентификатор компонента отправителя команд.
+ */
+Message_Subscriptions::Message_Subscriptions(Generic_Port *port_, uint8_t target_system_, uint8_t target_component_,
+                                             uint8_t system_id_, uint8_t component_id_)
+{
+    port = port_;
+    target_system = target_system_;
+    target_component = target_component_;
+    system_id = system_id_;
+    component_id = component_id_;
+    inflight = -1;
+    link_up = false;
+}
+
+/**
+ * @brief Объявляет сообщение и частоту, с которой оно нужно.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @param rate_hz Частота, Гц.
+ * @return true если подписка добавлена.
+ */
+bool Message_Subscriptions::subscribe(uint32_t msgid, float rate_hz)
+{
+    if (rate_hz <= 0)
+    {
+        fprintf(stderr, "ERROR: invalid rate %f for message #%u\n", rate_hz, msgid);
+        return false;
+    }
+
+    int index = _find(msgid);
+    if (index < 0)
+    {
+        Subscription subscription = {};
+        subscription.msgid = msgid;
+        subscriptions.push_back(subscription);
+        index = subscriptions.size() - 1;
+    }
+    else if (inflight == index)
+    {
+        // the acknowledgement of the old rate must not confirm the new one
+        inflight = -1;
+    }
+
+    Subscription &subscription = subscriptions[index];
+    subscription.rate_hz = rate_hz;
+    subscription.state = STATE_PENDING;
+    subscription.attempts = 0;
+    subscription.measured_rate = 0;
+
+    return true;
+}
+
+/**
+ * @brief Отменяет подписку и возвращает сообщению частоту автопилота по умолчанию.
+ *
+ * @param msgid Идентификатор сообщения.
+ */
+void Message_Subscriptions::unsubscribe(uint32_t msgid)
+{
+    int index = _find(msgid);
+    if (index < 0)
+    {
+        return;
+    }
+
+    // interval 0 restores the default rate, which other consumers may rely on
+    if (link_up)
+    {
+        _send_command(MAV_CMD_SET_MESSAGE_INTERVAL, msgid, 0);
+    }
+
+    if (inflight == index)
+    {
+        inflight = -1;
+    }
+    else if (inflight > index)
+    {
+        inflight--;
+    }
+    subscriptions.erase(subscriptions.begin() + index);
+}
+
+/**
+ * @brief Учитывает принятое сообщение.
+ *
+ * @param message Сообщение.
+ */
+void Message_Subscriptions::handle_message(const mavlink_message_t &message)
+{
+    if (message.sysid != target_system)
+    {
+        return;
+    }
+
+    Clock::time_point now = Clock::now();
+
+    // heartbeats after a silence mean a reconnect, the vehicle may have forgotten the intervals
+    if (message.msgid == MAVLINK_MSG_ID_HEARTBEAT && message.compid == target_component)
+    {
+        last_heartbeat = now;
+        if (!link_up)
+        {
+            link_up = true;
+            inflight = -1;
+            for (size_t i = 0; i < subscriptions.size(); i++)
+            {
+                subscriptions[i].state = STATE_PENDING;
+                subscriptions[i].attempts = 0;
+            }
+        }
+    }
+
+    if (message.msgid == MAVLINK_MSG_ID_COMMAND_ACK && inflight >= 0)
+    {
+        mavlink_command_ack_t ack;
+        mavlink_msg_command_ack_decode(&message, &ack);
+
+        if (ack.command == MAV_CMD_SET_MESSAGE_INTERVAL && ack.result != MAV_RESULT_IN_PROGRESS)
+        {
+            int index = inflight;
+            inflight = -1;
+
+            if (ack.result == MAV_RESULT_ACCEPTED)
+            {
+                subscriptions[index].state = STATE_STREAMING;
+                _restart_window(subscriptions[index], now);
+            }
+            else
+            {
+                // a refusal will not change on retry
+                fprintf(stderr, "WARNING: interval of message #%u rejected, result %d\n", subscriptions[index].msgid, ack.result);
+                subscriptions[index].attempts = MAX_ATTEMPTS - 1;
+                _fail(index);
+            }
+        }
+    }
+
+    int index = _find(message.msgid);
+    if (index >= 0)
+    {
+        subscriptions[index].window_count++;
+    }
+}
+
+/**
+ * @brief Отправляет команды и проверяет частоты согласно прошедшему времени.
+ */
+void Message_Subscriptions::update()
+{
+    Clock::time_point now = Clock::now();
+
+    if (link_up && now - last_heartbeat > std::chrono::milliseconds(LINK_TIMEOUT_MS))
+    {
+        fprintf(stderr, "WARNING: lost heartbeat of system %d\n", target_system);
+        link_up = false;
+        inflight = -1;
+    }
+
+    if (!link_up)
+    {
+        return;
+    }
+
+    // an unanswered command counts as a failed attempt
+    if (inflight >= 0 && now - inflight_sent >= std::chrono::milliseconds(ACK_TIMEOUT_MS))
+    {
+        int index = inflight;
+        inflight = -1;
+        _fail(index);
+    }
+
+    // one command at a time, COMMAND_ACK does not name the message it answers
+    if (inflight < 0)
+    {
+        for (size_t i = 0; i < subscriptions.size(); i++)
+        {
+            if (subscriptions[i].state == STATE_PENDING)
+            {
+                _negotiate(i);
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < subscriptions.size(); i++)
+    {
+        Subscription &subscription = subscriptions[i];
+        if (subscription.state == STATE_PENDING)
+        {
+            continue;
+        }
+
+        // the window holds at least a few intervals of slow streams
+        double window = VERIFY_PERIOD_MS / 1000.0;
+        if (window < 5 / subscription.rate_hz)
+        {
+            window = 5 / subscription.rate_hz;
+        }
+
+        double elapsed = std::chrono::duration<double>(now - subscription.window_start).count();
+        if (elapsed >= window)
+        {
+            subscription.measured_rate = subscription.window_count / elapsed;
+            _restart_window(subscription, now);
+
+            // a stream at less than half of the rate counts as not negotiated
+            if (subscription.state == STATE_STREAMING)
+            {
+                if (subscription.measured_rate < subscription.rate_hz / 2)
+                {
+                    fprintf(stderr, "WARNING: message #%u arrives at %.1f Hz instead of %.1f Hz\n",
+                            subscription.msgid, subscription.measured_rate, subscription.rate_hz);
+                    _fail(i);
+                }
+                else
+                {
+                    subscription.attempts = 0;
+                }
+            }
+        }
+
+        if (subscription.state == STATE_POLLING &&
+            std::chrono::duration<double>(now - subscription.last_request).count() >= 1 / subscription.rate_hz)
+        {
+            _send_command(MAV_CMD_REQUEST_MESSAGE, subscription.msgid, 0);
+            subscription.last_request = now;
+        }
+    }
+}
+
+/**
+ * @brief Возвращает состояние подписки.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @return State Состояние, STATE_PENDING если подписки нет.
+ */
+Message_Subscriptions::State Message_Subscriptions::get_state(uint32_t msgid)
+{
+    int index = _find(msgid);
+    return index < 0 ? STATE_PENDING : subscriptions[index].state;
+}
+
+/**
+ * @brief Возвращает частоту сообщения за последний период измерения.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @return float Частота, Гц.
+ */
+float Message_Subscriptions::get_rate(uint32_t msgid)
+{
+    int index = _find(msgid);
+    return index < 0 ? 0 : subscriptions[index].measured_rate;
+}
+
+/**
+ * @brief Ищет подписку по идентификатору сообщения.
+ *
+ * @param msgid Идентификатор сообщения.
+ * @return int Индекс подписки или -1.
+ */
+int Message_Subscriptions::_find(uint32_t msgid)
+{
+    for (size_t i = 0; i < subscriptions.size(); i++)
+    {
+        if (subscriptions[i].msgid == msgid)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Отправляет команду автопилоту.
+ *
+ * @param command Команда.
+ * @param param1 Первый параметр.
+ * @param param2 Второй параметр.
+ * @return true если команда передана порту.
+ */
+bool Message_Subscriptions::_send_command(uint16_t command, float param1, float param2)
+{
+    mavlink_command_long_t cmd = {};
+    cmd.target_system = target_system;
+    cmd.target_component = target_component;
+    cmd.command = command;
+    cmd.param1 = param1;
+    cmd.param2 = param2;
+
+    mavlink_message_t message;
+    mavlink_msg_command_long_encode(system_id, component_id, &message, &cmd);
+
+    if (port->write_message(message) <= 0)
+    {
+        fprintf(stderr, "WARNING: could not send command %d\n", command);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Отправляет MAV_CMD_SET_MESSAGE_INTERVAL для подписки и ждет подтверждения.
+ *
+ * @param index Индекс подписки.
+ */
+void Message_Subscriptions::_negotiate(int index)
+{
+    Subscription &subscription = subscriptions[index];
+
+    _send_command(MAV_CMD_SET_MESSAGE_INTERVAL, subscription.msgid, 1e6f / subscription.rate_hz);
+    inflight = index;
+    inflight_sent = Clock::now();
+}
+
+/**
+ * @brief Засчитывает неудачную попытку согласования.
+ *
+ * @param index Индекс подписки.
+ */
+void Message_Subscriptions::_fail(int index)
+{
+    Subscription &subscription = subscriptions[index];
+
+    subscription.attempts++;
+    if (subscription.attempts < MAX_ATTEMPTS)
+    {
+        subscription.state = STATE_PENDING;
+        return;
+    }
+
+    fprintf(stderr, "WARNING: polling message #%u with MAV_CMD_REQUEST_MESSAGE\n", subscription.msgid);
+    subscription.state = STATE_POLLING;
+    subscription.last_request = Clock::time_point();
+    _restart_window(subscription, Clock::now());
+}
+
+/**
+ * @brief Начинает новый период измерения частоты.
+ *
+ * @param subscription Подписка.
+ * @param now Текущее время.
+ */
+void Message_Subscriptions::_restart_window(Subscription &subscription, Clock::time_point now)
+{
+    subscription.window_start = now;
+    subscription.window_count = 0;
+}
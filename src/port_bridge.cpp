@@ -0,0 +1,226 @@
+#include "port_bridge.h"
+
+/**
+ * @brief Конструктор класса Port_Bridge.
+ */
+Port_Bridge::Port_Bridge()
+{
+    forwarded = 0;
+    reencoded = 0;
+    routed = 0;
+    component_links.resize(256 * 256);
+    clear_routes();
+}
+
+/**
+ * @brief Деструктор класса Port_Bridge.
+ */
+Port_Bridge::~Port_Bridge()
+{
+    for (size_t i = 0; i < port_bits.size(); i++)
+    {
+        delete port_bits[i];
+    }
+}
+
+/**
+ * @brief Добавляет запущенный порт.
+ *
+ * @param port Порт, get_fd() которого должен быть действительным.
+ * @return true если порт добавлен, false если портов уже MAX_PORTS.
+ */
+bool Port_Bridge::add_port(Generic_Port *port)
+{
+    if (ports.size() >= (size_t)MAX_PORTS)
+    {
+        fprintf(stderr, "ERROR: bridge supports at most %d ports\n", MAX_PORTS);
+        return false;
+    }
+
+    // the handler keeps the bit of its port, remove_port() renumbers it in place
+    int *bit = new int(ports.size());
+    bool added = reactor.add_port_frames(port, [this, bit](Generic_Port *from, const mavlink_message_t &message,
+                                                           const Generic_Port::Raw_Frame &frame) {
+        _forward(*bit, from, message, frame);
+    });
+
+    if (added)
+    {
+        ports.push_back(port);
+        port_bits.push_back(bit);
+    }
+    else
+    {
+        delete bit;
+    }
+
+    return added;
+}
+
+/**
+ * @brief Удаляет порт.
+ *
+ * @param port Порт.
+ */
+void Port_Bridge::remove_port(Generic_Port *port)
+{
+    reactor.remove_port(port);
+
+    int index = _port_index(port);
+    if (index < 0)
+    {
+        return;
+    }
+    ports.erase(ports.begin() + index);
+
+    // the removed handler is never called again, the next ones move down with their ports
+    delete port_bits[index];
+    port_bits.erase(port_bits.begin() + index);
+    for (size_t i = index; i < port_bits.size(); i++)
+    {
+        *port_bits[i] = i;
+    }
+
+    // ports after the removed one move down by one bit
+    uint64_t low = ((uint64_t)1 << index) - 1;
+    for (int i = 0; i < 256; i++)
+    {
+        system_links[i] = (system_links[i] & low) | ((system_links[i] >> 1) & ~low);
+    }
+    for (size_t i = 0; i < component_links.size(); i++)
+    {
+        component_links[i] = (component_links[i] & low) | ((component_links[i] >> 1) & ~low);
+    }
+}
+
+/**
+ * @brief Забывает все выученные маршруты.
+ */
+void Port_Bridge::clear_routes()
+{
+    memset(system_links, 0, sizeof(system_links));
+    std::fill(component_links.begin(), component_links.end(), 0);
+}
+
+/**
+ * @brief Устанавливает обработчик, вызываемый для каждого пересланного сообщения.
+ *
+ * @param callback Обработчик или пустой объект.
+ */
+void Port_Bridge::set_message_callback(Port_Reactor::Message_Callback callback)
+{
+    on_message = callback;
+}
+
+/**
+ * @brief Возвращает индекс порта в ports.
+ *
+ * @param port Порт.
+ * @return int Индекс или -1, если порт не добавлен.
+ */
+int Port_Bridge::_port_index(Generic_Port *port)
+{
+    for (size_t i = 0; i < ports.size(); i++)
+    {
+        if (ports[i] == port)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Выбирает порты, в которые нужно отправить сообщение.
+ *
+ * @param message Сообщение.
+ * @param all Маска всех портов моста.
+ * @return uint64_t Битовая маска индексов портов.
+ */
+uint64_t Port_Bridge::_route(const mavlink_message_t &message, uint64_t all)
+{
+    const mavlink_msg_entry_t *entry = Message_Entries::find(message.msgid);
+    if (entry == NULL || !(entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_SYSTEM))
+    {
+        return all;
+    }
+
+    // MAVLink 2 trims trailing zeros of the payload, a cut off target is 0
+    const uint8_t *payload = (const uint8_t *)message.payload64;
+    uint8_t target_system = entry->target_system_ofs < message.len ? payload[entry->target_system_ofs] : 0;
+    uint8_t target_component = 0;
+    if ((entry->flags & MAV_MSG_ENTRY_FLAG_HAVE_TARGET_COMPONENT) && entry->target_component_ofs < message.len)
+    {
+        target_component = payload[entry->target_component_ofs];
+    }
+
+    if (target_system == 0)
+    {
+        return all;
+    }
+
+    if (target_component != 0)
+    {
+        uint64_t links = component_links[(target_system << 8) | target_component];
+        if (links)
+        {
+            return links;
+        }
+    }
+
+    // a system that was never seen may be anywhere
+    uint64_t links = system_links[target_system];
+    return links ? links : all;
+}
+
+/**
+ * @brief Пересылает кадр в порты, выбранные по маршрутам, кроме порта-источника.
+ *
+ * @param from_index Индекс порта-источника в ports.
+ * @param from Порт, принявший кадр.
+ * @param message Разобранное сообщение.
+ * @param frame Кадр в буфере приема порта.
+ */
+void Port_Bridge::_forward(int from_index, Generic_Port *from, const mavlink_message_t &message,
+                           const Generic_Port::Raw_Frame &frame)
+{
+    // the sender is reachable through the port it came from
+    uint64_t from_bit = (uint64_t)1 << from_index;
+    system_links[message.sysid] |= from_bit;
+    component_links[(message.sysid << 8) | message.compid] |= from_bit;
+
+    uint64_t all = ports.size() == MAX_PORTS ? ~(uint64_t)0 : ((uint64_t)1 << ports.size()) - 1;
+    uint64_t targets = _route(message, all);
+    if (targets != all)
+    {
+        routed++;
+    }
+    targets &= ~from_bit;
+
+    const uint8_t *data = frame.data;
+    unsigned len = frame.len;
+
+    // the frame came in several chunks, only then it is serialized again
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+    if (data == NULL && targets)
+    {
+        len = mavlink_msg_to_send_buffer(buf, &message);
+        data = buf;
+        reencoded++;
+    }
+
+    for (size_t i = 0; targets; i++, targets >>= 1)
+    {
+        if ((targets & 1) && ports[i]->write_raw(data, len) < 0)
+        {
+            fprintf(stderr, "WARNING: bridge could not forward message #%d\n", message.msgid);
+        }
+    }
+    forwarded++;
+
+    // after forwarding, the callback may remove ports
+    if (on_message)
+    {
+        on_message(from, message);
+    }
+}
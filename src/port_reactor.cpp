@@ -0,0 +1,421 @@
+#include "port_reactor.h"
+
+/**
+ * @brief Конструктор класса Port_Reactor.
+ *
+ * Создает epoll и eventfd для пробуждения.
+ */
+Port_Reactor::Port_Reactor()
+{
+    running = false;
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+    wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;
+    if (epfd < 0 || wakefd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, wakefd, &event) != 0)
+    {
+        printf("\n reactor init failed\n");
+        throw 1;
+    }
+}
+
+/**
+ * @brief Деструктор класса Port_Reactor.
+ *
+ * Закрывает таймеры, epoll и eventfd. Порты остаются открытыми.
+ */
+Port_Reactor::~Port_Reactor()
+{
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        _remove_source(sources[i]);
+    }
+    _release_removed();
+
+    close(wakefd);
+    close(epfd);
+}
+
+/**
+ * @brief Добавляет запущенный порт.
+ *
+ * @param port Порт, get_fd() которого должен быть действительным.
+ * @param callback Обработчик сообщений порта.
+ * @return true если порт добавлен.
+ * @return false если порт не поддерживает ожидание готовности или не запущен.
+ */
+bool Port_Reactor::add_port(Generic_Port *port, Message_Callback callback)
+{
+    if (port->get_fd() < 0)
+    {
+        fprintf(stderr, "ERROR: port has no descriptor to wait on, is it started?\n");
+        return false;
+    }
+
+    Source *source = new Source();
+    source->fd = port->get_fd();
+    source->port = port;
+    source->on_message = callback;
+    source->removed = false;
+
+    return _add_source(source);
+}
+
+/**
+ * @brief Добавляет запущенный порт, сообщения которого передаются вместе с кадрами.
+ *
+ * @param port Порт, get_fd() которого должен быть действительным.
+ * @param callback Обработчик сообщений и кадров порта.
+ * @return true если порт добавлен.
+ */
+bool Port_Reactor::add_port_frames(Generic_Port *port, Frame_Callback callback)
+{
+    if (port->get_fd() < 0)
+    {
+        fprintf(stderr, "ERROR: port has no descriptor to wait on, is it started?\n");
+        return false;
+    }
+
+    Source *source = new Source();
+    source->fd = port->get_fd();
+    source->port = port;
+    source->on_frame = callback;
+    source->removed = false;
+
+    return _add_source(source);
+}
+
+/**
+ * @brief Добавляет запущенный порт, кадры которого передаются в виде представлений.
+ *
+ * @param port Порт, get_fd() которого должен быть действительным.
+ * @param callback Обработчик кадров порта.
+ * @return true если порт добавлен.
+ */
+bool Port_Reactor::add_port_views(Generic_Port *port, View_Callback callback)
+{
+    if (port->get_fd() < 0)
+    {
+        fprintf(stderr, "ERROR: port has no descriptor to wait on, is it started?\n");
+        return false;
+    }
+
+    Source *source = new Source();
+    source->fd = port->get_fd();
+    source->port = port;
+    source->on_view = callback;
+    source->removed = false;
+
+    return _add_source(source);
+}
+
+/**
+ * @brief Удаляет порт.
+ *
+ * @param port Порт.
+ */
+void Port_Reactor::remove_port(Generic_Port *port)
+{
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (sources[i]->port == port && !sources[i]->removed)
+        {
+            _remove_source(sources[i]);
+        }
+    }
+}
+
+/**
+ * @brief Добавляет периодический таймер.
+ *
+ * @param interval_ms Период, мс (больше нуля).
+ * @param callback Обработчик таймера.
+ * @return int Идентификатор таймера или -1 при ошибке.
+ */
+int Port_Reactor::add_timer(int interval_ms, Timer_Callback callback)
+{
+    // a zero period would leave the timer disarmed
+    if (interval_ms <= 0)
+    {
+        fprintf(stderr, "ERROR: Invalid timer interval %d ms\n", interval_ms);
+        return -1;
+    }
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: Could not create timer, errno = %d : %m\n", errno);
+        return -1;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, NULL) != 0)
+    {
+        fprintf(stderr, "ERROR: Could not arm timer, errno = %d : %m\n", errno);
+        close(fd);
+        return -1;
+    }
+
+    Source *source = new Source();
+    source->fd = fd;
+    source->port = NULL;
+    source->on_timer = callback;
+    source->removed = false;
+
+    if (!_add_source(source))
+    {
+        close(fd);
+        return -1;
+    }
+
+    // the timer descriptor doubles as its id
+    return fd;
+}
+
+/**
+ * @brief Удаляет таймер.
+ *
+ * @param timer_id Идентификатор таймера.
+ */
+void Port_Reactor::remove_timer(int timer_id)
+{
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (sources[i]->port == NULL && sources[i]->fd == timer_id && !sources[i]->removed)
+        {
+            _remove_source(sources[i]);
+        }
+    }
+}
+
+/**
+ * @brief Выполняет одну итерацию: ожидание событий и их обработку.
+ *
+ * @param timeout_ms Время ожидания событий, мс, -1 - без ограничения.
+ * @return int Количество переданных обработчикам сообщений или -1 при ошибке.
+ */
+int Port_Reactor::run_once(int timeout_ms)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int result = epoll_wait(epfd, events, MAX_EVENTS, timeout_ms);
+
+    if (result < 0)
+    {
+        if (errno == EINTR)
+        {
+            return 0;
+        }
+        fprintf(stderr, "ERROR: Could not wait for events, errno = %d : %m\n", errno);
+        return -1;
+    }
+
+    int count = 0;
+    for (int i = 0; i < result; i++)
+    {
+        Source *source = (Source *)events[i].data.ptr;
+
+        // the wake up eventfd is registered without a source
+        if (source == NULL)
+        {
+            uint64_t value;
+            while (read(wakefd, &value, sizeof(value)) > 0)
+            {
+            }
+            continue;
+        }
+
+        // removed by a callback earlier in this iteration
+        if (source->removed)
+        {
+            continue;
+        }
+
+        if (source->port)
+        {
+            count += _service_port(source);
+        }
+        else
+        {
+            _service_timer(source);
+        }
+    }
+
+    // a write from a callback reaps io_uring completions of the target port,
+    // data received with them does not signal its descriptor again
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        Source *source = sources[i];
+        if (source->port && !source->removed && source->port->rx_pending() > 0)
+        {
+            count += _service_port(source);
+        }
+    }
+
+    _release_removed();
+
+    return count;
+}
+
+/**
+ * @brief Обрабатывает события до вызова stop().
+ */
+void Port_Reactor::run()
+{
+    running = true;
+
+    while (running)
+    {
+        if (run_once(-1) < 0)
+        {
+            break;
+        }
+    }
+
+    running = false;
+}
+
+/**
+ * @brief Останавливает run().
+ */
+void Port_Reactor::stop()
+{
+    running = false;
+
+    // wake up epoll_wait() of the reactor thread
+    uint64_t value = 1;
+    if (write(wakefd, &value, sizeof(value)) < 0)
+    {
+        fprintf(stderr, "WARNING: Could not wake up reactor\n");
+    }
+}
+
+/**
+ * @brief Регистрирует источник в epoll.
+ *
+ * @param source Источник.
+ * @return true если источник зарегистрирован.
+ */
+bool Port_Reactor::_add_source(Source *source)
+{
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = source;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, source->fd, &event) != 0)
+    {
+        fprintf(stderr, "ERROR: Could not watch fd %d, errno = %d : %m\n", source->fd, errno);
+        delete source;
+        return false;
+    }
+
+    sources.push_back(source);
+    return true;
+}
+
+/**
+ * @brief Помечает источник удаленным и снимает его с epoll.
+ *
+ * @param source Источник.
+ */
+void Port_Reactor::_remove_source(Source *source)
+{
+    epoll_ctl(epfd, EPOLL_CTL_DEL, source->fd, NULL);
+    source->removed = true;
+}
+
+/**
+ * @brief Освобождает удаленные источники.
+ */
+void Port_Reactor::_release_removed()
+{
+    for (size_t i = 0; i < sources.size();)
+    {
+        Source *source = sources[i];
+        if (!source->removed)
+        {
+            i++;
+            continue;
+        }
+
+        // timers are owned by the reactor, ports by the caller
+        if (source->port == NULL)
+        {
+            close(source->fd);
+        }
+        sources.erase(sources.begin() + i);
+        delete source;
+    }
+}
+
+/**
+ * @brief Читает сообщения готового порта и передает их обработчику.
+ *
+ * @param source Источник порта.
+ * @return int Количество переданных сообщений.
+ */
+int Port_Reactor::_service_port(Source *source)
+{
+    int count = 0;
+
+    // one readiness event, then drain what the port already buffered without blocking
+    do
+    {
+        int n;
+        if (source->on_view)
+        {
+            n = source->port->read_views(views, BATCH_MESSAGES);
+        }
+        else if (source->on_frame)
+        {
+            n = source->port->read_frames(messages, frames, BATCH_MESSAGES);
+        }
+        else
+        {
+            n = source->port->read_messages(messages, BATCH_MESSAGES);
+        }
+        if (n < 0)
+        {
+            break;
+        }
+
+        for (int i = 0; i < n && !source->removed; i++)
+        {
+            if (source->on_view)
+            {
+                source->on_view(source->port, views[i]);
+            }
+            else if (source->on_frame)
+            {
+                source->on_frame(source->port, messages[i], frames[i]);
+            }
+            else
+            {
+                source->on_message(source->port, messages[i]);
+            }
+        }
+        count += n;
+    } while (!source->removed && source->port->rx_pending() > 0);
+
+    return count;
+}
+
+/**
+ * @brief Обрабатывает срабатывание таймера.
+ *
+ * @param source Источник таймера.
+ */
+void Port_Reactor::_service_timer(Source *source)
+{
+    uint64_t expirations;
+    if (read(source->fd, &expirations, sizeof(expirations)) <= 0)
+    {
+        return;
+    }
+
+    source->on_timer();
+}
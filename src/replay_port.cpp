@@ -0,0 +1,585 @@
+#include "replay_port.h"
+
+// tlog timestamps outside 2000..2100 mean the file is not a tlog
+static const uint64_t TLOG_MIN_TIMESTAMP_US = 946684800ULL * 1000000ULL;
+static const uint64_t TLOG_MAX_TIMESTAMP_US = 4102444800ULL * 1000000ULL;
+
+/**
+ * @brief Конструктор класса Replay_Port.
+ *
+ * @param path_ Путь к файлу записи.
+ * @param format_ Формат файла.
+ */
+Replay_Port::Replay_Port(const char *path_, Format format_)
+{
+    path = path_;
+    format = format_;
+    speed = 0;
+    loop = false;
+    is_open = false;
+    finished = false;
+
+    data = NULL;
+    size = 0;
+    offset = 0;
+    bytes_replayed = 0;
+
+    paced_started = false;
+    first_timestamp_us = 0;
+    start_us = 0;
+    log_time_us = 0;
+    written_frames = 0;
+
+    int result = pthread_mutex_init(&lock, NULL);
+    if (result == 0)
+    {
+        result = pthread_mutex_init(&write_lock, NULL);
+    }
+    if (result != 0)
+    {
+        printf("\n mutex init failed\n");
+        throw 1;
+    }
+}
+
+/**
+ * @brief Деструктор класса Replay_Port.
+ */
+Replay_Port::~Replay_Port()
+{
+    if (is_open)
+    {
+        stop();
+    }
+
+    pthread_mutex_destroy(&lock);
+    pthread_mutex_destroy(&write_lock);
+}
+
+/**
+ * @brief Читает одно сообщение записи.
+ *
+ * @param message Сообщение.
+ * @return int 1 если сообщение прочитано, 0 если его еще нет, -1 если порт не запущен.
+ */
+int Replay_Port::read_message(mavlink_message_t &message)
+{
+    return read_messages(&message, 1);
+}
+
+/**
+ * @brief Читает сообщения записи, время которых наступило.
+ *
+ * @param messages Массив для сообщений.
+ * @param max_messages Размер массива messages.
+ * @return int Количество сообщений или -1, если порт не запущен.
+ */
+int Replay_Port::read_messages(mavlink_message_t *messages, int max_messages)
+{
+    return read_messages(messages, NULL, max_messages);
+}
+
+/**
+ * @brief Читает сообщения записи вместе с их байтами в отображении файла.
+ *
+ * @param messages Массив для сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массивов.
+ * @return int Количество сообщений или -1, если порт не запущен.
+ */
+int Replay_Port::read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    int count = 0;
+    uint64_t wait_us = 0;
+
+    pthread_mutex_lock(&lock);
+
+    if (!is_open)
+    {
+        pthread_mutex_unlock(&lock);
+        fprintf(stderr, "ERROR: Could not read from closed replay %s\n", path.c_str());
+        return -1;
+    }
+
+    if (finished)
+    {
+        wait_us = MAX_WAIT_US;
+    }
+    else if (format == FORMAT_TLOG)
+    {
+        count = _read_tlog(messages, frames, max_messages, wait_us);
+    }
+    else
+    {
+        count = _read_raw(messages, frames, max_messages);
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    // behave like a quiet link instead of making the caller spin
+    if (count == 0 && wait_us > 0)
+    {
+        usleep(wait_us < MAX_WAIT_US ? wait_us : MAX_WAIT_US);
+    }
+
+    return count;
+}
+
+/**
+ * @brief Сохраняет переданное сообщение.
+ *
+ * @param message Сообщение.
+ * @return int Длина кадра или -1, если порт не запущен.
+ */
+int Replay_Port::write_message(const mavlink_message_t &message)
+{
+    uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+
+    // Translate message to buffer
+    unsigned len = mavlink_msg_to_send_buffer(buf, &message);
+
+    return write_raw(buf, len);
+}
+
+/**
+ * @brief Сохраняет переданные кадры.
+ *
+ * @param buf Байты кадров.
+ * @param len Длина данных.
+ * @return int len или -1, если порт не запущен.
+ */
+int Replay_Port::write_raw(const uint8_t *buf, unsigned len)
+{
+    if (!is_open)
+    {
+        return -1;
+    }
+
+    uint64_t timestamp;
+    if (format == FORMAT_TLOG)
+    {
+        timestamp = log_time_us.load(std::memory_order_relaxed);
+    }
+    else
+    {
+        timestamp = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    uint8_t stamp[TLOG_TIMESTAMP_LEN];
+    for (unsigned i = 0; i < TLOG_TIMESTAMP_LEN; i++)
+    {
+        stamp[i] = (uint8_t)(timestamp >> (8 * (TLOG_TIMESTAMP_LEN - 1 - i)));
+    }
+
+    pthread_mutex_lock(&write_lock);
+
+    // a batch of frames becomes one tlog record per frame
+    unsigned pos = 0;
+    while (pos < len)
+    {
+        unsigned frame_len = _record_frame_length(buf + pos, len - pos);
+        if (frame_len == 0)
+        {
+            // not a frame, kept as is
+            frame_len = len - pos;
+        }
+
+        written.insert(written.end(), stamp, stamp + TLOG_TIMESTAMP_LEN);
+        written.insert(written.end(), buf + pos, buf + pos + frame_len);
+        written_frames++;
+        pos += frame_len;
+    }
+
+    pthread_mutex_unlock(&write_lock);
+
+    return len;
+}
+
+/**
+ * @brief Задает темп воспроизведения.
+ *
+ * @param factor Ускорение относительно времени записи, 0 - без пауз.
+ */
+void Replay_Port::set_speed(double factor)
+{
+    speed = factor > 0 ? factor : 0;
+}
+
+/**
+ * @brief Включает повторение записи с начала после ее окончания.
+ *
+ * @param enable true для повторения.
+ */
+void Replay_Port::set_loop(bool enable)
+{
+    pthread_mutex_lock(&lock);
+    loop = enable;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Проверяет, выданы ли все кадры записи.
+ *
+ * @return true если запись закончилась и повторение выключено.
+ */
+bool Replay_Port::is_finished()
+{
+    pthread_mutex_lock(&lock);
+    bool result = finished;
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+/**
+ * @brief Копирует переданные порту кадры.
+ *
+ * @param records Записи tlog.
+ * @return unsigned long Количество переданных кадров.
+ */
+unsigned long Replay_Port::get_written(std::vector<uint8_t> &records)
+{
+    pthread_mutex_lock(&write_lock);
+    records = written;
+    unsigned long frames = written_frames;
+    pthread_mutex_unlock(&write_lock);
+
+    return frames;
+}
+
+/**
+ * @brief Сохраняет переданные порту кадры в файл tlog.
+ *
+ * @param path_ Путь к файлу.
+ * @return true если файл записан.
+ */
+bool Replay_Port::save_written(const char *path_)
+{
+    FILE *file = fopen(path_, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "ERROR: Could not create %s, errno = %d : %m\n", path_, errno);
+        return false;
+    }
+
+    pthread_mutex_lock(&write_lock);
+    size_t result = fwrite(written.data(), 1, written.size(), file);
+    bool success = result == written.size();
+    pthread_mutex_unlock(&write_lock);
+
+    if (fclose(file) != 0 || !success)
+    {
+        fprintf(stderr, "ERROR: Could not write %s, errno = %d : %m\n", path_, errno);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Удаляет сохраненные переданные кадры.
+ */
+void Replay_Port::clear_written()
+{
+    pthread_mutex_lock(&write_lock);
+    written.clear();
+    written_frames = 0;
+    pthread_mutex_unlock(&write_lock);
+}
+
+/**
+ * @brief Открывает и отображает в память файл записи.
+ */
+void Replay_Port::start()
+{
+    printf("OPEN REPLAY\n");
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        printf("failure, could not open %s.\n", path.c_str());
+        throw EXIT_FAILURE;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        printf("failure, %s is empty.\n", path.c_str());
+        close(fd);
+        throw EXIT_FAILURE;
+    }
+
+    void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file, the descriptor is not needed
+    close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        printf("failure, could not map %s.\n", path.c_str());
+        throw EXIT_FAILURE;
+    }
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+
+    pthread_mutex_lock(&lock);
+
+    data = (const uint8_t *)mapping;
+    size = st.st_size;
+    if (format == FORMAT_AUTO)
+    {
+        format = _detect_format();
+    }
+
+    offset = 0;
+    bytes_replayed = 0;
+    finished = false;
+    paced_started = false;
+    log_time_us = format == FORMAT_TLOG ? _read_timestamp(data) : 0;
+    lastStatus.packet_rx_drop_count = 0;
+    _reset_parser();
+    is_open = true;
+
+    pthread_mutex_unlock(&lock);
+
+    printf("Replaying %s (%s, %lu bytes) ", path.c_str(), format == FORMAT_TLOG ? "tlog" : "raw", (unsigned long)size);
+    if (format == FORMAT_TLOG && speed > 0)
+    {
+        printf("at x%g\n", speed);
+    }
+    else
+    {
+        printf("as fast as possible\n");
+    }
+}
+
+/**
+ * @brief Закрывает файл записи.
+ */
+void Replay_Port::stop()
+{
+    printf("CLOSE REPLAY\n");
+
+    // the RX thread reads through this port, it has to end first
+    stop_rx_thread();
+
+    pthread_mutex_lock(&lock);
+    if (is_open)
+    {
+        munmap((void *)data, size);
+        data = NULL;
+        size = 0;
+        is_open = false;
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Определяет формат отображенного файла.
+ *
+ * @return Format FORMAT_TLOG или FORMAT_RAW.
+ */
+Replay_Port::Format Replay_Port::_detect_format()
+{
+    if (size <= TLOG_TIMESTAMP_LEN)
+    {
+        return FORMAT_RAW;
+    }
+
+    // a raw capture would have to start with eight bytes that read as a plausible date
+    uint64_t timestamp = _read_timestamp(data);
+    if (timestamp < TLOG_MIN_TIMESTAMP_US || timestamp >= TLOG_MAX_TIMESTAMP_US)
+    {
+        return FORMAT_RAW;
+    }
+
+    if (_record_frame_length(data + TLOG_TIMESTAMP_LEN, size - TLOG_TIMESTAMP_LEN) == 0)
+    {
+        return FORMAT_RAW;
+    }
+
+    return FORMAT_TLOG;
+}
+
+/**
+ * @brief Читает метку времени записи tlog.
+ *
+ * @param record Начало записи.
+ * @return uint64_t Время, мкс.
+ */
+uint64_t Replay_Port::_read_timestamp(const uint8_t *record)
+{
+    uint64_t timestamp = 0;
+    for (unsigned i = 0; i < TLOG_TIMESTAMP_LEN; i++)
+    {
+        timestamp = (timestamp << 8) | record[i];
+    }
+    return timestamp;
+}
+
+/**
+ * @brief Вычисляет длину кадра по его заголовку.
+ *
+ * @param frame Начало кадра.
+ * @param avail Количество доступных байт.
+ * @return unsigned Длина кадра или 0, если frame не начинается с целого кадра.
+ */
+unsigned Replay_Port::_record_frame_length(const uint8_t *frame, size_t avail)
+{
+    unsigned len;
+    if (avail > 2 && frame[0] == MAVLINK_STX)
+    {
+        len = MAVLINK_NUM_NON_PAYLOAD_BYTES + frame[1];
+        if (frame[2] & MAVLINK_IFLAG_SIGNED)
+        {
+            len += MAVLINK_SIGNATURE_BLOCK_LEN;
+        }
+    }
+    else if (avail > 1 && frame[0] == MAVLINK_STX_MAVLINK1)
+    {
+        len = MAVLINK_CORE_HEADER_MAVLINK1_LEN + 1 + MAVLINK_NUM_CHECKSUM_BYTES + frame[1];
+    }
+    else
+    {
+        return 0;
+    }
+
+    return len <= avail ? len : 0;
+}
+
+/**
+ * @brief Читает кадры сырой записи.
+ *
+ * @param messages Массив для сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массива messages.
+ * @return int Количество сообщений.
+ */
+int Replay_Port::_read_raw(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    int count = 0;
+    bool rewound = false;
+
+    while (count < max_messages)
+    {
+        if (offset == size)
+        {
+            // one pass per call, a capture without frames must not spin here
+            if (rewound || !_rewind())
+            {
+                break;
+            }
+            rewound = true;
+        }
+
+        // the whole mapping is one buffer, so frames never straddle two reads
+        size_t len = size - offset;
+        if (len > RAW_MAX_PARSE)
+        {
+            len = RAW_MAX_PARSE;
+        }
+
+        int pos = 0;
+        count += _parse_buffer(data + offset, (int)len, pos, messages + count, frames ? frames + count : NULL,
+                               max_messages - count);
+        offset += pos;
+        bytes_replayed += pos;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Читает кадры записи tlog, время которых наступило.
+ *
+ * @param messages Массив для сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массива messages.
+ * @param wait_us Время до следующей записи, мкс, если ее еще рано выдавать.
+ * @return int Количество сообщений.
+ */
+int Replay_Port::_read_tlog(mavlink_message_t *messages, Raw_Frame *frames, int max_messages, uint64_t &wait_us)
+{
+    int count = 0;
+    bool rewound = false;
+
+    while (count < max_messages)
+    {
+        if (size - offset <= TLOG_TIMESTAMP_LEN)
+        {
+            bytes_replayed += size - offset;
+            offset = size;
+            if (rewound || !_rewind())
+            {
+                break;
+            }
+            rewound = true;
+            continue;
+        }
+
+        const uint8_t *record = data + offset;
+        unsigned frame_len = _record_frame_length(record + TLOG_TIMESTAMP_LEN, size - offset - TLOG_TIMESTAMP_LEN);
+        if (frame_len == 0)
+        {
+            // a damaged record, look for the next one byte by byte
+            offset++;
+            bytes_replayed++;
+            continue;
+        }
+
+        uint64_t timestamp = _read_timestamp(record);
+        if (speed > 0)
+        {
+            uint64_t now = _now_us();
+            if (!paced_started)
+            {
+                paced_started = true;
+                first_timestamp_us = timestamp;
+                start_us = now;
+            }
+
+            // timestamps going backwards are released right away
+            uint64_t due_us = start_us;
+            if (timestamp > first_timestamp_us)
+            {
+                due_us += (uint64_t)((timestamp - first_timestamp_us) / speed);
+            }
+            if (due_us > now)
+            {
+                wait_us = due_us - now;
+                break;
+            }
+        }
+        log_time_us.store(timestamp, std::memory_order_relaxed);
+
+        int pos = TLOG_TIMESTAMP_LEN;
+        int n = _parse_buffer(record, TLOG_TIMESTAMP_LEN + frame_len, pos, messages + count, frames ? frames + count : NULL, 1);
+        if (n == 0)
+        {
+            // a frame with a bad checksum must not leave its bytes in the parser
+            _reset_parser();
+        }
+        count += n;
+        offset += TLOG_TIMESTAMP_LEN + frame_len;
+        bytes_replayed += TLOG_TIMESTAMP_LEN + frame_len;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Начинает запись с начала или отмечает ее окончание.
+ *
+ * @return true если запись начата заново.
+ */
+bool Replay_Port::_rewind()
+{
+    if (!loop)
+    {
+        finished = true;
+        return false;
+    }
+
+    offset = 0;
+    paced_started = false;
+    _reset_parser();
+
+    return true;
+}
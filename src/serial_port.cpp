@@ -24,12 +24,14 @@ Serial_Port::Serial_Port()
 /**
  * @brief Деструктор класса Serial_Port.
  * 
- * Уничтожает мьютекс.
+ * Уничтожает мьютексы и условие очереди передачи.
  */
 Serial_Port::~Serial_Port()
 {
     // destroy mutex
     pthread_mutex_destroy(&lock);
+    pthread_mutex_destroy(&tx_lock);
+    pthread_cond_destroy(&tx_cond);
 }
 
 /**
@@ -41,12 +43,28 @@ void Serial_Port::initialize_defaults()
     debug = false;
     fd = -1;
     is_open = false;
+    rx_head = 0;
+    rx_tail = 0;
+    rx_mode = RX_MODE_LATENCY;
+    tx_head = 0;
+    tx_tail = 0;
+    tx_running = false;
+    tx_error = 0;
+    io_engine = IO_ENGINE_SYSCALL;
 
     uart_name = (char *)"/dev/ttyUSB0";
     baudrate = 57600;
 
     // Start mutex
     int result = pthread_mutex_init(&lock, NULL);
+    if (result == 0)
+    {
+        result = pthread_mutex_init(&tx_lock, NULL);
+    }
+    if (result == 0)
+    {
+        result = pthread_cond_init(&tx_cond, NULL);
+    }
     if (result != 0)
     {
         printf("\n mutex init failed\n");
@@ -76,7 +94,11 @@ int Serial_Port::read_message(mavlink_message_t &message)
     if (result > 0)
     {
         // the parsing
-        msgReceived = mavlink_parse_char(MAVLINK_COMM_1, cp, &message, &status);
+        msgReceived = _parse_char(&parse_buffer, &parse_status, cp, &message, &status);
+        if (msgReceived)
+        {
+            _publish(message);
+        }
 
         // check for dropped packets
         if ((lastStatus.packet_rx_drop_count != status.packet_rx_drop_count) && debug)
@@ -88,8 +110,8 @@ int Serial_Port::read_message(mavlink_message_t &message)
         lastStatus = status;
     }
 
-    // Couldn't read from port
-    else
+    // Couldn't read from port, io_uring returns 0 after write completions only
+    else if (result < 0 || !uring.is_ready())
     {
         fprintf(stderr, "ERROR: Could not read from fd %d\n", fd);
     }
@@ -129,24 +151,221 @@ int Serial_Port::read_message(mavlink_message_t &message)
 }
 
 /**
- * @brief Записывает сообщение в последовательный порт.
+ * @brief Читает все сообщения из очередной порции данных последовательного порта.
+ * 
+ * @param messages Массив, в который будут записаны прочитанные сообщения.
+ * @param max_messages Размер массива messages.
+ * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+ */
+int Serial_Port::read_messages(mavlink_message_t *messages, int max_messages)
+{
+    return read_messages(messages, NULL, max_messages);
+}
+
+/**
+ * @brief Читает сообщения вместе с их исходными байтами в кольцевом буфере приема.
+ * 
+ * @param messages Массив, в который будут записаны прочитанные сообщения.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массивов.
+ * @return int Количество прочитанных сообщений или -1 при ошибке чтения.
+ */
+int Serial_Port::read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    int count = 0;
+
+    // Lock
+    pthread_mutex_lock(&lock);
+
+    int result = 1;
+    if (rx_head == rx_tail)
+    {
+        result = _fill_ring();
+    }
+
+    int error = errno;
+    if (result > 0)
+    {
+        count = _parse_ring(messages, frames, max_messages);
+    }
+
+    // Unlock
+    pthread_mutex_unlock(&lock);
+
+    // a signal interrupting read() is not an error of the port
+    if (result < 0 && (error == EINTR || error == EAGAIN))
+    {
+        return 0;
+    }
+
+    // Couldn't read from port, io_uring returns 0 after write completions only
+    if (result < 0 || (result == 0 && !uring.is_ready()))
+    {
+        fprintf(stderr, "ERROR: Could not read from fd %d\n", fd);
+
+        // end of file means the device went away
+        errno = result < 0 ? error : EIO;
+        return -1;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Ставит сообщение в очередь передачи последовательного порта.
  * 
  * @param message Константная ссылка на объект сообщения Mavlink, которое будет отправлено.
- * @return int Количество байт, записанных в порт.
+ * @return int Количество байт, поставленных в очередь, или -1 если порт не запущен.
  */
 int Serial_Port::write_message(const mavlink_message_t &message)
 {
-    char buf[300];
+    uint8_t buf[300];
 
     // Translate message to buffer
-    unsigned len = mavlink_msg_to_send_buffer((uint8_t *)buf, &message);
+    unsigned len = mavlink_msg_to_send_buffer(buf, &message);
 
-    // Write buffer to serial port, locks port while writing
-    int bytesWritten = _write_port(buf, len);
+    return write_raw(buf, len);
+}
+
+/**
+ * @brief Ставит готовые кадры в очередь передачи последовательного порта.
+ * 
+ * @param buf Байты кадров.
+ * @param len Длина данных.
+ * @return int Количество байт, поставленных в очередь, или -1 если порт не запущен.
+ */
+int Serial_Port::write_raw(const uint8_t *buf, unsigned len)
+{
+    // Queue buffer for the TX thread, does not touch the read lock
+    int bytesWritten = _write_port((char *)buf, len);
 
     return bytesWritten;
 }
 
+/**
+ * @brief Дожидается передачи очереди драйверу и выполняет tcdrain().
+ * 
+ * @return int 0 при успехе, -1 при ошибке.
+ */
+int Serial_Port::flush()
+{
+    // io_uring writes are ordered per descriptor, waiting for all of them is enough
+    if (uring.is_ready())
+    {
+        if (uring.drain() < 0)
+        {
+            return -1;
+        }
+        return tcdrain(fd);
+    }
+
+    pthread_mutex_lock(&tx_lock);
+
+    // everything queued before this call has to reach the driver
+    unsigned target = tx_head;
+    while (tx_running && (int)(target - tx_tail) > 0)
+    {
+        pthread_cond_wait(&tx_cond, &tx_lock);
+    }
+    bool running = tx_running && tx_error.load(std::memory_order_relaxed) == 0;
+
+    pthread_mutex_unlock(&tx_lock);
+
+    if (!running)
+    {
+        return -1;
+    }
+
+    // Wait until all data has been written
+    return tcdrain(fd);
+}
+
+/**
+ * @brief Возвращает количество байт кольцевого буфера, ожидающих разбора.
+ * 
+ * @return int Количество байт.
+ */
+int Serial_Port::rx_pending()
+{
+    pthread_mutex_lock(&lock);
+    int pending = rx_head - rx_tail;
+    pthread_mutex_unlock(&lock);
+
+    // completed reads not moved into the ring yet
+    if (uring.is_ready())
+    {
+        pending += uring.ready_count();
+    }
+
+    return pending;
+}
+
+/**
+ * @brief Устанавливает обработчик завершения записи.
+ * 
+ * @param callback Обработчик, вызываемый из потока передачи.
+ */
+void Serial_Port::set_write_callback(Write_Callback callback)
+{
+    pthread_mutex_lock(&tx_lock);
+    write_callback = callback;
+    pthread_mutex_unlock(&tx_lock);
+
+    // completed writes are only reported by io_uring when someone listens
+    uring.set_report_sends((bool)callback);
+}
+
+/**
+ * @brief Выбирает механизм ввода-вывода.
+ * 
+ * @param engine Механизм ввода-вывода.
+ * @return true если механизм выбран.
+ */
+bool Serial_Port::set_io_engine(Io_Engine engine)
+{
+    if (is_open)
+    {
+        fprintf(stderr, "ERROR: io engine can only be changed before start\n");
+        return false;
+    }
+
+    io_engine = engine;
+    return true;
+}
+
+/**
+ * @brief Устанавливает режим приема данных.
+ * 
+ * @param mode Режим приема.
+ */
+void Serial_Port::set_rx_mode(Rx_Mode mode)
+{
+    rx_mode = mode;
+
+    // applied by _setup_port() if the port is not open yet
+    if (!is_open)
+    {
+        return;
+    }
+
+    struct termios config;
+    if (tcgetattr(fd, &config) < 0)
+    {
+        fprintf(stderr, "\nERROR: could not read configuration of fd %d\n", fd);
+        return;
+    }
+
+    _set_rx_timing(config);
+
+    if (tcsetattr(fd, TCSANOW, &config) < 0)
+    {
+        fprintf(stderr, "\nERROR: could not set configuration of fd %d\n", fd);
+        return;
+    }
+
+    _set_low_latency(rx_mode == RX_MODE_LATENCY);
+}
+
 /**
  * @brief Открывает последовательный порт и настраивает его.
  */
@@ -178,6 +397,35 @@ void Serial_Port::start()
 
     printf("Connected to %s with %d baud, 8 data bits, no parity, 1 stop bit (8N1)\n", uart_name, baudrate);
     lastStatus.packet_rx_drop_count = 0;
+    _reset_parser();
+
+    // With io_uring the ring writes directly, no TX thread is needed
+    if (io_engine == IO_ENGINE_URING)
+    {
+        // one wait never returns more than the empty receive ring can hold
+        if (uring.init(RX_RING_LEN / URING_RX_BATCH, 16, 64) && uring.recv(fd, 0, Uring_Engine::RECV_READ))
+        {
+            uring.set_report_sends((bool)write_callback);
+            is_open = true;
+            printf("\n");
+            return;
+        }
+
+        fprintf(stderr, "WARNING: io_uring setup failed, using system calls\n");
+        uring.release();
+    }
+
+    // Start the TX thread
+    tx_head = 0;
+    tx_tail = 0;
+    tx_error = 0;
+    tx_running = true;
+    if (pthread_create(&tx_thread, NULL, &Serial_Port::_start_tx_thread, this) != 0)
+    {
+        tx_running = false;
+        printf("failure, could not start TX thread.\n");
+        throw EXIT_FAILURE;
+    }
 
     is_open = true;
 
@@ -193,6 +441,28 @@ void Serial_Port::stop()
 {
     printf("CLOSE PORT\n");
 
+    // the RX thread reads through this port, it has to end first
+    stop_rx_thread();
+
+    // The TX thread writes out what is already queued before it exits
+    pthread_mutex_lock(&tx_lock);
+    bool running = tx_running;
+    tx_running = false;
+    pthread_cond_broadcast(&tx_cond);
+    pthread_mutex_unlock(&tx_lock);
+
+    if (running)
+    {
+        pthread_join(tx_thread, NULL);
+    }
+
+    // queued io_uring writes are completed before the port is closed
+    if (uring.is_ready())
+    {
+        uring.drain();
+        uring.release();
+    }
+
     int result = close(fd);
 
     if (result)
@@ -295,10 +565,8 @@ bool Serial_Port::_setup_port(int baud, int data_bits, int stop_bits, bool parit
     config.c_cflag &= ~(CSIZE | PARENB);
     config.c_cflag |= CS8;
 
-    // One input byte is enough to return from read()
-    // Inter-character timer off
-    config.c_cc[VMIN] = 1;
-    config.c_cc[VTIME] = 10; // was 0
+    // Read timing depends on the receive mode
+    _set_rx_timing(config);
 
     // Get the current options for the port
     ////struct termios options;
@@ -378,10 +646,75 @@ bool Serial_Port::_setup_port(int baud, int data_bits, int stop_bits, bool parit
         return false;
     }
 
+    _set_low_latency(rx_mode == RX_MODE_LATENCY);
+
     // Done!
     return true;
 }
 
+/**
+ * @brief Заполняет VMIN/VTIME конфигурации порта согласно режиму приема.
+ * 
+ * @param config Конфигурация порта.
+ */
+void Serial_Port::_set_rx_timing(struct termios &config)
+{
+    if (rx_mode == RX_MODE_THROUGHPUT)
+    {
+        // Wake up once per ~2 ms of line time (10 bits per byte),
+        // or 0.1 s after the last received byte
+        int chunk = baudrate / 10 / 500;
+        if (chunk < 1)
+        {
+            chunk = 1;
+        }
+        if (chunk > 255)
+        {
+            chunk = 255;
+        }
+        config.c_cc[VMIN] = chunk;
+        config.c_cc[VTIME] = 1;
+    }
+    else
+    {
+        // One input byte is enough to return from read()
+        // Inter-character timer off
+        config.c_cc[VMIN] = 1;
+        config.c_cc[VTIME] = 0;
+    }
+}
+
+/**
+ * @brief Включает или выключает флаг низкой задержки драйвера UART.
+ * 
+ * @param enable Требуемое состояние флага.
+ */
+void Serial_Port::_set_low_latency(bool enable)
+{
+#ifdef ASYNC_LOW_LATENCY
+    // Not supported by every driver (pseudo terminals, some USB adapters), best effort only
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) < 0)
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+    }
+    else
+    {
+        serial.flags &= ~ASYNC_LOW_LATENCY;
+    }
+
+    if (ioctl(fd, TIOCSSERIAL, &serial) < 0 && debug)
+    {
+        fprintf(stderr, "WARNING: could not change low latency flag of fd %d\n", fd);
+    }
+#endif
+}
+
 /**
  * @brief Читает байт из последовательного порта.
  * 
@@ -393,7 +726,17 @@ int Serial_Port::_read_port(uint8_t &cp)
     // Lock
     pthread_mutex_lock(&lock);
 
-    int result = read(fd, &cp, 1);
+    int result = 1;
+    if (rx_head == rx_tail)
+    {
+        result = _fill_ring();
+    }
+
+    if (result > 0)
+    {
+        cp = rx_ring[rx_tail & (RX_RING_LEN - 1)];
+        rx_tail++;
+    }
 
     // Unlock
     pthread_mutex_unlock(&lock);
@@ -402,25 +745,353 @@ int Serial_Port::_read_port(uint8_t &cp)
 }
 
 /**
- * @brief Записывает данные в последовательный порт.
+ * @brief Дочитывает данные из последовательного порта в кольцевой буфер.
+ * 
+ * @return int Количество прочитанных байт или результат операции чтения при ошибке.
+ */
+int Serial_Port::_fill_ring()
+{
+    if (uring.is_ready())
+    {
+        return _fill_uring();
+    }
+
+    unsigned head = rx_head & (RX_RING_LEN - 1);
+    unsigned space = RX_RING_LEN - (rx_head - rx_tail);
+
+    // one read() never crosses the end of the ring
+    unsigned request = RX_RING_LEN - head;
+    if (request > space)
+    {
+        request = space;
+    }
+
+    // with VMIN = 1 read() returns what the driver holds, up to request, in one call
+    int result = read(fd, &rx_ring[head], request);
+
+    if (result > 0)
+    {
+        rx_head += result;
+    }
+
+    return result;
+}
+
+/**
+ * @brief Переносит в пустой кольцевой буфер данные, прочитанные через io_uring.
+ * 
+ * @return int Количество перенесенных байт, 0 если завершились только записи, или результат
+ * операции чтения при ошибке.
+ */
+int Serial_Port::_fill_uring()
+{
+    Uring_Engine::Completion completions[URING_RX_BATCH];
+
+    while (true)
+    {
+        int n = uring.wait(completions, URING_RX_BATCH, -1);
+        if (n < 0)
+        {
+            return -1;
+        }
+
+        int result = 0;
+        int error = 0;
+        for (int i = 0; i < n; i++)
+        {
+            Uring_Engine::Completion &completion = completions[i];
+
+            if (completion.kind == Uring_Engine::COMPLETION_SEND)
+            {
+                if (completion.result < 0)
+                {
+                    fprintf(stderr, "ERROR: Could not write to fd %d, res = %d\n", fd, completion.result);
+                }
+
+                pthread_mutex_lock(&tx_lock);
+                Write_Callback callback = write_callback;
+                pthread_mutex_unlock(&tx_lock);
+
+                if (callback)
+                {
+                    callback(completion.result < 0 ? -1 : completion.result);
+                }
+                continue;
+            }
+
+            // a failed read ends the request, re-arm it so the next call retries like read() would
+            if (completion.result <= 0 || !completion.data)
+            {
+                error = completion.result < 0 ? completion.result : -1;
+                uring.recycle(completion.buffer);
+                uring.recv(fd, 0, Uring_Engine::RECV_READ);
+                continue;
+            }
+
+            // the ring is empty on entry and holds URING_RX_BATCH buffers, so there is always room
+            unsigned head = rx_head & (RX_RING_LEN - 1);
+            unsigned first = RX_RING_LEN - head;
+            if (first > (unsigned)completion.result)
+            {
+                first = completion.result;
+            }
+            memcpy(&rx_ring[head], completion.data, first);
+            memcpy(&rx_ring[0], completion.data + first, completion.result - first);
+            rx_head += completion.result;
+            uring.recycle(completion.buffer);
+            result += completion.result;
+        }
+
+        // received data goes first, a read error is reported when nothing came with it
+        if (result > 0)
+        {
+            return result;
+        }
+        if (error < 0)
+        {
+            return error;
+        }
+
+        // only writes completed: the port was woken by the reactor, do not block it
+        if (n > 0)
+        {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Разбирает накопленные в кольцевом буфере байты.
+ * 
+ * @param messages Массив для найденных сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массива messages.
+ * @return int Количество найденных сообщений.
+ */
+int Serial_Port::_parse_ring(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+    int count = 0;
+
+    // at most two contiguous segments when the data wraps around the ring
+    while (rx_tail != rx_head && count < max_messages)
+    {
+        int start = rx_tail & (RX_RING_LEN - 1);
+        int end = start + (rx_head - rx_tail);
+        if (end > (int)RX_RING_LEN)
+        {
+            end = RX_RING_LEN;
+        }
+
+        int pos = start;
+        count += _parse_buffer(rx_ring, end, pos, messages + count, frames ? frames + count : NULL, max_messages - count);
+        rx_tail += pos - start;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Ставит данные в очередь передачи.
  * 
  * @param buf Буфер с данными для записи.
  * @param len Длина данных для записи.
- * @return int Количество записанных байт.
+ * @return int Количество поставленных в очередь байт или -1 если поток передачи не запущен.
  */
 int Serial_Port::_write_port(char *buf, unsigned len)
 {
+    // The write is queued on the ring and submitted right away, order is kept per descriptor
+    if (uring.is_ready())
+    {
+        int result = uring.send(fd, 0, (const uint8_t *)buf, len);
+        uring.submit();
+        return result;
+    }
+
     // Lock
-    pthread_mutex_lock(&lock);
+    pthread_mutex_lock(&tx_lock);
+
+    if (!_wait_tx_room(len))
+    {
+        pthread_mutex_unlock(&tx_lock);
+        return -1;
+    }
 
-    // Write packet via serial link
-    const int bytesWritten = static_cast<int>(write(fd, buf, len));
+    // Copy packet into the queue, in two parts if it wraps around
+    unsigned head = tx_head & (TX_RING_LEN - 1);
+    unsigned first = TX_RING_LEN - head;
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(&tx_ring[head], buf, first);
+    memcpy(&tx_ring[0], buf + first, len - first);
+    tx_head += len;
 
-    // Wait until all data has been written
-    tcdrain(fd);
+    pthread_cond_broadcast(&tx_cond);
 
     // Unlock
-    pthread_mutex_unlock(&lock);
+    pthread_mutex_unlock(&tx_lock);
 
-    return bytesWritten;
+    return len;
+}
+
+/**
+ * @brief Собирает кадр write_payload() прямо в очереди передачи.
+ * 
+ * @param frame Кадр.
+ * @return int Количество поставленных в очередь байт или -1 если поток передачи не запущен.
+ */
+int Serial_Port::_write_frame(const Tx_Frame &frame)
+{
+    // io_uring keeps its own send buffers
+    if (uring.is_ready())
+    {
+        return Generic_Port::_write_frame(frame);
+    }
+
+    unsigned len = frame.length();
+
+    pthread_mutex_lock(&tx_lock);
+
+    if (!_wait_tx_room(len))
+    {
+        pthread_mutex_unlock(&tx_lock);
+        return -1;
+    }
+
+    // frame numbers are taken under the lock, so they follow the queue order
+    unsigned head = tx_head & (TX_RING_LEN - 1);
+    unsigned first = TX_RING_LEN - head;
+    if (first >= len)
+    {
+        _encode_frame(frame, &tx_ring[head]);
+    }
+    else
+    {
+        // the frame wraps around the end of the queue
+        uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+        _encode_frame(frame, buf);
+        memcpy(&tx_ring[head], buf, first);
+        memcpy(&tx_ring[0], buf + first, len - first);
+    }
+    tx_head += len;
+
+    pthread_cond_broadcast(&tx_cond);
+
+    pthread_mutex_unlock(&tx_lock);
+
+    return len;
+}
+
+/**
+ * @brief Дожидается места в очереди передачи. Вызывается под блокировкой tx_lock.
+ * 
+ * @param len Требуемое количество байт.
+ * @return true если место есть, false если поток передачи остановлен.
+ */
+bool Serial_Port::_wait_tx_room(unsigned len)
+{
+    // the TX thread frees room as bytes reach the driver
+    while (tx_running && tx_error.load(std::memory_order_relaxed) == 0 &&
+           TX_RING_LEN - (tx_head - tx_tail) < len)
+    {
+        pthread_cond_wait(&tx_cond, &tx_lock);
+    }
+
+    return tx_running && tx_error.load(std::memory_order_relaxed) == 0;
+}
+
+/**
+ * @brief Цикл потока передачи: переносит данные из очереди в драйвер.
+ */
+void Serial_Port::_tx_loop()
+{
+    pthread_mutex_lock(&tx_lock);
+
+    while (true)
+    {
+        while (tx_running && tx_head == tx_tail)
+        {
+            pthread_cond_wait(&tx_cond, &tx_lock);
+        }
+
+        // stop() was called and the queue is written out
+        if (tx_head == tx_tail)
+        {
+            break;
+        }
+
+        // Producers only append past tx_head, so the queued region can be written unlocked
+        unsigned tail = tx_tail & (TX_RING_LEN - 1);
+        unsigned len = tx_head - tx_tail;
+        if (len > TX_RING_LEN - tail)
+        {
+            len = TX_RING_LEN - tail;
+        }
+        Write_Callback callback = write_callback;
+
+        pthread_mutex_unlock(&tx_lock);
+
+        // Write packet via serial link
+        int bytesWritten = static_cast<int>(write(fd, &tx_ring[tail], len));
+        int error = bytesWritten < 0 ? errno : 0;
+
+        // Interrupted or full driver buffer: nothing was written, try the same bytes again
+        if (error == EINTR || error == EAGAIN || error == EWOULDBLOCK)
+        {
+            if (error != EINTR)
+            {
+                struct pollfd pfd = {fd, POLLOUT, 0};
+                if (poll(&pfd, 1, -1) < 0 && errno != EINTR)
+                {
+                    error = errno;
+                }
+            }
+            if (error == EINTR || error == EAGAIN || error == EWOULDBLOCK)
+            {
+                pthread_mutex_lock(&tx_lock);
+                continue;
+            }
+        }
+
+        if (error)
+        {
+            // Skipping part of the queue could cut a frame, so the thread stops instead
+            fprintf(stderr, "ERROR: Could not write to fd %d (%s), stopping TX thread\n", fd, strerror(error));
+        }
+
+        if (callback)
+        {
+            callback(bytesWritten);
+        }
+
+        pthread_mutex_lock(&tx_lock);
+
+        if (error)
+        {
+            // Blocked producers and flush() return -1 from now on
+            tx_error.store(error, std::memory_order_relaxed);
+            tx_tail = tx_head;
+            pthread_cond_broadcast(&tx_cond);
+            break;
+        }
+
+        tx_tail += bytesWritten;
+        pthread_cond_broadcast(&tx_cond);
+    }
+
+    pthread_mutex_unlock(&tx_lock);
+}
+
+/**
+ * @brief Точка входа потока передачи.
+ * 
+ * @param args Указатель на объект Serial_Port.
+ * @return void* Всегда NULL.
+ */
+void *Serial_Port::_start_tx_thread(void *args)
+{
+    Serial_Port *port = (Serial_Port *)args;
+    port->_tx_loop();
+    return NULL;
 }
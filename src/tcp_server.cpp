@@ -19,11 +19,16 @@ TCP_Server::TCP_Server() { initialize_defaults(); }
 /**
  * @brief Деструктор класса TCP_Server.
  * 
- * Уничтожает мьютекс.
+ * Закрывает оставшиеся соединения и уничтожает мьютексы.
  */
 TCP_Server::~TCP_Server() {
+  if (is_open) {
+    stop();
+  }
+
   // destroy mutex
   pthread_mutex_destroy(&lock);
+  pthread_mutex_destroy(&tx_lock);
 }
 
 /**
@@ -35,9 +40,19 @@ void TCP_Server::initialize_defaults() {
   is_open = false;
   debug = false;
   sockfd = -1;
+  epfd = -1;
+  next_client = 0;
+  slow_client_policy = SLOW_CLIENT_DISCONNECT;
+  max_buffered_bytes = 64 * 1024;
+  client_relay = false;
+  io_engine = IO_ENGINE_SYSCALL;
+  next_client_id = 1;
 
   // Start mutex
   int result = pthread_mutex_init(&lock, NULL);
+  if (result == 0) {
+    result = pthread_mutex_init(&tx_lock, NULL);
+  }
   if (result != 0) {
     printf("\n mutex init failed\n");
     throw 1;
@@ -45,38 +60,15 @@ void TCP_Server::initialize_defaults() {
 }
 
 /**
- * @brief Читает сообщение из TCP соединения.
+ * @brief Читает сообщение от любого из клиентов.
  * 
  * @param message Ссылка на объект сообщения Mavlink, в который будет записано прочитанное сообщение.
  * @return int Возвращает true, если сообщение было успешно прочитано.
  */
 int TCP_Server::read_message(mavlink_message_t &message) {
-  uint8_t cp;
-  mavlink_status_t status;
-  uint8_t msgReceived = false;
-
-  // this function locks the port during read
-  int result = _read_port(cp);
-
-  if (result > 0) {
-    // the parsing
-    msgReceived = mavlink_parse_char(MAVLINK_COMM_1, cp, &message, &status);
-
-    // check for dropped packets
-    if ((lastStatus.packet_rx_drop_count != status.packet_rx_drop_count) &&
-        debug) {
-      printf("ERROR: DROPPED %d PACKETS\n", status.packet_rx_drop_count);
-      unsigned char v = cp;
-      fprintf(stderr, "%02x ", v);
-    }
-    lastStatus = status;
-  }
-
-  // Couldn't read from port
-  else {
-    fprintf(stderr, "ERROR: Could not read, res = %d, errno = %d : %m\n",
-            result, errno);
-  }
+  // every client has its own parser, so a single message is taken
+  // from the bulk path instead of parsing byte by byte here
+  uint8_t msgReceived = read_messages(&message, 1) > 0;
 
   if (msgReceived && debug) {
     // Report info
@@ -111,45 +103,241 @@ int TCP_Server::read_message(mavlink_message_t &message) {
 }
 
 /**
- * @brief Записывает сообщение в TCP соединение.
+ * @brief Читает все сообщения из данных, готовых на соединениях клиентов.
+ * 
+ * @param messages Массив, в который будут записаны прочитанные сообщения.
+ * @param max_messages Размер массива messages.
+ * @return int Количество прочитанных сообщений или -1 при ошибке ожидания.
+ */
+int TCP_Server::read_messages(mavlink_message_t *messages, int max_messages) {
+  return read_messages(messages, NULL, max_messages);
+}
+
+/**
+ * @brief Читает сообщения вместе с их исходными байтами в буферах клиентов.
+ * 
+ * @param messages Массив, в который будут записаны прочитанные сообщения.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массивов.
+ * @return int Количество прочитанных сообщений или -1 при ошибке ожидания.
+ */
+int TCP_Server::read_messages(mavlink_message_t *messages, Raw_Frame *frames,
+                              int max_messages) {
+  // Lock
+  pthread_mutex_lock(&lock);
+
+  // frames handed out by the previous call are no longer referenced
+  _release_retired();
+
+  // bytes left over from the previous call go first
+  int count = _parse_clients(messages, frames, max_messages);
+  if (count > 0) {
+    pthread_mutex_unlock(&lock);
+    return count;
+  }
+
+  // io_uring delivers connections and data itself, no readiness events
+  if (uring.is_ready()) {
+    int result = _wait_uring();
+    if (result > 0) {
+      count = _parse_clients(messages, frames, max_messages);
+    }
+    _remove_closed_clients();
+    pthread_mutex_unlock(&lock);
+
+    if (result < 0) {
+      fprintf(stderr, "ERROR: Could not read, res = %d\n", result);
+      return -1;
+    }
+    return count;
+  }
+
+  struct epoll_event events[MAX_EVENTS];
+  int result = epoll_wait(epfd, events, MAX_EVENTS, -1);
+
+  for (int i = 0; i < result; i++) {
+    Client *client = (Client *)events[i].data.ptr;
+
+    // the listening socket is registered without a client
+    if (client == NULL) {
+      _accept_clients();
+      continue;
+    }
+
+    if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+      _read_client(client);
+    }
+
+    if (events[i].events & EPOLLOUT) {
+      pthread_mutex_lock(&tx_lock);
+      _send_pending(client);
+      pthread_mutex_unlock(&tx_lock);
+    }
+  }
+
+  if (result > 0) {
+    count = _parse_clients(messages, frames, max_messages);
+  }
+
+  _remove_closed_clients();
+
+  // Unlock
+  pthread_mutex_unlock(&lock);
+
+  // Couldn't wait for events
+  if (result < 0 && errno != EINTR) {
+    fprintf(stderr, "ERROR: Could not read, res = %d, errno = %d : %m\n",
+            result, errno);
+    return -1;
+  }
+
+  return count;
+}
+
+/**
+ * @brief Рассылает сообщение всем подключенным клиентам.
  * 
  * @param message Константная ссылка на объект сообщения Mavlink, которое будет отправлено.
- * @return int Количество байт, записанных в соединение.
+ * @return int Длина сообщения, 0 если клиентов нет, -1 если ни один клиент его не принял.
  */
 int TCP_Server::write_message(const mavlink_message_t &message) {
-  char buf[300];
+  uint8_t buf[MAVLINK_MAX_PACKET_LEN];
 
   // Translate message to buffer
-  unsigned len = mavlink_msg_to_send_buffer((uint8_t *)buf, &message);
+  unsigned len = mavlink_msg_to_send_buffer(buf, &message);
+
+  return write_raw(buf, len);
+}
+
+/**
+ * @brief Рассылает готовые кадры всем подключенным клиентам.
+ * 
+ * @param buf Байты кадров.
+ * @param len Длина данных.
+ * @return int len, 0 если клиентов нет, -1 если ни один клиент данные не принял.
+ */
+int TCP_Server::write_raw(const uint8_t *buf, unsigned len) {
+  pthread_mutex_lock(&tx_lock);
+  bool has_clients = !clients.empty();
+  int delivered = _write_clients(buf, len, NULL);
+  pthread_mutex_unlock(&tx_lock);
+
+  if (!has_clients) {
+    return 0;
+  }
+  if (delivered == 0) {
+    fprintf(stderr, "ERROR: Could not write to any of the TCP clients\n");
+    return -1;
+  }
+
+  return len;
+}
 
-  // Write buffer to TCP port, locks port while writing
-  int bytesWritten = _write_port(buf, len);
-  if (bytesWritten < 0) {
-    fprintf(stderr, "ERROR: Could not write, res = %d, errno = %d : %m\n",
-            bytesWritten, errno);
+/**
+ * @brief Устанавливает поведение при переполнении буфера передачи клиента.
+ * 
+ * @param policy Отключать медленного клиента или пропускать его сообщения.
+ * @param max_buffered_bytes_ Максимальный объем неотправленных данных одного клиента.
+ */
+void TCP_Server::set_slow_client_policy(Slow_Client_Policy policy,
+                                        int max_buffered_bytes_) {
+  pthread_mutex_lock(&tx_lock);
+  slow_client_policy = policy;
+  max_buffered_bytes = max_buffered_bytes_;
+  pthread_mutex_unlock(&tx_lock);
+}
+
+/**
+ * @brief Включает пересылку сообщений, принятых от клиента, остальным клиентам.
+ * 
+ * @param relay true - пересылать.
+ */
+void TCP_Server::set_client_relay(bool relay) { client_relay = relay; }
+
+/**
+ * @brief Выбирает механизм ввода-вывода.
+ * 
+ * @param engine Механизм ввода-вывода.
+ * @return true если механизм выбран.
+ */
+bool TCP_Server::set_io_engine(Io_Engine engine) {
+  if (is_open) {
+    fprintf(stderr, "ERROR: io engine can only be changed before start\n");
+    return false;
+  }
+
+  io_engine = engine;
+  return true;
+}
+
+/**
+ * @brief Возвращает количество подключенных клиентов.
+ * 
+ * @return int Количество клиентов.
+ */
+int TCP_Server::get_client_count() {
+  pthread_mutex_lock(&tx_lock);
+  int count = clients.size();
+  pthread_mutex_unlock(&tx_lock);
+
+  return count;
+}
+
+/**
+ * @brief Возвращает количество принятых байт всех клиентов, ожидающих разбора.
+ * 
+ * @return int Количество байт.
+ */
+int TCP_Server::rx_pending() {
+  pthread_mutex_lock(&lock);
+
+  int pending = 0;
+  for (size_t i = 0; i < clients.size(); i++) {
+    pending += clients[i]->rx_len - clients[i]->rx_ptr;
+    for (size_t j = 0; j < clients[i]->rx_chunks.size(); j++) {
+      pending += clients[i]->rx_chunks[j].result;
+    }
+  }
+
+  pthread_mutex_unlock(&lock);
+
+  // completions not handed out yet
+  if (uring.is_ready()) {
+    pending += uring.ready_count();
   }
 
-  return bytesWritten;
+  return pending;
 }
 
 /**
- * @brief Запускает TCP сервер и ожидает подключения клиента.
+ * @brief Запускает TCP сервер, не дожидаясь подключения клиентов.
  */
 void TCP_Server::start() {
 
   /* Create socket */
-  int  len;
-  struct sockaddr_in servaddr, cli;
+  struct sockaddr_in servaddr;
+
+  // io_uring waits for blocking sockets itself, epoll needs them non-blocking
+  if (io_engine == IO_ENGINE_URING && !uring.init(BUFF_LEN)) {
+    fprintf(stderr, "WARNING: io_uring setup failed, using system calls\n");
+    uring.release();
+  }
+  uring.set_submit_batch(MAX_EVENTS);
+  int type = uring.is_ready() ? SOCK_STREAM : SOCK_STREAM | SOCK_NONBLOCK;
 
   // socket create and verification
-  sockfd = socket(AF_INET, SOCK_STREAM, 0);
+  sockfd = socket(AF_INET, type, 0);
   if (sockfd == -1) {
     printf("socket creation failed...\n");
-    exit(0);
+    throw EXIT_FAILURE;
   } else
     printf("Socket successfully created..\n");
   bzero(&servaddr, sizeof(servaddr));
 
+  // allow a restart while old connections are in TIME_WAIT
+  int reuse = 1;
+  setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
   // assign IP, PORT
   servaddr.sin_family = AF_INET;
   servaddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -158,36 +346,80 @@ void TCP_Server::start() {
   // Binding newly created socket to given IP and verification
   if ((bind(sockfd, (sockaddr *)&servaddr, sizeof(servaddr))) != 0) {
     printf("socket bind failed...\n");
-    exit(0);
+    close(sockfd);
+    sockfd = -1;
+    throw EXIT_FAILURE;
   } else
     printf("Socket successfully binded..\n");
 
   // Now server is ready to listen and verification
-  if ((listen(sockfd, 5)) != 0) {
+  if ((listen(sockfd, SOMAXCONN)) != 0) {
     printf("Listen failed...\n");
-    exit(0);
+    close(sockfd);
+    sockfd = -1;
+    throw EXIT_FAILURE;
   } else
     printf("Server listening..\n");
-  len = sizeof(cli);
 
-  // Accept the data packet from client and verification
-  socklen_t l = len;
-  connfd = accept(sockfd, (sockaddr *)&cli, &l);
-  if (connfd < 0) {
-    printf("server accept failed...\n");
-    exit(0);
-  } else
-    printf("server accept the client...\n");
+  // Clients are accepted by read_message() as they connect
+  if (uring.is_ready()) {
+    if (uring.accept(sockfd, 0)) {
+      lastStatus.packet_rx_drop_count = 0;
+      is_open = true;
+      return;
+    }
+
+    fprintf(stderr, "WARNING: io_uring accept failed, using system calls\n");
+    uring.release();
+    fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL) | O_NONBLOCK);
+  }
+
+  epfd = epoll_create1(EPOLL_CLOEXEC);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;
+  if (epfd < 0 || epoll_ctl(epfd, EPOLL_CTL_ADD, sockfd, &event) != 0) {
+    printf("epoll setup failed...\n");
+    close(sockfd);
+    sockfd = -1;
+    throw EXIT_FAILURE;
+  }
+
+  lastStatus.packet_rx_drop_count = 0;
+  is_open = true;
 
   return;
 }
 
 /**
- * @brief Останавливает TCP сервер и закрывает соединение.
+ * @brief Останавливает TCP сервер и закрывает все соединения.
  */
 void TCP_Server::stop() {
   printf("CLOSE PORT\n");
 
+  // the RX thread reads through this port, it has to end first
+  stop_rx_thread();
+
+  // pending requests are cancelled before their sockets are closed
+  uring.release();
+
+  pthread_mutex_lock(&tx_lock);
+  for (size_t i = 0; i < clients.size(); i++) {
+    close(clients[i]->fd);
+    delete clients[i];
+  }
+  clients.clear();
+  pthread_mutex_unlock(&tx_lock);
+
+  // the ring is gone, its buffers need no recycling
+  uring_spent.clear();
+  _release_retired();
+
+  if (epfd >= 0) {
+    close(epfd);
+  }
+  epfd = -1;
+
   int result = close(sockfd);
   sockfd = -1;
 
@@ -201,63 +433,421 @@ void TCP_Server::stop() {
 }
 
 /**
- * @brief Читает байт из TCP соединения.
+ * @brief Принимает все ожидающие подключения.
+ */
+void TCP_Server::_accept_clients() {
+  while (true) {
+    struct sockaddr_in cli;
+    socklen_t len = sizeof(cli);
+    int fd = accept4(sockfd, (sockaddr *)&cli, &len, SOCK_NONBLOCK);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        printf("server accept failed...\n");
+      }
+      return;
+    }
+
+    _add_client(fd, cli);
+  }
+}
+
+/**
+ * @brief Регистрирует принятое соединение.
  * 
- * @param cp Ссылка на переменную, в которую будет записан прочитанный байт.
- * @return int Результат операции чтения.
+ * @param fd Сокет клиента.
+ * @param cli Адрес клиента.
  */
-int TCP_Server::_read_port(uint8_t &cp) {
+void TCP_Server::_add_client(int fd, const struct sockaddr_in &cli) {
+  Client *client = new Client();
+  client->fd = fd;
+  client->id = next_client_id++;
+  snprintf(client->name, sizeof(client->name), "%s:%d",
+           inet_ntoa(cli.sin_addr), ntohs(cli.sin_port));
+  client->rx_ptr = 0;
+  client->rx_len = 0;
+  client->rx_data = client->rx_buff;
+  client->rx_buffer = -1;
+  memset(&client->rx_status, 0, sizeof(client->rx_status));
+  client->want_write = false;
+  client->closing = false;
+  client->dropped = 0;
+
+  bool watched;
+  if (uring.is_ready()) {
+    watched = uring.recv(fd, client->id, Uring_Engine::RECV_STREAM);
+  } else {
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    watched = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &event) == 0;
+  }
+  if (!watched) {
+    printf("server accept failed...\n");
+    close(fd);
+    delete client;
+    return;
+  }
 
-  socklen_t len;
+  pthread_mutex_lock(&tx_lock);
+  clients.push_back(client);
+  pthread_mutex_unlock(&tx_lock);
 
-  // Lock
-  pthread_mutex_lock(&lock);
+  printf("server accept the client %s...\n", client->name);
+}
 
-  int result = -1;
-  if (buff_ptr < buff_len) {
-    cp = buff[buff_ptr];
-    buff_ptr++;
-    result = 1;
-  } else {
-    // struct sockaddr_in addr;
-    len = sizeof(struct sockaddr_in);
-    result = read(connfd, buff, sizeof(buff));
+/**
+ * @brief Дожидается результатов io_uring и раздает их клиентам.
+ * 
+ * @return int Количество результатов или -1 при ошибке ожидания.
+ */
+int TCP_Server::_wait_uring() {
+  Uring_Engine::Completion completions[MAX_EVENTS];
+  int result = uring.wait(completions, MAX_EVENTS, -1);
 
-    if (result > 0) {
-      buff_len = result;
-      buff_ptr = 0;
-      cp = buff[buff_ptr];
-      buff_ptr++;
-      // printf("recvfrom: %i %i\n", result, cp);
+  for (int i = 0; i < result; i++) {
+    Uring_Engine::Completion &completion = completions[i];
+
+    if (completion.kind == Uring_Engine::COMPLETION_ACCEPT) {
+      if (completion.result < 0) {
+        printf("server accept failed...\n");
+        continue;
+      }
+
+      struct sockaddr_in cli;
+      socklen_t len = sizeof(cli);
+      memset(&cli, 0, sizeof(cli));
+      getpeername(completion.result, (sockaddr *)&cli, &len);
+      _add_client(completion.result, cli);
+      continue;
     }
-  }
 
-  // Unlock
-  pthread_mutex_unlock(&lock);
+    Client *client = _find_client(completion.tag);
+
+    // data for a client that is gone or an end of its stream
+    if (client == NULL || client->closing || completion.kind != Uring_Engine::COMPLETION_RECV ||
+        completion.result <= 0) {
+      uring.recycle(completion.buffer);
+      if (client != NULL) {
+        pthread_mutex_lock(&tx_lock);
+        client->closing = true;
+        pthread_mutex_unlock(&tx_lock);
+      }
+      continue;
+    }
+
+    client->rx_chunks.push_back(completion);
+  }
 
   return result;
 }
 
 /**
- * @brief Записывает данные в TCP соединение.
+ * @brief Находит клиента по метке io_uring.
+ * 
+ * @param id Метка клиента.
+ * @return Client* Клиент или NULL, если он уже отключен.
+ */
+TCP_Server::Client *TCP_Server::_find_client(uint64_t id) {
+  for (size_t i = 0; i < clients.size(); i++) {
+    if (clients[i]->id == id) {
+      return clients[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * @brief Переходит к следующей принятой через io_uring порции данных клиента.
+ * 
+ * @param client Клиент.
+ * @return true если есть данные для разбора.
+ */
+bool TCP_Server::_next_chunk(Client *client) {
+  if (client->rx_ptr < client->rx_len) {
+    return true;
+  }
+
+  // the parsed chunk goes back to the kernel on the next read
+  if (client->rx_buffer >= 0) {
+    uring_spent.push_back(client->rx_buffer);
+    client->rx_buffer = -1;
+  }
+  if (client->rx_chunks.empty()) {
+    return false;
+  }
+
+  Uring_Engine::Completion &chunk = client->rx_chunks.front();
+  client->rx_data = chunk.data;
+  client->rx_buffer = chunk.buffer;
+  client->rx_ptr = 0;
+  client->rx_len = chunk.result;
+  client->rx_chunks.pop_front();
+
+  return true;
+}
+
+/**
+ * @brief Читает данные клиента в его буфер.
+ * 
+ * @param client Клиент.
+ */
+void TCP_Server::_read_client(Client *client) {
+  // the previous chunk is not parsed yet, epoll will report the socket again
+  if (client->rx_ptr < client->rx_len) {
+    return;
+  }
+
+  int result = read(client->fd, client->rx_buff, BUFF_LEN);
+
+  if (result > 0) {
+    client->rx_len = result;
+    client->rx_ptr = 0;
+  } else if (result == 0 || (errno != EAGAIN && errno != EWOULDBLOCK &&
+                             errno != EINTR)) {
+    pthread_mutex_lock(&tx_lock);
+    client->closing = true;
+    pthread_mutex_unlock(&tx_lock);
+  }
+}
+
+/**
+ * @brief Разбирает накопленные данные клиентов.
+ * 
+ * @param messages Массив для найденных сообщений.
+ * @param frames Массив кадров того же размера или NULL.
+ * @param max_messages Размер массива messages.
+ * @return int Количество найденных сообщений.
+ */
+int TCP_Server::_parse_clients(mavlink_message_t *messages, Raw_Frame *frames,
+                               int max_messages) {
+  int count = 0;
+  int total = clients.size();
+
+  // start from a different client every call so none of them starves
+  for (int n = 0; n < total && count < max_messages; n++) {
+    Client *client = clients[(next_client + n) % total];
+
+    // io_uring may have queued several chunks, a message can span them
+    while (count < max_messages && _next_chunk(client)) {
+      int found = _parse_buffer(client->rx_data, client->rx_len, client->rx_ptr,
+                                messages + count,
+                                frames ? frames + count : NULL,
+                                max_messages - count, &client->rx_msg, &client->rx_status);
+
+      if (client_relay && found > 0) {
+        pthread_mutex_lock(&tx_lock);
+        for (int i = count; i < count + found; i++) {
+          uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+          unsigned len = mavlink_msg_to_send_buffer(buf, &messages[i]);
+          _write_clients(buf, len, client);
+        }
+        pthread_mutex_unlock(&tx_lock);
+      }
+
+      count += found;
+    }
+  }
+
+  if (total > 0) {
+    next_client = (next_client + 1) % total;
+  }
+
+  return count;
+}
+
+/**
+ * @brief Отключает клиентов, помеченных на закрытие.
+ */
+void TCP_Server::_remove_closed_clients() {
+  pthread_mutex_lock(&tx_lock);
+
+  for (size_t i = 0; i < clients.size();) {
+    Client *client = clients[i];
+    if (!client->closing) {
+      i++;
+      continue;
+    }
+
+    printf("client %s disconnected (%lu messages dropped)\n", client->name,
+           client->dropped);
+    if (uring.is_ready()) {
+      // buffers of unparsed chunks go back to the kernel
+      uring.cancel(client->fd);
+      uring_spent.push_back(client->rx_buffer);
+      for (size_t j = 0; j < client->rx_chunks.size(); j++) {
+        uring_spent.push_back(client->rx_chunks[j].buffer);
+      }
+    } else {
+      epoll_ctl(epfd, EPOLL_CTL_DEL, client->fd, NULL);
+    }
+    close(client->fd);
+    clients.erase(clients.begin() + i);
+    retired.push_back(client);
+  }
+
+  pthread_mutex_unlock(&tx_lock);
+}
+
+/**
+ * @brief Освобождает буферы и клиентов, отложенные до следующего чтения.
+ */
+void TCP_Server::_release_retired() {
+  for (size_t i = 0; i < uring_spent.size(); i++) {
+    uring.recycle(uring_spent[i]);
+  }
+  uring_spent.clear();
+
+  for (size_t i = 0; i < retired.size(); i++) {
+    delete retired[i];
+  }
+  retired.clear();
+}
+
+/**
+ * @brief Передает клиенту данные или ставит их в его очередь.
+ * 
+ * @param client Клиент.
+ * @param buf Буфер с данными.
+ * @param len Длина данных.
+ * @return true если данные переданы или поставлены в очередь.
+ * @return false если клиент отключается или сообщение пропущено.
+ */
+bool TCP_Server::_queue_client(Client *client, const uint8_t *buf,
+                               unsigned len) {
+  if (client->closing) {
+    return false;
+  }
+
+  // the ring keeps the stream order, a full slot pool counts as a slow client
+  if (uring.is_ready()) {
+    if (uring.stream_pending(client->fd) + len <= (unsigned)max_buffered_bytes &&
+        uring.send(client->fd, client->id, buf, len, NULL, false) >= 0) {
+      return true;
+    }
+    return _slow_client(client);
+  }
+
+  // older data goes first
+  _send_pending(client);
+
+  unsigned sent = 0;
+  if (client->tx_buff.empty()) {
+    int result = send(client->fd, buf, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      client->closing = true;
+      return false;
+    }
+    sent = result > 0 ? result : 0;
+  }
+
+  if (sent == len) {
+    return true;
+  }
+
+  // the client does not keep up with the stream; once a part of the buffer went out
+  // the rest is queued anyway, a cut frame would desync the client, and the limit
+  // applies to the next write
+  if (sent == 0 &&
+      client->tx_buff.size() + len > (size_t)max_buffered_bytes) {
+    return _slow_client(client);
+  }
+
+  client->tx_buff.insert(client->tx_buff.end(), buf + sent, buf + len);
+  _watch_write(client, true);
+
+  return true;
+}
+
+/**
+ * @brief Применяет к клиенту поведение при переполнении буфера передачи.
+ * 
+ * @param client Клиент.
+ * @return false всегда: сообщение клиенту не передано.
+ */
+bool TCP_Server::_slow_client(Client *client) {
+  if (slow_client_policy == SLOW_CLIENT_DROP) {
+    client->dropped++;
+    return false;
+  }
+
+  printf("client %s is too slow, disconnecting\n", client->name);
+  client->closing = true;
+  // wakes up the reader, which removes the client
+  shutdown(client->fd, SHUT_RDWR);
+  return false;
+}
+
+/**
+ * @brief Отправляет накопленные данные клиента.
+ * 
+ * @param client Клиент.
+ */
+void TCP_Server::_send_pending(Client *client) {
+  if (client->tx_buff.empty() || client->closing) {
+    return;
+  }
+
+  int result = send(client->fd, client->tx_buff.data(), client->tx_buff.size(),
+                    MSG_NOSIGNAL | MSG_DONTWAIT);
+  if (result < 0) {
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+      client->closing = true;
+    }
+    return;
+  }
+
+  client->tx_buff.erase(client->tx_buff.begin(),
+                        client->tx_buff.begin() + result);
+  if (client->tx_buff.empty()) {
+    _watch_write(client, false);
+  }
+}
+
+/**
+ * @brief Подписывает сокет клиента на EPOLLOUT или отписывает от него.
+ * 
+ * @param client Клиент.
+ * @param want_write Нужна ли подписка.
+ */
+void TCP_Server::_watch_write(Client *client, bool want_write) {
+  if (client->want_write == want_write) {
+    return;
+  }
+
+  struct epoll_event event;
+  event.events = want_write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+  event.data.ptr = client;
+  epoll_ctl(epfd, EPOLL_CTL_MOD, client->fd, &event);
+  client->want_write = want_write;
+}
+
+/**
+ * @brief Рассылает данные клиентам.
  * 
  * @param buf Буфер с данными для записи.
  * @param len Длина данных для записи.
- * @return int Количество записанных байт.
+ * @param except Клиент, которому данные не отправляются, или NULL.
+ * @return int Количество клиентов, принявших данные.
  */
-int TCP_Server::_write_port(char *buf, unsigned len) {
-
-  // Lock
-  pthread_mutex_lock(&lock);
+int TCP_Server::_write_clients(const uint8_t *buf, unsigned len,
+                               Client *except) {
+  int delivered = 0;
 
-  // Write packet via TCP link
-  int bytesWritten = 0;
+  for (size_t i = 0; i < clients.size(); i++) {
+    if (clients[i] != except && _queue_client(clients[i], buf, len)) {
+      delivered++;
+    }
+  }
 
-  bytesWritten = write(connfd, buff, sizeof(buff));
-  printf("sendto: %i\n", bytesWritten);
+  // one io_uring_enter() for the whole fan-out
+  if (uring.is_ready()) {
+    uring.submit();
+  }
 
-  // Unlock
-  pthread_mutex_unlock(&lock);
+  if (debug) {
+    printf("sendto: %u bytes to %d clients\n", len, delivered);
+  }
 
-  return bytesWritten;
+  return delivered;
 }
@@ -0,0 +1,178 @@
+#include "telemetry_cache.h"
+#include "message_entries.h"
+
+/**
+ * @brief Конструктор класса Telemetry_Cache.
+ *
+ * @param capacity Наибольшее количество различных (sysid, compid, msgid).
+ */
+Telemetry_Cache::Telemetry_Cache(int capacity)
+{
+    unsigned size = 1;
+    while ((int)size < capacity)
+    {
+        size <<= 1;
+    }
+
+    entries = new Entry[size];
+    mask = size - 1;
+    full_reported = false;
+
+    for (unsigned i = 0; i < size; i++)
+    {
+        entries[i].key.store(0, std::memory_order_relaxed);
+        entries[i].sequence.store(0, std::memory_order_relaxed);
+        entries[i].updates = 0;
+        entries[i].timestamp_us = 0;
+    }
+
+    if (pthread_mutex_init(&write_lock, NULL) != 0)
+    {
+        printf("\n mutex init failed\n");
+        throw 1;
+    }
+}
+
+/**
+ * @brief Деструктор класса Telemetry_Cache.
+ */
+Telemetry_Cache::~Telemetry_Cache()
+{
+    pthread_mutex_destroy(&write_lock);
+    delete[] entries;
+}
+
+/**
+ * @brief Сохраняет сообщение как последнее значение своего ключа.
+ *
+ * @param message Сообщение.
+ * @return true если сообщение сохранено, false если в таблице нет места.
+ */
+bool Telemetry_Cache::update(const mavlink_message_t &message)
+{
+    uint64_t key = _key(message.sysid, message.compid, message.msgid);
+    uint64_t timestamp = now_us();
+
+    pthread_mutex_lock(&write_lock);
+
+    Entry *entry = _find(key);
+    if (entry == NULL)
+    {
+        if (!full_reported)
+        {
+            fprintf(stderr, "WARNING: telemetry cache is full, message #%d is not cached\n", message.msgid);
+            full_reported = true;
+        }
+        pthread_mutex_unlock(&write_lock);
+        return false;
+    }
+
+    // odd sequence tells readers the entry is being written
+    uint32_t sequence = entry->sequence.load(std::memory_order_relaxed);
+    entry->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // only the used part of the payload is copied
+    memcpy(&entry->message, &message, offsetof(mavlink_message_t, payload64) + message.len);
+    entry->updates++;
+    entry->timestamp_us = timestamp;
+
+    entry->sequence.store(sequence + 2, std::memory_order_release);
+
+    // a new key is published after its first value
+    if (entry->key.load(std::memory_order_relaxed) != key)
+    {
+        entry->key.store(key, std::memory_order_release);
+    }
+
+    pthread_mutex_unlock(&write_lock);
+
+    return true;
+}
+
+/**
+ * @brief Копирует последнее значение сообщения.
+ *
+ * @param sysid Идентификатор системы.
+ * @param compid Идентификатор компонента.
+ * @param msgid Идентификатор сообщения.
+ * @param snapshot Снимок записи.
+ * @return true если сообщение уже принималось.
+ */
+bool Telemetry_Cache::get(uint8_t sysid, uint8_t compid, uint32_t msgid, Snapshot &snapshot)
+{
+    uint64_t key = _key(sysid, compid, msgid);
+
+    Entry *entry = _find(key);
+    if (entry == NULL || entry->key.load(std::memory_order_acquire) != key)
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        uint32_t sequence = entry->sequence.load(std::memory_order_acquire);
+        if (sequence & 1)
+        {
+            continue;
+        }
+
+        // the header first, it tells how much payload there is
+        memcpy(&snapshot.message, &entry->message, offsetof(mavlink_message_t, payload64));
+        unsigned len = snapshot.message.len;
+        if (len > MAVLINK_MAX_PAYLOAD_LEN)
+        {
+            len = MAVLINK_MAX_PAYLOAD_LEN;
+        }
+        memcpy(snapshot.message.payload64, entry->message.payload64, len);
+        snapshot.timestamp_us = entry->timestamp_us;
+        snapshot.updates = entry->updates;
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry->sequence.load(std::memory_order_relaxed) == sequence)
+        {
+            snapshot.message.len = len;
+            break;
+        }
+    }
+
+    // decoders read the whole message, including the zeros cut off on the wire
+    const mavlink_msg_entry_t *msg_entry = Message_Entries::find(msgid);
+    unsigned full_len = msg_entry ? msg_entry->max_msg_len : MAVLINK_MAX_PAYLOAD_LEN;
+    unsigned len = snapshot.message.len;
+    if (full_len > len)
+    {
+        memset((uint8_t *)snapshot.message.payload64 + len, 0, full_len - len);
+    }
+
+    // the cache keeps neither the checksum bytes nor the signature
+    snapshot.message.ck[0] = snapshot.message.checksum & 0xff;
+    snapshot.message.ck[1] = snapshot.message.checksum >> 8;
+    memset(snapshot.message.signature, 0, sizeof(snapshot.message.signature));
+
+    return true;
+}
+
+/**
+ * @brief Ищет запись ключа или свободную запись, в которую его можно поместить.
+ *
+ * @param key Ключ.
+ * @return Entry* Запись или NULL, если ключа нет и свободных записей не осталось.
+ */
+Telemetry_Cache::Entry *Telemetry_Cache::_find(uint64_t key)
+{
+    // 64-bit mix, neighbouring msgids land in different slots
+    uint64_t hash = key * 0x9E3779B97F4A7C15ULL;
+    unsigned index = (unsigned)(hash >> 32) & mask;
+
+    for (unsigned probe = 0; probe <= mask; probe++)
+    {
+        Entry *entry = &entries[(index + probe) & mask];
+        uint64_t entry_key = entry->key.load(std::memory_order_acquire);
+        if (entry_key == key || entry_key == 0)
+        {
+            return entry;
+        }
+    }
+    return NULL;
+}
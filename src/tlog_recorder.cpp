@@ -0,0 +1,453 @@
+#include "tlog_recorder.h"
+
+/**
+ * @brief Конструктор класса Tlog_Recorder.
+ *
+ * @param capacity Емкость очереди в кадрах (округляется до степени двойки).
+ */
+Tlog_Recorder::Tlog_Recorder(int capacity)
+{
+    unsigned size = 1;
+    while ((int)size < capacity)
+    {
+        size <<= 1;
+    }
+
+    slots = new Slot[size];
+    mask = size - 1;
+    for (unsigned i = 0; i < size; i++)
+    {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    head = 0;
+    tail = 0;
+
+    frames = 0;
+    dropped = 0;
+    bytes = 0;
+    files = 0;
+
+    max_bytes = 0;
+    max_seconds = 0;
+    direct_io = false;
+
+    fd = -1;
+    file_bytes = 0;
+    file_opened_ms = 0;
+    buffer_len = 0;
+    last_write_ms = 0;
+    if (posix_memalign((void **)&buffer, DIRECT_ALIGN, BUFFER_LEN) != 0)
+    {
+        printf("\n recorder buffer allocation failed\n");
+        throw 1;
+    }
+
+    running = false;
+    writer_created = false;
+}
+
+/**
+ * @brief Деструктор класса Tlog_Recorder.
+ */
+Tlog_Recorder::~Tlog_Recorder()
+{
+    stop();
+    free(buffer);
+    delete[] slots;
+}
+
+/**
+ * @brief Задает условия перехода к новому файлу.
+ *
+ * @param max_bytes Размер файла, после которого начинается новый, байт, 0 - без ограничения.
+ * @param max_seconds Наибольшая продолжительность файла, с, 0 - без ограничения.
+ */
+void Tlog_Recorder::set_rotation(unsigned long max_bytes, int max_seconds)
+{
+    this->max_bytes = max_bytes;
+    this->max_seconds = max_seconds;
+}
+
+/**
+ * @brief Включает запись в обход кеша страниц (O_DIRECT).
+ *
+ * @param enable true для O_DIRECT.
+ */
+void Tlog_Recorder::set_direct_io(bool enable)
+{
+    direct_io = enable;
+}
+
+/**
+ * @brief Открывает первый файл и запускает поток записи.
+ *
+ * @param prefix Путь и начало имени файлов.
+ * @return true если запись запущена.
+ */
+bool Tlog_Recorder::start(const char *prefix)
+{
+    if (writer_created)
+    {
+        fprintf(stderr, "WARNING: recorder is already started\n");
+        return false;
+    }
+
+    this->prefix = prefix;
+    if (!_open_file())
+    {
+        return false;
+    }
+
+    running = true;
+    if (pthread_create(&writer_thread, NULL, &Tlog_Recorder::_start_writer_thread, this) != 0)
+    {
+        running = false;
+        fprintf(stderr, "ERROR: Could not start recorder thread\n");
+        _close_file();
+        return false;
+    }
+    writer_created = true;
+
+    return true;
+}
+
+/**
+ * @brief Дописывает очередь в файл, закрывает его и останавливает поток записи.
+ */
+void Tlog_Recorder::stop()
+{
+    if (!writer_created)
+    {
+        return;
+    }
+
+    // the writer drains the queue before it exits
+    running = false;
+    pthread_join(writer_thread, NULL);
+    writer_created = false;
+}
+
+/**
+ * @brief Ставит сообщение в очередь записи.
+ *
+ * @param message Принятое сообщение.
+ * @return true если кадр поставлен в очередь.
+ */
+bool Tlog_Recorder::record(const mavlink_message_t &message)
+{
+    unsigned position;
+    Slot *slot = _reserve(position);
+    if (slot == NULL)
+    {
+        return false;
+    }
+
+    // serialized straight into the slot, the same bytes as on the link
+    unsigned len = mavlink_msg_to_send_buffer(slot->data + 8, &message);
+    _commit(slot, position, len);
+    return true;
+}
+
+/**
+ * @brief Ставит готовый кадр в очередь записи.
+ *
+ * @param frame Байты кадра.
+ * @param len Длина кадра, не больше MAVLINK_MAX_PACKET_LEN.
+ * @return true если кадр поставлен в очередь.
+ */
+bool Tlog_Recorder::record(const uint8_t *frame, unsigned len)
+{
+    if (len > MAVLINK_MAX_PACKET_LEN)
+    {
+        return false;
+    }
+
+    unsigned position;
+    Slot *slot = _reserve(position);
+    if (slot == NULL)
+    {
+        return false;
+    }
+
+    memcpy(slot->data + 8, frame, len);
+    _commit(slot, position, len);
+    return true;
+}
+
+/**
+ * @brief Возвращает статистику записи.
+ *
+ * @return Stats Статистика.
+ */
+Tlog_Recorder::Stats Tlog_Recorder::get_stats()
+{
+    Stats stats;
+    stats.frames = frames.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    stats.dropped = dropped.load(std::memory_order_relaxed);
+    stats.files = files.load(std::memory_order_relaxed);
+    return stats;
+}
+
+/**
+ * @brief Занимает ячейку очереди.
+ *
+ * @param position Позиция занятой ячейки.
+ * @return Slot* Ячейка или NULL, если очередь заполнена.
+ */
+Tlog_Recorder::Slot *Tlog_Recorder::_reserve(unsigned &position)
+{
+    if (!running.load(std::memory_order_relaxed))
+    {
+        return NULL;
+    }
+
+    // bounded multi-producer queue: a slot is free for position when its sequence equals position
+    position = head.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Slot *slot = &slots[position & mask];
+        unsigned sequence = slot->sequence.load(std::memory_order_acquire);
+        int difference = (int)(sequence - position);
+
+        if (difference == 0)
+        {
+            if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                return slot;
+            }
+        }
+        else if (difference < 0)
+        {
+            // the writer has not freed this slot yet, the queue is full
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+        else
+        {
+            position = head.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * @brief Заполняет время записи и передает ячейку потоку записи.
+ *
+ * @param slot Ячейка с кадром после 8 байт времени.
+ * @param position Позиция ячейки.
+ * @param frame_len Длина кадра.
+ */
+void Tlog_Recorder::_commit(Slot *slot, unsigned position, unsigned frame_len)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t timestamp = (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+    // tlog keeps the time big-endian
+    for (int i = 7; i >= 0; i--)
+    {
+        slot->data[i] = timestamp & 0xff;
+        timestamp >>= 8;
+    }
+    slot->len = 8 + frame_len;
+
+    frames.fetch_add(1, std::memory_order_relaxed);
+    slot->sequence.store(position + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Цикл потока записи.
+ */
+void Tlog_Recorder::_writer_loop()
+{
+    last_write_ms = _now_ms();
+
+    while (true)
+    {
+        bool stopping = !running.load(std::memory_order_acquire);
+        int count = _drain();
+
+        uint64_t now = _now_ms();
+        bool rotate = (max_bytes > 0 && file_bytes + buffer_len >= max_bytes) ||
+                      (max_seconds > 0 && now - file_opened_ms >= (uint64_t)max_seconds * 1000);
+
+        if (rotate && !stopping)
+        {
+            _close_file();
+            if (!_open_file())
+            {
+                break;
+            }
+        }
+        else if (buffer_len >= WRITE_LEN || (buffer_len > 0 && now - last_write_ms >= (uint64_t)FLUSH_INTERVAL_MS))
+        {
+            if (!_write_buffer(false))
+            {
+                break;
+            }
+        }
+
+        // producers that reserved a slot before the stop flag still get their frames written
+        if (stopping && count == 0 && head.load(std::memory_order_acquire) == tail)
+        {
+            break;
+        }
+
+        if (count == 0)
+        {
+            usleep(IDLE_SLEEP_US);
+        }
+    }
+
+    _close_file();
+}
+
+/**
+ * @brief Переносит записи из очереди в буфер.
+ *
+ * @return int Количество перенесенных записей.
+ */
+int Tlog_Recorder::_drain()
+{
+    int count = 0;
+
+    while (buffer_len + RECORD_MAX <= BUFFER_LEN)
+    {
+        Slot *slot = &slots[tail & mask];
+        if (slot->sequence.load(std::memory_order_acquire) != tail + 1)
+        {
+            break;
+        }
+
+        memcpy(buffer + buffer_len, slot->data, slot->len);
+        buffer_len += slot->len;
+
+        // the slot is free again one lap later
+        slot->sequence.store(tail + mask + 1, std::memory_order_release);
+        tail++;
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Записывает буфер в файл.
+ *
+ * @param all true чтобы записать и неполный последний блок O_DIRECT.
+ * @return bool false при ошибке записи.
+ */
+bool Tlog_Recorder::_write_buffer(bool all)
+{
+    unsigned len = buffer_len;
+
+    // O_DIRECT takes whole blocks, the tail waits for more records or for the file to close
+    if (direct_io && !all)
+    {
+        len -= len % DIRECT_ALIGN;
+    }
+    if (direct_io && all && len % DIRECT_ALIGN != 0)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    }
+
+    unsigned written = 0;
+    while (written < len)
+    {
+        ssize_t result = write(fd, buffer + written, len - written);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "ERROR: Could not write tlog, errno = %d : %m\n", errno);
+            return false;
+        }
+        written += result;
+    }
+
+    memmove(buffer, buffer + len, buffer_len - len);
+    buffer_len -= len;
+    file_bytes += len;
+    bytes.fetch_add(len, std::memory_order_relaxed);
+    last_write_ms = _now_ms();
+
+    return true;
+}
+
+/**
+ * @brief Открывает очередной файл.
+ *
+ * @return bool true если файл открыт.
+ */
+bool Tlog_Recorder::_open_file()
+{
+    std::string path = prefix + "_" + std::to_string(files.load()) + ".tlog";
+
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (direct_io)
+    {
+        flags |= O_DIRECT;
+    }
+
+    fd = open(path.c_str(), flags, 0644);
+    if (fd < 0 && direct_io)
+    {
+        // tmpfs and some other file systems refuse O_DIRECT
+        fprintf(stderr, "WARNING: O_DIRECT is not supported for %s, writing through the page cache\n", path.c_str());
+        direct_io = false;
+        fd = open(path.c_str(), flags & ~O_DIRECT, 0644);
+    }
+    if (fd < 0)
+    {
+        fprintf(stderr, "ERROR: Could not open %s, errno = %d : %m\n", path.c_str(), errno);
+        return false;
+    }
+
+    files.fetch_add(1, std::memory_order_relaxed);
+    file_bytes = 0;
+    file_opened_ms = _now_ms();
+    return true;
+}
+
+/**
+ * @brief Дописывает буфер и закрывает текущий файл.
+ */
+void Tlog_Recorder::_close_file()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    _write_buffer(true);
+    close(fd);
+    fd = -1;
+    buffer_len = 0;
+}
+
+/**
+ * @brief Возвращает время по CLOCK_MONOTONIC.
+ *
+ * @return uint64_t Время, мс.
+ */
+uint64_t Tlog_Recorder::_now_ms()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Функция запуска потока записи.
+ *
+ * @param args Указатель на объект Tlog_Recorder.
+ * @return void* Всегда NULL.
+ */
+void *Tlog_Recorder::_start_writer_thread(void *args)
+{
+    Tlog_Recorder *recorder = (Tlog_Recorder *)args;
+    recorder->_writer_loop();
+    return NULL;
+}
@@ -1,5 +1,12 @@
 #include "udp_port.h"
 
+static uint64_t monotonic_us()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 UDP_Port::
 	UDP_Port(const char *target_ip_, int udp_port_)
 {
@@ -20,6 +27,8 @@ UDP_Port::
 {
 	// destroy mutex
 	pthread_mutex_destroy(&lock);
+	pthread_mutex_destroy(&tx_lock);
+	pthread_cond_destroy(&tx_cond);
 }
 
 void UDP_Port::
@@ -32,9 +41,49 @@ void UDP_Port::
 	is_open = false;
 	debug = false;
 	sock = -1;
+	buff_ptr = 0;
+	buff_len = 0;
+	rx_data = buff;
+	target_addr = INADDR_NONE;
+	rx_batch = 1;
+	rx_batch_count = 0;
+	rx_batch_index = 0;
+	io_engine = IO_ENGINE_SYSCALL;
+	uring_rx_count = 0;
+	uring_rx_index = 0;
+	tx_batch_count = 0;
+	tx_coalesce_bytes = 0;
+	tx_coalesce_deadline_us = 1000;
+	tx_pending_len = 0;
+	tx_pending_frames = 0;
+	tx_pending_since_us = 0;
+	tx_stats.datagrams = 0;
+	tx_stats.frames = 0;
+	tx_running = false;
+
+	// peer 0 is the target, its port is learned from the first packet
+	peers.assign(1, sockaddr_in());
+	peers[0].sin_family = AF_INET;
 
 	// Start mutex
 	int result = pthread_mutex_init(&lock, NULL);
+	if (result == 0)
+	{
+		result = pthread_mutex_init(&tx_lock, NULL);
+	}
+
+	// deadlines are measured with monotonic_us()
+	pthread_condattr_t cond_attr;
+	if (result == 0)
+	{
+		result = pthread_condattr_init(&cond_attr);
+	}
+	if (result == 0)
+	{
+		pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+		result = pthread_cond_init(&tx_cond, &cond_attr);
+		pthread_condattr_destroy(&cond_attr);
+	}
 	if (result != 0)
 	{
 		printf("\n mutex init failed\n");
@@ -55,7 +104,11 @@ int UDP_Port::
 	if (result > 0)
 	{
 		// the parsing
-		msgReceived = mavlink_parse_char(MAVLINK_COMM_1, cp, &message, &status);
+		msgReceived = _parse_char(&parse_buffer, &parse_status, cp, &message, &status);
+		if (msgReceived)
+		{
+			_publish(message);
+		}
 
 		// check for dropped packets
 		if ((lastStatus.packet_rx_drop_count != status.packet_rx_drop_count) && debug)
@@ -107,16 +160,92 @@ int UDP_Port::
 	return msgReceived;
 }
 
+int UDP_Port::
+	read_messages(mavlink_message_t *messages, int max_messages)
+{
+	return read_messages(messages, NULL, max_messages);
+}
+
+int UDP_Port::
+	read_messages(mavlink_message_t *messages, Raw_Frame *frames, int max_messages)
+{
+	int count = 0;
+
+	// Lock
+	pthread_mutex_lock(&lock);
+
+	int result = 1;
+	if (buff_ptr >= buff_len)
+	{
+		result = _receive_datagram();
+	}
+
+	// hand over the frames of every datagram received so far, without another syscall
+	while (result > 0)
+	{
+		count += _parse_buffer((uint8_t *)rx_data, buff_len, buff_ptr, messages + count, frames ? frames + count : NULL,
+		                       max_messages - count);
+		if (count >= max_messages || !_datagram_queued())
+		{
+			break;
+		}
+		result = _receive_datagram();
+	}
+	int error = errno;
+
+	// Unlock
+	pthread_mutex_unlock(&lock);
+
+	// an empty datagram or an interrupted wait is not an error, anyone can send the former
+	if (result < 0 && count == 0 && error != EINTR && error != EAGAIN && error != EWOULDBLOCK)
+	{
+		fprintf(stderr, "ERROR: Could not read, res = %d, errno = %d : %m\n", result, error);
+		errno = error;
+		return -1;
+	}
+
+	return count;
+}
+
+int UDP_Port::
+	rx_pending()
+{
+	pthread_mutex_lock(&lock);
+
+	int pending = buff_len - buff_ptr;
+	for (int i = rx_batch_index + 1; i < rx_batch_count; i++)
+	{
+		pending += rx_batch_msgs[i].msg_len;
+	}
+	for (int i = uring_rx_index + 1; i < uring_rx_count; i++)
+	{
+		pending += uring_rx[i].result;
+	}
+
+	// completions not taken off the ring yet, at least one byte each
+	pending += uring.ready_count();
+
+	pthread_mutex_unlock(&lock);
+
+	return pending;
+}
+
 int UDP_Port::
 	write_message(const mavlink_message_t &message)
 {
-	char buf[300];
+	uint8_t buf[300];
 
 	// Translate message to buffer
-	unsigned len = mavlink_msg_to_send_buffer((uint8_t *)buf, &message);
+	unsigned len = mavlink_msg_to_send_buffer(buf, &message);
 
-	// Write buffer to UDP port, locks port while writing
-	int bytesWritten = _write_port(buf, len);
+	return write_raw(buf, len);
+}
+
+int UDP_Port::
+	write_raw(const uint8_t *buf, unsigned len)
+{
+	// Write buffer to UDP port, locks transmit path while writing
+	int bytesWritten = _write_port((char *)buf, len);
 	if (bytesWritten < 0)
 	{
 		fprintf(stderr, "ERROR: Could not write, res = %d, errno = %d : %m\n", bytesWritten, errno);
@@ -125,6 +254,179 @@ int UDP_Port::
 	return bytesWritten;
 }
 
+int UDP_Port::
+	add_peer(const char *ip, int port)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if (inet_pton(AF_INET, ip, &addr.sin_addr) != 1)
+	{
+		fprintf(stderr, "ERROR: invalid peer address %s\n", ip);
+		return -1;
+	}
+
+	pthread_mutex_lock(&tx_lock);
+	peers.push_back(addr);
+	int peer = peers.size() - 1;
+	pthread_mutex_unlock(&tx_lock);
+
+	return peer;
+}
+
+int UDP_Port::
+	queue_message(const mavlink_message_t &message, int peer)
+{
+	pthread_mutex_lock(&tx_lock);
+
+	if (tx_batch_count >= TX_BATCH_LEN || peer < 0 || peer >= (int)peers.size())
+	{
+		pthread_mutex_unlock(&tx_lock);
+		return -1;
+	}
+
+	// Translate message straight into its queue slot
+	int slot = tx_batch_count++;
+	unsigned len = mavlink_msg_to_send_buffer(tx_batch_buffers[slot], &message);
+	tx_batch_iovecs[slot].iov_base = tx_batch_buffers[slot];
+	tx_batch_iovecs[slot].iov_len = len;
+	tx_batch_peers[slot] = peer;
+
+	pthread_mutex_unlock(&tx_lock);
+
+	return slot;
+}
+
+int UDP_Port::
+	flush_batch(int *results)
+{
+	pthread_mutex_lock(&tx_lock);
+	int sent = _flush_batch_locked(results);
+	pthread_mutex_unlock(&tx_lock);
+
+	return sent;
+}
+
+int UDP_Port::
+	flush()
+{
+	// one hold for both queues, so a concurrent queue_message() cannot skew the count
+	pthread_mutex_lock(&tx_lock);
+	int count = tx_batch_count;
+	int result = _send_pending();
+	int sent = _flush_batch_locked(NULL);
+	pthread_mutex_unlock(&tx_lock);
+
+	if (sent != count || result < 0)
+	{
+		return -1;
+	}
+
+	// queued io_uring requests complete before flush() returns
+	if (uring.is_ready())
+	{
+		uring.drain();
+	}
+	return 0;
+}
+
+void UDP_Port::
+	set_tx_coalescing(int max_bytes, int deadline_us)
+{
+	pthread_mutex_lock(&tx_lock);
+
+	// whatever is pending was collected for the old budget
+	_send_pending();
+
+	if (max_bytes > TX_COALESCE_MAX)
+	{
+		max_bytes = TX_COALESCE_MAX;
+	}
+	if (max_bytes > 0 && max_bytes < MAVLINK_MAX_PACKET_LEN)
+	{
+		max_bytes = MAVLINK_MAX_PACKET_LEN;
+	}
+	tx_coalesce_bytes = max_bytes > 0 ? max_bytes : 0;
+	tx_coalesce_deadline_us = deadline_us > 0 ? deadline_us : 0;
+
+	pthread_mutex_unlock(&tx_lock);
+}
+
+void UDP_Port::
+	poll_tx()
+{
+	pthread_mutex_lock(&tx_lock);
+
+	if (tx_pending_len > 0 && monotonic_us() - tx_pending_since_us >= (uint64_t)tx_coalesce_deadline_us)
+	{
+		_send_pending();
+	}
+
+	pthread_mutex_unlock(&tx_lock);
+}
+
+UDP_Port::Tx_Stats UDP_Port::
+	get_tx_stats()
+{
+	pthread_mutex_lock(&tx_lock);
+	Tx_Stats stats = tx_stats;
+	pthread_mutex_unlock(&tx_lock);
+
+	return stats;
+}
+
+bool UDP_Port::
+	set_io_engine(Io_Engine engine)
+{
+	if (is_open)
+	{
+		fprintf(stderr, "ERROR: io engine can only be changed before start\n");
+		return false;
+	}
+
+	io_engine = engine;
+	return true;
+}
+
+void UDP_Port::
+	set_rx_batch(int datagrams)
+{
+	if (is_open)
+	{
+		fprintf(stderr, "ERROR: rx batch size can only be changed before start\n");
+		return;
+	}
+
+	rx_batch = datagrams > 1 ? datagrams : 1;
+	rx_batch_count = 0;
+	rx_batch_index = 0;
+
+	if (rx_batch == 1)
+	{
+		rx_batch_buffers.clear();
+		rx_batch_msgs.clear();
+		rx_batch_iovecs.clear();
+		rx_batch_addrs.clear();
+		return;
+	}
+
+	// Pre-allocate one buffer, iovec and source address per datagram
+	rx_batch_buffers.assign(rx_batch * BUFF_LEN, 0);
+	rx_batch_msgs.assign(rx_batch, mmsghdr());
+	rx_batch_iovecs.assign(rx_batch, iovec());
+	rx_batch_addrs.assign(rx_batch, sockaddr_in());
+	for (int i = 0; i < rx_batch; i++)
+	{
+		rx_batch_iovecs[i].iov_base = &rx_batch_buffers[i * BUFF_LEN];
+		rx_batch_iovecs[i].iov_len = BUFF_LEN;
+		rx_batch_msgs[i].msg_hdr.msg_iov = &rx_batch_iovecs[i];
+		rx_batch_msgs[i].msg_hdr.msg_iovlen = 1;
+		rx_batch_msgs[i].msg_hdr.msg_name = &rx_batch_addrs[i];
+		rx_batch_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+	}
+}
+
 void UDP_Port::
 	start()
 {
@@ -141,8 +443,8 @@ void UDP_Port::
 	struct sockaddr_in addr;
 	memset(&addr, 0, sizeof(addr));
 	addr.sin_family = AF_INET;
-	addr.sin_addr.s_addr = inet_addr(target_ip);
-	;
+	target_addr = inet_addr(target_ip);
+	addr.sin_addr.s_addr = target_addr;
 	addr.sin_port = htons(rx_port);
 
 	if (bind(sock, (struct sockaddr *)&addr, sizeof(struct sockaddr)))
@@ -155,6 +457,37 @@ void UDP_Port::
 
 	printf("Listening to %s:%i\n", target_ip, rx_port);
 	lastStatus.packet_rx_drop_count = 0;
+	_reset_parser();
+	buff_ptr = 0;
+	buff_len = 0;
+	rx_batch_count = 0;
+	rx_batch_index = 0;
+	uring_rx_count = 0;
+	uring_rx_index = 0;
+
+	// one multishot recvmsg() stays queued for the lifetime of the port
+	if (io_engine == IO_ENGINE_URING)
+	{
+		if (!uring.init(BUFF_LEN) || !uring.recv(sock, 0, Uring_Engine::RECV_DATAGRAM))
+		{
+			fprintf(stderr, "WARNING: io_uring setup failed, using system calls\n");
+			uring.release();
+		}
+		else
+		{
+			// write_message() submits on its own, flush_batch() submits the whole queue at once
+			uring.set_submit_batch(TX_BATCH_LEN);
+		}
+	}
+
+	// the TX thread sends a coalesced datagram when its deadline passes
+	tx_running = true;
+	if (pthread_create(&tx_thread, NULL, &UDP_Port::_start_tx_thread, this) != 0)
+	{
+		tx_running = false;
+		printf("failure, could not start TX thread.\n");
+		throw EXIT_FAILURE;
+	}
 
 	is_open = true;
 
@@ -168,6 +501,28 @@ void UDP_Port::
 {
 	printf("CLOSE PORT\n");
 
+	// the RX thread reads through this port, it has to end first
+	stop_rx_thread();
+
+	// the pending datagram goes out before the socket is closed
+	pthread_mutex_lock(&tx_lock);
+	bool running = tx_running;
+	tx_running = false;
+	_send_pending();
+	pthread_cond_broadcast(&tx_cond);
+	pthread_mutex_unlock(&tx_lock);
+
+	if (running)
+	{
+		pthread_join(tx_thread, NULL);
+	}
+
+	// cancels the queued receive before the socket goes away
+	uring.release();
+	uring_rx_count = 0;
+	uring_rx_index = 0;
+	uring_spent.clear();
+
 	int result = close(sock);
 	sock = -1;
 
@@ -185,49 +540,157 @@ int UDP_Port::
 	_read_port(uint8_t &cp)
 {
 
-	socklen_t len;
-
 	// Lock
 	pthread_mutex_lock(&lock);
 
-	int result = -1;
-	if (buff_ptr < buff_len)
+	int result = 1;
+	if (buff_ptr >= buff_len)
+	{
+		result = _receive_datagram();
+	}
+
+	if (result > 0)
 	{
-		cp = buff[buff_ptr];
+		cp = rx_data[buff_ptr];
 		buff_ptr++;
-		result = 1;
+	}
+
+	// Unlock
+	pthread_mutex_unlock(&lock);
+
+	return result;
+}
+
+int UDP_Port::
+	_receive_datagram()
+{
+	int result;
+	struct sockaddr_in single_addr;
+	struct sockaddr_in *addr = &single_addr;
+
+	if (rx_batch_index + 1 < rx_batch_count)
+	{
+		// next datagram of the last recvmmsg() batch, no syscall
+		rx_batch_index++;
+		result = rx_batch_msgs[rx_batch_index].msg_len;
+		rx_data = &rx_batch_buffers[rx_batch_index * BUFF_LEN];
+		addr = &rx_batch_addrs[rx_batch_index];
+	}
+	else if (uring.is_ready())
+	{
+		// the parsed datagram goes back to the kernel buffer ring before the next wait,
+		// frames of the current read_frames() call may still point into it
+		if (uring_rx_index < uring_rx_count)
+		{
+			uring_spent.push_back(uring_rx[uring_rx_index].buffer);
+		}
+		uring_rx_index++;
+
+		result = uring_rx_index < uring_rx_count ? 1 : _wait_uring();
+		if (result > 0)
+		{
+			result = uring_rx[uring_rx_index].result;
+			rx_data = (char *)uring_rx[uring_rx_index].data;
+			addr = &uring_rx[uring_rx_index].addr;
+		}
+	}
+	else if (rx_batch > 1)
+	{
+		for (int i = 0; i < rx_batch; i++)
+		{
+			rx_batch_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		}
+
+		// block for the first datagram, then take whatever else is already queued
+		result = recvmmsg(sock, rx_batch_msgs.data(), rx_batch, MSG_WAITFORONE, NULL);
+		rx_batch_count = result > 0 ? result : 0;
+		rx_batch_index = 0;
+		if (result > 0)
+		{
+			result = rx_batch_msgs[0].msg_len;
+			rx_data = &rx_batch_buffers[0];
+			addr = &rx_batch_addrs[0];
+		}
 	}
 	else
 	{
-		struct sockaddr_in addr;
-		len = sizeof(struct sockaddr_in);
-		result = recvfrom(sock, &buff, BUFF_LEN, 0, (struct sockaddr *)&addr, &len);
-		if (tx_port < 0)
+		socklen_t len = sizeof(struct sockaddr_in);
+		result = recvfrom(sock, &buff, BUFF_LEN, 0, (struct sockaddr *)&single_addr, &len);
+		rx_data = buff;
+	}
+
+	if (tx_port < 0 && result >= 0)
+	{
+		if (addr->sin_addr.s_addr == target_addr)
+		{
+			tx_port = ntohs(addr->sin_port);
+
+			// cache the destination once for every later write
+			pthread_mutex_lock(&tx_lock);
+			peers[0].sin_addr.s_addr = target_addr;
+			peers[0].sin_port = addr->sin_port;
+			pthread_mutex_unlock(&tx_lock);
+
+			printf("Got first packet, sending to %s:%i\n", target_ip, rx_port);
+		}
+		else
+		{
+			printf("ERROR: Got packet from %s:%i but listening on %s\n", inet_ntoa(addr->sin_addr), ntohs(addr->sin_port), target_ip);
+		}
+	}
+	if (result > 0)
+	{
+		buff_len = result;
+		buff_ptr = 0;
+	}
+
+	return result;
+}
+
+int UDP_Port::
+	_wait_uring()
+{
+	for (size_t i = 0; i < uring_spent.size(); i++)
+	{
+		uring.recycle(uring_spent[i]);
+	}
+	uring_spent.clear();
+
+	while (true)
+	{
+		int n = uring.wait(uring_rx, URING_RX_BATCH, -1);
+		if (n <= 0)
+		{
+			// 0 after an interrupted wait, nothing was received
+			uring_rx_count = 0;
+			uring_rx_index = 0;
+			return n;
+		}
+
+		// keep the datagrams in arrival order, report the rest
+		int count = 0;
+		for (int i = 0; i < n; i++)
 		{
-			if (strcmp(inet_ntoa(addr.sin_addr), target_ip) == 0)
+			if (uring_rx[i].kind == Uring_Engine::COMPLETION_RECV && uring_rx[i].data)
 			{
-				tx_port = ntohs(addr.sin_port);
-				printf("Got first packet, sending to %s:%i\n", target_ip, rx_port);
+				uring_rx[count++] = uring_rx[i];
+				continue;
 			}
-			else
+
+			if (debug || uring_rx[i].kind == Uring_Engine::COMPLETION_RECV)
 			{
-				printf("ERROR: Got packet from %s:%i but listening on %s\n", inet_ntoa(addr.sin_addr), ntohs(addr.sin_port), target_ip);
+				fprintf(stderr, "ERROR: io_uring request failed, res = %d\n", uring_rx[i].result);
 			}
+			uring.recycle(uring_rx[i].buffer);
 		}
-		if (result > 0)
+
+		uring_rx_count = count;
+		uring_rx_index = 0;
+		if (count > 0)
 		{
-			buff_len = result;
-			buff_ptr = 0;
-			cp = buff[buff_ptr];
-			buff_ptr++;
-			// printf("recvfrom: %i %i\n", result, cp);
+			return count;
 		}
 	}
-
-	// Unlock
-	pthread_mutex_unlock(&lock);
-
-	return result;
 }
 
 int UDP_Port::
@@ -235,19 +698,36 @@ int UDP_Port::
 {
 
 	// Lock
-	pthread_mutex_lock(&lock);
+	pthread_mutex_lock(&tx_lock);
 
-	// Write packet via UDP link
+	// Write packet via UDP link to the cached target address
 	int bytesWritten = 0;
-	if (tx_port > 0)
+	if (peers[0].sin_port != 0 && tx_coalesce_bytes > 0)
+	{
+		bytesWritten = _coalesce(buf, len);
+	}
+	else if (peers[0].sin_port != 0 && uring.is_ready())
+	{
+		bytesWritten = uring.send(sock, 1, (const uint8_t *)buf, len, &peers[0]);
+		uring.submit();
+		if (bytesWritten > 0)
+		{
+			tx_stats.datagrams++;
+			tx_stats.frames++;
+		}
+	}
+	else if (peers[0].sin_port != 0)
 	{
-		struct sockaddr_in addr;
-		memset(&addr, 0, sizeof(addr));
-		addr.sin_family = AF_INET;
-		addr.sin_addr.s_addr = inet_addr(target_ip);
-		addr.sin_port = htons(tx_port);
-		bytesWritten = sendto(sock, buf, len, 0, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
-		printf("sendto: %i\n", bytesWritten);
+		bytesWritten = sendto(sock, buf, len, 0, (struct sockaddr *)&peers[0], sizeof(struct sockaddr_in));
+		if (bytesWritten > 0)
+		{
+			tx_stats.datagrams++;
+			tx_stats.frames++;
+		}
+		if (debug)
+		{
+			printf("sendto: %i\n", bytesWritten);
+		}
 	}
 	else
 	{
@@ -256,7 +736,203 @@ int UDP_Port::
 	}
 
 	// Unlock
-	pthread_mutex_unlock(&lock);
+	pthread_mutex_unlock(&tx_lock);
+
+	return bytesWritten;
+}
+
+int UDP_Port::
+	_coalesce(const char *buf, unsigned len)
+{
+	// the frame does not fit into the pending datagram, send that one first
+	if (tx_pending_len + (int)len > tx_coalesce_bytes && _send_pending() < 0)
+	{
+		return -1;
+	}
+
+	if (tx_pending_len == 0)
+	{
+		tx_pending_since_us = monotonic_us();
+
+		// the TX thread sleeps until the deadline of this datagram
+		pthread_cond_signal(&tx_cond);
+	}
+	memcpy(&tx_pending[tx_pending_len], buf, len);
+	tx_pending_len += len;
+	tx_pending_frames++;
+
+	// no room left for even the smallest frame, or waited long enough
+	if (tx_pending_len + MAVLINK_NUM_NON_PAYLOAD_BYTES > tx_coalesce_bytes ||
+		monotonic_us() - tx_pending_since_us >= (uint64_t)tx_coalesce_deadline_us)
+	{
+		if (_send_pending() < 0)
+		{
+			return -1;
+		}
+	}
+
+	return len;
+}
+
+int UDP_Port::
+	_send_pending()
+{
+	if (tx_pending_len == 0)
+	{
+		return 0;
+	}
+
+	int bytesWritten;
+	if (uring.is_ready())
+	{
+		bytesWritten = uring.send(sock, 1, tx_pending, tx_pending_len, &peers[0]);
+		uring.submit();
+	}
+	else
+	{
+		bytesWritten = sendto(sock, tx_pending, tx_pending_len, 0, (struct sockaddr *)&peers[0], sizeof(struct sockaddr_in));
+	}
+	if (bytesWritten > 0)
+	{
+		tx_stats.datagrams++;
+		tx_stats.frames += tx_pending_frames;
+	}
+	if (debug)
+	{
+		printf("sendto: %i (%i frames)\n", bytesWritten, tx_pending_frames);
+	}
+
+	tx_pending_len = 0;
+	tx_pending_frames = 0;
 
 	return bytesWritten;
 }
+
+int UDP_Port::
+	_flush_batch_locked(int *results)
+{
+	// every message becomes a sendmsg() request, one io_uring_enter() submits them all
+	if (uring.is_ready())
+	{
+		int sent = 0;
+		for (int slot = 0; slot < tx_batch_count; slot++)
+		{
+			struct sockaddr_in *addr = &peers[tx_batch_peers[slot]];
+			int result = -1;
+			if (addr->sin_port != 0)
+			{
+				result = uring.send(sock, 1, tx_batch_buffers[slot], tx_batch_iovecs[slot].iov_len, addr);
+			}
+			if (results)
+			{
+				results[slot] = result;
+			}
+			sent += result > 0;
+		}
+		uring.submit();
+
+		tx_batch_count = 0;
+		tx_stats.datagrams += sent;
+		tx_stats.frames += sent;
+
+		return sent;
+	}
+
+	// Collect the messages that have a known destination
+	int count = 0;
+	for (int slot = 0; slot < tx_batch_count; slot++)
+	{
+		struct sockaddr_in *addr = &peers[tx_batch_peers[slot]];
+		if (addr->sin_port == 0)
+		{
+			if (results)
+			{
+				results[slot] = -1;
+			}
+			continue;
+		}
+
+		memset(&tx_batch_msgs[count], 0, sizeof(struct mmsghdr));
+		tx_batch_msgs[count].msg_hdr.msg_name = addr;
+		tx_batch_msgs[count].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+		tx_batch_msgs[count].msg_hdr.msg_iov = &tx_batch_iovecs[slot];
+		tx_batch_msgs[count].msg_hdr.msg_iovlen = 1;
+		tx_batch_map[count] = slot;
+		count++;
+	}
+
+	// sendmmsg() stops at the first failing message, report it and go on with the rest
+	int sent = 0;
+	int done = 0;
+	while (done < count)
+	{
+		int result = sendmmsg(sock, &tx_batch_msgs[done], count - done, 0);
+		if (result <= 0)
+		{
+			if (results)
+			{
+				results[tx_batch_map[done]] = -1;
+			}
+			if (debug)
+			{
+				fprintf(stderr, "ERROR: Could not send batched message, errno = %d : %m\n", errno);
+			}
+			done++;
+			continue;
+		}
+
+		for (int i = done; i < done + result; i++)
+		{
+			if (results)
+			{
+				results[tx_batch_map[i]] = tx_batch_msgs[i].msg_len;
+			}
+		}
+		sent += result;
+		done += result;
+	}
+
+	tx_batch_count = 0;
+	tx_stats.datagrams += sent;
+	tx_stats.frames += sent;
+
+	return sent;
+}
+
+void UDP_Port::
+	_tx_loop()
+{
+	pthread_mutex_lock(&tx_lock);
+
+	while (tx_running)
+	{
+		if (tx_pending_len == 0)
+		{
+			pthread_cond_wait(&tx_cond, &tx_lock);
+			continue;
+		}
+
+		uint64_t deadline_us = tx_pending_since_us + tx_coalesce_deadline_us;
+		if (monotonic_us() >= deadline_us)
+		{
+			_send_pending();
+			continue;
+		}
+
+		// a write may send the datagram meanwhile, the loop checks again after waking
+		struct timespec deadline;
+		deadline.tv_sec = deadline_us / 1000000;
+		deadline.tv_nsec = (deadline_us % 1000000) * 1000;
+		pthread_cond_timedwait(&tx_cond, &tx_lock, &deadline);
+	}
+
+	pthread_mutex_unlock(&tx_lock);
+}
+
+void *UDP_Port::
+	_start_tx_thread(void *args)
+{
+	UDP_Port *port = (UDP_Port *)args;
+	port->_tx_loop();
+	return NULL;
+}
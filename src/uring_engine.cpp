@@ -0,0 +1,1203 @@
+#include "uring_engine.h"
+
+/**
+ * @brief Конструктор класса Uring_Engine.
+ */
+Uring_Engine::Uring_Engine()
+{
+    ring_fd = -1;
+    sq_ptr = NULL;
+    sq_size = 0;
+    cq_ptr = NULL;
+    cq_size = 0;
+    sqes = NULL;
+    sqes_size = 0;
+    buf_ring = NULL;
+    buf_ring_size = 0;
+    buf_tail = 0;
+    rx_pool = NULL;
+    rx_buffer_len = 0;
+    rx_buffers = 0;
+    tx_pool = NULL;
+    tx_registered = false;
+    free_slot = -1;
+    sends_in_flight = 0;
+    ready_pos = 0;
+    waiting = false;
+    submit_batch = 1;
+    report_sends = false;
+
+    // Start mutex
+    if (pthread_mutex_init(&lock, NULL) != 0)
+    {
+        printf("\n mutex init failed\n");
+        throw 1;
+    }
+}
+
+/**
+ * @brief Деструктор класса Uring_Engine.
+ */
+Uring_Engine::~Uring_Engine()
+{
+    release();
+
+    // destroy mutex
+    pthread_mutex_destroy(&lock);
+}
+
+/**
+ * @brief Создает очередь, кольцо буферов приема и слоты передачи.
+ *
+ * @param rx_buffer_len_ Размер одного буфера приема.
+ * @param rx_buffers_ Количество буферов приема.
+ * @param tx_slots Количество слотов передачи.
+ * @return true если очередь создана.
+ */
+bool Uring_Engine::init(int rx_buffer_len_, int rx_buffers_, int tx_slots)
+{
+    release();
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    ring_fd = syscall(__NR_io_uring_setup, RING_ENTRIES, &params);
+    if (ring_fd < 0)
+    {
+        fprintf(stderr, "WARNING: io_uring is not available, errno = %d : %m\n", errno);
+        ring_fd = -1;
+        return false;
+    }
+
+    // Map the submission and completion rings, one mapping on kernels that allow it
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && cq_size > sq_size)
+    {
+        sq_size = cq_size;
+    }
+
+    sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ptr == MAP_FAILED)
+    {
+        sq_ptr = NULL;
+        fprintf(stderr, "WARNING: could not map io_uring, errno = %d : %m\n", errno);
+        release();
+        return false;
+    }
+
+    if (single_mmap)
+    {
+        cq_ptr = sq_ptr;
+    }
+    else
+    {
+        cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ptr == MAP_FAILED)
+        {
+            cq_ptr = NULL;
+            fprintf(stderr, "WARNING: could not map io_uring, errno = %d : %m\n", errno);
+            release();
+            return false;
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes = (struct io_uring_sqe *)mmap(NULL, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        sqes = NULL;
+        fprintf(stderr, "WARNING: could not map io_uring, errno = %d : %m\n", errno);
+        release();
+        return false;
+    }
+
+    uint8_t *sq = (uint8_t *)sq_ptr;
+    sq_head = (unsigned *)(sq + params.sq_off.head);
+    sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    sq_array = (unsigned *)(sq + params.sq_off.array);
+    sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+    sq_entries = params.sq_entries;
+    sq_local_tail = *sq_tail;
+
+    uint8_t *cq = (uint8_t *)cq_ptr;
+    cq_head = (unsigned *)(cq + params.cq_off.head);
+    cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Provided buffer ring: the kernel picks a free receive buffer for every completion
+    rx_buffers = 1;
+    while (rx_buffers < rx_buffers_ && rx_buffers < 32768)
+    {
+        rx_buffers <<= 1;
+    }
+    rx_buffer_len = rx_buffer_len_;
+    buf_mask = rx_buffers - 1;
+    buf_tail = 0;
+
+    buf_ring_size = rx_buffers * sizeof(struct io_uring_buf);
+    buf_ring = (struct io_uring_buf_ring *)mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    rx_pool = (uint8_t *)mmap(NULL, (size_t)rx_buffers * rx_buffer_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED || rx_pool == MAP_FAILED)
+    {
+        buf_ring = buf_ring == MAP_FAILED ? NULL : buf_ring;
+        rx_pool = rx_pool == MAP_FAILED ? NULL : rx_pool;
+        fprintf(stderr, "WARNING: could not allocate io_uring buffers\n");
+        release();
+        return false;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)buf_ring;
+    reg.ring_entries = rx_buffers;
+    reg.bgid = BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+    {
+        fprintf(stderr, "WARNING: io_uring buffer ring is not supported, errno = %d : %m\n", errno);
+        release();
+        return false;
+    }
+
+    for (int i = 0; i < rx_buffers; i++)
+    {
+        _return_buffer(i);
+    }
+
+    // Transmit slots, registered once so stream writes skip the page pinning per request
+    tx_pool = (uint8_t *)mmap(NULL, (size_t)tx_slots * TX_SLOT_LEN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (tx_pool == MAP_FAILED)
+    {
+        tx_pool = NULL;
+        fprintf(stderr, "WARNING: could not allocate io_uring buffers\n");
+        release();
+        return false;
+    }
+
+    struct iovec iov;
+    iov.iov_base = tx_pool;
+    iov.iov_len = (size_t)tx_slots * TX_SLOT_LEN;
+
+    // RLIMIT_MEMLOCK may forbid it, plain writes from the same memory work as well
+    tx_registered = syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_BUFFERS, &iov, 1) == 0;
+
+    slots.assign(tx_slots, Slot());
+    for (int i = 0; i < tx_slots; i++)
+    {
+        slots[i].next = i + 1 < tx_slots ? i + 1 : -1;
+    }
+    free_slot = tx_slots > 0 ? 0 : -1;
+    sends_in_flight = 0;
+
+    return true;
+}
+
+/**
+ * @brief Закрывает очередь.
+ */
+void Uring_Engine::release()
+{
+    // closing the ring cancels whatever is still queued in the kernel
+    if (ring_fd >= 0)
+    {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+
+    if (sqes)
+    {
+        munmap(sqes, sqes_size);
+        sqes = NULL;
+    }
+    if (cq_ptr && cq_ptr != sq_ptr)
+    {
+        munmap(cq_ptr, cq_size);
+    }
+    cq_ptr = NULL;
+    if (sq_ptr)
+    {
+        munmap(sq_ptr, sq_size);
+        sq_ptr = NULL;
+    }
+    if (buf_ring)
+    {
+        munmap(buf_ring, buf_ring_size);
+        buf_ring = NULL;
+    }
+    if (rx_pool)
+    {
+        munmap(rx_pool, (size_t)rx_buffers * rx_buffer_len);
+        rx_pool = NULL;
+    }
+    if (tx_pool)
+    {
+        munmap(tx_pool, slots.size() * TX_SLOT_LEN);
+        tx_pool = NULL;
+    }
+
+    for (size_t i = 0; i < receivers.size(); i++)
+    {
+        delete receivers[i];
+    }
+    receivers.clear();
+    streams.clear();
+    slots.clear();
+    ready.clear();
+    ready_pos = 0;
+    free_slot = -1;
+    sends_in_flight = 0;
+    waiting = false;
+}
+
+/**
+ * @brief Ставит запрос приема.
+ *
+ * @param fd Дескриптор.
+ * @param tag Метка для результатов.
+ * @param mode Вид запроса.
+ * @return true если запрос поставлен.
+ */
+bool Uring_Engine::recv(int fd, uint64_t tag, Recv_Mode mode)
+{
+    return _add_receiver(fd, tag, mode, false);
+}
+
+/**
+ * @brief Ставит многократный запрос приема соединений.
+ *
+ * @param fd Слушающий сокет.
+ * @param tag Метка для результатов.
+ * @return true если запрос поставлен.
+ */
+bool Uring_Engine::accept(int fd, uint64_t tag)
+{
+    return _add_receiver(fd, tag, RECV_STREAM, true);
+}
+
+/**
+ * @brief Отменяет прием и передачу для дескриптора.
+ *
+ * @param fd Дескриптор.
+ */
+void Uring_Engine::cancel(int fd)
+{
+    if (ring_fd < 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    for (size_t i = 0; i < receivers.size(); i++)
+    {
+        Receiver *receiver = receivers[i];
+        if (receiver->fd != fd || !receiver->active)
+        {
+            continue;
+        }
+
+        receiver->active = false;
+        if (receiver->armed)
+        {
+            // the request holds its own file reference, close() alone would not end it
+            struct io_uring_sqe *sqe = _get_sqe(REQUEST_CANCEL, i);
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = ((uint64_t)REQUEST_RECV << 32) | i;
+        }
+    }
+
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        if (streams[i].fd == fd && streams[i].active)
+        {
+            streams[i].active = false;
+
+            // a write in flight still owns its slot, freed on completion
+            if (!streams[i].writing)
+            {
+                _drop_stream(i);
+            }
+        }
+    }
+
+    _submit_locked();
+
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Ставит данные в очередь передачи.
+ *
+ * @param fd Дескриптор.
+ * @param tag Метка для ошибок передачи.
+ * @param buf Данные.
+ * @param len Длина данных.
+ * @param addr Получатель датаграммы или NULL для потока.
+ * @param block Ждать освобождения слота.
+ * @return int len или -1, если свободного слота нет.
+ */
+int Uring_Engine::send(int fd, uint64_t tag, const uint8_t *buf, unsigned len, const struct sockaddr_in *addr, bool block)
+{
+    if (ring_fd < 0 || len > (unsigned)TX_SLOT_LEN)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    // completions already posted free their slots without a syscall
+    _reap();
+
+    if (addr)
+    {
+        int index = _take_slot(block);
+        if (index < 0)
+        {
+            pthread_mutex_unlock(&lock);
+            return -1;
+        }
+
+        Slot &slot = slots[index];
+        memcpy(tx_pool + (size_t)index * TX_SLOT_LEN, buf, len);
+        slot.len = len;
+        slot.stream = -1;
+        slot.tag = tag;
+        slot.addr = *addr;
+        slot.iov.iov_base = tx_pool + (size_t)index * TX_SLOT_LEN;
+        slot.iov.iov_len = len;
+        memset(&slot.msg, 0, sizeof(slot.msg));
+        slot.msg.msg_name = &slot.addr;
+        slot.msg.msg_namelen = sizeof(struct sockaddr_in);
+        slot.msg.msg_iov = &slot.iov;
+        slot.msg.msg_iovlen = 1;
+
+        struct io_uring_sqe *sqe = _get_sqe(REQUEST_SEND, index);
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t)(uintptr_t)&slot.msg;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sends_in_flight++;
+    }
+    else
+    {
+        int stream = -1;
+        for (size_t i = 0; i < streams.size(); i++)
+        {
+            if (streams[i].fd == fd && streams[i].active)
+            {
+                stream = i;
+                break;
+            }
+        }
+
+        if (stream < 0)
+        {
+            // reuse a cancelled stream once its last write completed
+            for (size_t i = 0; i < streams.size() && stream < 0; i++)
+            {
+                if (!streams[i].active && !streams[i].writing && streams[i].head < 0)
+                {
+                    stream = i;
+                }
+            }
+            if (stream < 0)
+            {
+                stream = streams.size();
+                streams.push_back(Stream());
+            }
+
+            struct stat info;
+            Stream &created = streams[stream];
+            created.fd = fd;
+            created.tag = tag;
+            created.is_socket = fstat(fd, &info) == 0 && S_ISSOCK(info.st_mode);
+            created.active = true;
+            created.writing = false;
+            created.head = -1;
+            created.tail = -1;
+            created.offset = 0;
+            created.pending = 0;
+        }
+
+        // append to the last slot, even while it is being written: the write covers only the bytes before
+        int tail = streams[stream].tail;
+        if (tail < 0 || slots[tail].len + len > (unsigned)TX_SLOT_LEN)
+        {
+            int index = _take_slot(block);
+            if (index < 0)
+            {
+                pthread_mutex_unlock(&lock);
+                return -1;
+            }
+
+            // waiting for a slot may have finished or cancelled the stream
+            Stream &st = streams[stream];
+            if (!st.active || st.fd != fd)
+            {
+                _free_slot(index);
+                pthread_mutex_unlock(&lock);
+                return -1;
+            }
+
+            slots[index].len = 0;
+            slots[index].stream = stream;
+            slots[index].next = -1;
+            if (st.tail >= 0)
+            {
+                slots[st.tail].next = index;
+            }
+            else
+            {
+                st.head = index;
+                st.offset = 0;
+            }
+            st.tail = index;
+            tail = index;
+        }
+
+        memcpy(tx_pool + (size_t)tail * TX_SLOT_LEN + slots[tail].len, buf, len);
+        slots[tail].len += len;
+        streams[stream].pending += len;
+
+        _write_stream(stream);
+    }
+
+    if (_sq_ready() >= (unsigned)submit_batch)
+    {
+        _submit_locked();
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return len;
+}
+
+/**
+ * @brief Устанавливает порог отправки запросов из send().
+ *
+ * @param count Количество запросов.
+ */
+void Uring_Engine::set_submit_batch(int count)
+{
+    pthread_mutex_lock(&lock);
+    submit_batch = count > 1 ? count : 1;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Включает выдачу COMPLETION_SEND для каждой завершенной записи потока.
+ *
+ * @param report true - выдавать.
+ */
+void Uring_Engine::set_report_sends(bool report)
+{
+    pthread_mutex_lock(&lock);
+    report_sends = report;
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Отправляет ядру подготовленные запросы.
+ *
+ * @return int Количество отправленных запросов или -1 при ошибке.
+ */
+int Uring_Engine::submit()
+{
+    if (ring_fd < 0)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&lock);
+    int result = _submit_locked();
+    pthread_mutex_unlock(&lock);
+
+    return result;
+}
+
+/**
+ * @brief Дожидается завершения всех поставленных передач.
+ *
+ * @return int 0 при успехе, -1 если очередь не создана.
+ */
+int Uring_Engine::drain()
+{
+    if (ring_fd < 0)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    _reap();
+    while (sends_in_flight > 0)
+    {
+        // requests are handed over under the lock, the sleep itself submits nothing
+        _submit_locked();
+        pthread_mutex_unlock(&lock);
+
+        _enter(0, 1, -1);
+
+        pthread_mutex_lock(&lock);
+        _reap();
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    return 0;
+}
+
+/**
+ * @brief Возвращает объем неотправленных данных потока.
+ *
+ * @param fd Дескриптор.
+ * @return int Количество байт.
+ */
+int Uring_Engine::stream_pending(int fd)
+{
+    int pending = 0;
+
+    pthread_mutex_lock(&lock);
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        if (streams[i].fd == fd && streams[i].active)
+        {
+            pending = streams[i].pending;
+        }
+    }
+    pthread_mutex_unlock(&lock);
+
+    return pending;
+}
+
+/**
+ * @brief Отправляет подготовленные запросы и забирает завершенные.
+ *
+ * @param completions Массив для результатов.
+ * @param max_completions Размер массива.
+ * @param timeout_ms Время ожидания, мс.
+ * @return int Количество результатов или -1 при ошибке.
+ */
+int Uring_Engine::wait(Completion *completions, int max_completions, int timeout_ms)
+{
+    if (ring_fd < 0)
+    {
+        return -1;
+    }
+
+    int result = 0;
+
+    pthread_mutex_lock(&lock);
+
+    _reap();
+
+    if (ready_pos == ready.size() && timeout_ms != 0)
+    {
+        // queued sends go to the kernel under the lock; another thread may be building
+        // a request while this one sleeps, so the sleep itself submits nothing
+        waiting = true;
+        _submit_locked();
+        pthread_mutex_unlock(&lock);
+
+        result = _enter(0, 1, timeout_ms);
+        int error = errno;
+
+        pthread_mutex_lock(&lock);
+        waiting = false;
+        _reap();
+
+        if (result < 0 && (error == EINTR || error == ETIME || error == EAGAIN || error == EBUSY))
+        {
+            result = 0;
+        }
+    }
+    else if (_sq_ready() > 0)
+    {
+        _submit_locked();
+    }
+
+    int count = 0;
+    while (ready_pos < ready.size() && count < max_completions)
+    {
+        completions[count++] = ready[ready_pos++];
+    }
+    if (ready_pos == ready.size())
+    {
+        ready.clear();
+        ready_pos = 0;
+    }
+
+    pthread_mutex_unlock(&lock);
+
+    if (result < 0 && count == 0)
+    {
+        return -1;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Возвращает количество завершенных запросов, еще не выданных wait().
+ *
+ * @return int Количество результатов.
+ */
+int Uring_Engine::ready_count()
+{
+    if (ring_fd < 0)
+    {
+        return 0;
+    }
+
+    pthread_mutex_lock(&lock);
+    _reap();
+    int count = ready.size() - ready_pos;
+    pthread_mutex_unlock(&lock);
+
+    return count;
+}
+
+/**
+ * @brief Возвращает буфер приема в кольцо.
+ *
+ * @param buffer Номер буфера.
+ */
+void Uring_Engine::recycle(int buffer)
+{
+    if (buffer < 0 || ring_fd < 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    _return_buffer(buffer);
+
+    // receivers stopped by ENOBUFS continue now that a buffer is back
+    bool armed = false;
+    for (size_t i = 0; i < receivers.size(); i++)
+    {
+        if (receivers[i]->active && receivers[i]->starved && !receivers[i]->armed)
+        {
+            _arm(i);
+            armed = true;
+        }
+    }
+    if (armed)
+    {
+        _submit_locked();
+    }
+
+    pthread_mutex_unlock(&lock);
+}
+
+/**
+ * @brief Вызывает io_uring_enter().
+ *
+ * @param to_submit Количество запросов для отправки.
+ * @param min_complete Минимальное количество завершений для ожидания.
+ * @param timeout_ms Время ожидания, мс.
+ * @return int Результат системного вызова.
+ */
+int Uring_Engine::_enter(unsigned to_submit, unsigned min_complete, int timeout_ms)
+{
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    if (min_complete > 0 && timeout_ms >= 0)
+    {
+        struct __kernel_timespec ts;
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        arg.ts = (uint64_t)(uintptr_t)&ts;
+
+        return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+
+    return syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, NULL, _NSIG / 8);
+}
+
+/**
+ * @brief Возвращает количество подготовленных, но не отправленных запросов.
+ *
+ * @return unsigned Количество запросов.
+ */
+unsigned Uring_Engine::_sq_ready()
+{
+    return sq_local_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Выделяет запрос в очереди.
+ *
+ * @param type Тип запроса.
+ * @param index Номер приемника или слота.
+ * @return io_uring_sqe* Обнуленный запрос, ядро увидит его после _submit_locked().
+ */
+struct io_uring_sqe *Uring_Engine::_get_sqe(Request_Type type, unsigned index)
+{
+    // the ring is full, hand it over to the kernel first
+    while (_sq_ready() >= sq_entries)
+    {
+        if (_submit_locked() < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR)
+        {
+            fprintf(stderr, "ERROR: Could not submit io_uring requests, errno = %d : %m\n", errno);
+        }
+        _reap();
+    }
+
+    unsigned slot = sq_local_tail & sq_mask;
+    struct io_uring_sqe *sqe = &sqes[slot];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = ((uint64_t)type << 32) | index;
+    sq_array[slot] = slot;
+
+    // published in _submit_locked(), once the caller has filled it in
+    sq_local_tail++;
+
+    return sqe;
+}
+
+/**
+ * @brief Отправляет подготовленные запросы под блокировкой.
+ *
+ * @return int Результат io_uring_enter().
+ */
+int Uring_Engine::_submit_locked()
+{
+    unsigned to_submit = _sq_ready();
+    if (to_submit == 0)
+    {
+        return 0;
+    }
+
+    // every request up to sq_local_tail is complete, only now the kernel may read them
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+
+    return _enter(to_submit, 0, -1);
+}
+
+/**
+ * @brief Забирает завершения из очереди ядра.
+ */
+void Uring_Engine::_reap()
+{
+    size_t before = ready.size();
+
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &cqes[head & cq_mask];
+        unsigned type = cqe->user_data >> 32;
+        unsigned index = cqe->user_data & 0xffffffff;
+
+        if (type == REQUEST_RECV && index < receivers.size())
+        {
+            _complete_recv(index, cqe);
+        }
+        else if (type == REQUEST_SEND && index < slots.size())
+        {
+            _complete_send(index, cqe->res);
+        }
+
+        head++;
+    }
+
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+    // the reader sleeps in io_uring_enter() and would miss what this thread took off the ring
+    if (waiting && ready.size() > before && _sq_ready() < sq_entries)
+    {
+        _get_sqe(REQUEST_WAKE, 0)->opcode = IORING_OP_NOP;
+        _submit_locked();
+        waiting = false;
+    }
+}
+
+/**
+ * @brief Обрабатывает завершение приема.
+ *
+ * @param index Номер приемника.
+ * @param cqe Завершение.
+ */
+void Uring_Engine::_complete_recv(unsigned index, const struct io_uring_cqe *cqe)
+{
+    Receiver *receiver = receivers[index];
+    int buffer = (cqe->flags & IORING_CQE_F_BUFFER) ? (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+    int res = cqe->res;
+
+    if (!(cqe->flags & IORING_CQE_F_MORE))
+    {
+        receiver->armed = false;
+    }
+
+    if (!receiver->active)
+    {
+        _return_buffer(buffer);
+        return;
+    }
+
+    // every buffer is held by the port, continue once one comes back
+    if (res == -ENOBUFS)
+    {
+        receiver->starved = !receiver->armed;
+        _return_buffer(buffer);
+        return;
+    }
+
+    Completion completion;
+    memset(&completion, 0, sizeof(completion));
+    completion.kind = receiver->is_accept ? COMPLETION_ACCEPT : COMPLETION_RECV;
+    completion.tag = receiver->tag;
+    completion.result = res;
+    completion.data = NULL;
+    completion.buffer = buffer;
+
+    if (buffer >= 0)
+    {
+        uint8_t *data = rx_pool + (size_t)buffer * rx_buffer_len;
+        completion.data = data;
+
+        if (receiver->mode == RECV_DATAGRAM && res >= 0)
+        {
+            // recvmsg() layout: header, source address, control data, payload
+            struct io_uring_recvmsg_out *out = (struct io_uring_recvmsg_out *)data;
+            size_t offset = sizeof(*out) + receiver->msg.msg_namelen + receiver->msg.msg_controllen;
+            if (out->namelen >= sizeof(struct sockaddr_in))
+            {
+                memcpy(&completion.addr, data + sizeof(*out), sizeof(struct sockaddr_in));
+            }
+
+            int len = out->payloadlen;
+            if ((size_t)len > rx_buffer_len - offset)
+            {
+                len = rx_buffer_len - offset;
+            }
+            completion.data = data + offset;
+            completion.result = len;
+        }
+    }
+
+    ready.push_back(completion);
+
+    // end of stream or a failure ends the request, anything else continues
+    bool finished;
+    if (receiver->is_accept || receiver->mode == RECV_DATAGRAM)
+    {
+        // a failed connection or datagram does not stop the socket
+        finished = res == -EBADF || res == -EINVAL || res == -ECANCELED;
+    }
+    else
+    {
+        finished = res <= 0;
+    }
+
+    if (finished)
+    {
+        receiver->active = false;
+    }
+    else if (!receiver->armed)
+    {
+        _arm(index);
+    }
+}
+
+/**
+ * @brief Обрабатывает завершение передачи.
+ *
+ * @param index Номер слота.
+ * @param res Результат записи.
+ */
+void Uring_Engine::_complete_send(unsigned index, int res)
+{
+    Slot &slot = slots[index];
+    sends_in_flight--;
+
+    if (slot.stream < 0)
+    {
+        if (res < 0)
+        {
+            Completion completion;
+            memset(&completion, 0, sizeof(completion));
+            completion.kind = COMPLETION_SEND;
+            completion.tag = slot.tag;
+            completion.result = res;
+            completion.buffer = -1;
+            ready.push_back(completion);
+        }
+        _free_slot(index);
+        return;
+    }
+
+    int stream = slot.stream;
+    Stream &st = streams[stream];
+    st.writing = false;
+
+    if (res < 0 || !st.active)
+    {
+        if (res < 0 && st.active)
+        {
+            Completion completion;
+            memset(&completion, 0, sizeof(completion));
+            completion.kind = COMPLETION_SEND;
+            completion.tag = st.tag;
+            completion.result = res;
+            completion.buffer = -1;
+            ready.push_back(completion);
+            st.active = false;
+        }
+        _drop_stream(stream);
+        return;
+    }
+
+    if (report_sends)
+    {
+        Completion completion;
+        memset(&completion, 0, sizeof(completion));
+        completion.kind = COMPLETION_SEND;
+        completion.tag = st.tag;
+        completion.result = res;
+        completion.buffer = -1;
+        ready.push_back(completion);
+    }
+
+    // a short write continues from where it stopped
+    st.offset += res;
+    st.pending -= res;
+    if (st.offset >= slot.len)
+    {
+        st.head = slot.next;
+        if (st.head < 0)
+        {
+            st.tail = -1;
+        }
+        st.offset = 0;
+        _free_slot(index);
+    }
+
+    _write_stream(stream);
+}
+
+/**
+ * @brief Ставит запрос приема в очередь.
+ *
+ * @param index Номер приемника.
+ */
+void Uring_Engine::_arm(unsigned index)
+{
+    Receiver *receiver = receivers[index];
+    struct io_uring_sqe *sqe = _get_sqe(REQUEST_RECV, index);
+    sqe->fd = receiver->fd;
+
+    if (receiver->is_accept)
+    {
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+    }
+    else if (receiver->mode == RECV_READ)
+    {
+        // not a socket: one read per request, armed again on completion
+        sqe->opcode = IORING_OP_READ;
+        sqe->off = (uint64_t)-1;
+        sqe->len = rx_buffer_len;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+    }
+    else
+    {
+        sqe->opcode = receiver->mode == RECV_DATAGRAM ? IORING_OP_RECVMSG : IORING_OP_RECV;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFER_GROUP;
+        if (receiver->mode == RECV_DATAGRAM)
+        {
+            sqe->addr = (uint64_t)(uintptr_t)&receiver->msg;
+        }
+    }
+
+    receiver->armed = true;
+    receiver->starved = false;
+}
+
+/**
+ * @brief Добавляет приемник.
+ *
+ * @param fd Дескриптор.
+ * @param tag Метка.
+ * @param mode Вид приема.
+ * @param is_accept Прием соединений.
+ * @return true если запрос поставлен.
+ */
+bool Uring_Engine::_add_receiver(int fd, uint64_t tag, Recv_Mode mode, bool is_accept)
+{
+    if (ring_fd < 0)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&lock);
+
+    // reuse an entry whose request has left the kernel
+    unsigned index = receivers.size();
+    for (size_t i = 0; i < receivers.size(); i++)
+    {
+        if (!receivers[i]->active && !receivers[i]->armed)
+        {
+            index = i;
+            break;
+        }
+    }
+    if (index == receivers.size())
+    {
+        receivers.push_back(new Receiver());
+    }
+
+    Receiver *receiver = receivers[index];
+    receiver->fd = fd;
+    receiver->tag = tag;
+    receiver->mode = mode;
+    receiver->is_accept = is_accept;
+    receiver->active = true;
+    receiver->armed = false;
+    receiver->starved = false;
+    memset(&receiver->msg, 0, sizeof(receiver->msg));
+    receiver->msg.msg_namelen = sizeof(struct sockaddr_in);
+
+    _arm(index);
+    int result = _submit_locked();
+
+    pthread_mutex_unlock(&lock);
+
+    return result >= 0;
+}
+
+/**
+ * @brief Берет свободный слот передачи.
+ *
+ * @param block Ждать освобождения слота.
+ * @return int Номер слота или -1.
+ */
+int Uring_Engine::_take_slot(bool block)
+{
+    while (free_slot < 0)
+    {
+        if (!block || sends_in_flight == 0)
+        {
+            return -1;
+        }
+
+        // every slot is in flight, wait for one of them to complete
+        _submit_locked();
+        pthread_mutex_unlock(&lock);
+
+        _enter(0, 1, -1);
+
+        pthread_mutex_lock(&lock);
+        _reap();
+    }
+
+    int index = free_slot;
+    free_slot = slots[index].next;
+    slots[index].next = -1;
+    slots[index].len = 0;
+
+    return index;
+}
+
+/**
+ * @brief Возвращает слот в свободный список.
+ *
+ * @param index Номер слота.
+ */
+void Uring_Engine::_free_slot(unsigned index)
+{
+    slots[index].next = free_slot;
+    free_slot = index;
+}
+
+/**
+ * @brief Ставит запись первого слота потока, если поток не пишет.
+ *
+ * @param index Номер потока.
+ */
+void Uring_Engine::_write_stream(int index)
+{
+    Stream &st = streams[index];
+    if (st.writing || st.head < 0 || !st.active)
+    {
+        return;
+    }
+
+    Slot &slot = slots[st.head];
+    struct io_uring_sqe *sqe = _get_sqe(REQUEST_SEND, st.head);
+    sqe->fd = st.fd;
+    sqe->addr = (uint64_t)(uintptr_t)(tx_pool + (size_t)st.head * TX_SLOT_LEN + st.offset);
+    sqe->len = slot.len - st.offset;
+
+    // write() to a reset connection raises SIGPIPE, send() can suppress it
+    if (st.is_socket)
+    {
+        sqe->opcode = IORING_OP_SEND;
+        sqe->msg_flags = MSG_NOSIGNAL;
+    }
+    else
+    {
+        sqe->opcode = tx_registered ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->off = (uint64_t)-1;
+        sqe->buf_index = 0;
+    }
+
+    st.writing = true;
+    sends_in_flight++;
+}
+
+/**
+ * @brief Освобождает все слоты потока.
+ *
+ * @param index Номер потока.
+ */
+void Uring_Engine::_drop_stream(int index)
+{
+    Stream &st = streams[index];
+    while (st.head >= 0)
+    {
+        int next = slots[st.head].next;
+        _free_slot(st.head);
+        st.head = next;
+    }
+    st.tail = -1;
+    st.offset = 0;
+    st.pending = 0;
+}
+
+/**
+ * @brief Возвращает буфер приема в кольцо под блокировкой.
+ *
+ * @param buffer Номер буфера, -1 игнорируется.
+ */
+void Uring_Engine::_return_buffer(int buffer)
+{
+    if (buffer < 0)
+    {
+        return;
+    }
+
+    // the C++ view of io_uring_buf_ring puts bufs past an empty struct, index the ring memory directly
+    struct io_uring_buf *buf = (struct io_uring_buf *)buf_ring + (buf_tail & buf_mask);
+    buf->addr = (uint64_t)(uintptr_t)(rx_pool + (size_t)buffer * rx_buffer_len);
+    buf->len = rx_buffer_len;
+    buf->bid = buffer;
+    buf_tail++;
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+}